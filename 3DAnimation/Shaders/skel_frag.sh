@@ -6,13 +6,16 @@ in vec3 frag_position;
 
 out vec4 pixel_color;
 
-//light uniforms
-uniform	vec3 light_color;
-uniform	vec3 light_position;
-uniform float light_attenuation;
-
-// camera position
-uniform vec3 camera_pos;
+// camera and light of the frame, the same in every program (FrameUniforms)
+layout (std140, binding = 0) uniform Frame
+{
+	mat4 proj;
+	mat4 cam;
+	vec3 camera_pos;
+	vec3 light_position;
+	float light_attenuation;
+	vec3 light_color;
+};
 
 // texture
 uniform sampler2D texture_image;
@@ -3,14 +3,24 @@
 layout (location = 0) in vec3 positions;
 layout (location = 1) in vec2 text_coords;
 layout (location = 2) in vec3 normals;
+// global transform of the joint, one per instance (JointRenderer), locations 3 to 6
+layout (location = 3) in mat4 animationTransform;
 
 out vec2 text_coord;
 out vec3 normal_vec;
 out vec3 frag_position;
 
-uniform mat4 cam;
-uniform mat4 animationTransform;
-uniform mat4 proj;
+// camera and light of the frame, the same in every program (FrameUniforms)
+layout (std140, binding = 0) uniform Frame
+{
+	mat4 proj;
+	mat4 cam;
+	vec3 camera_pos;
+	vec3 light_position;
+	float light_attenuation;
+	vec3 light_color;
+};
+
 uniform mat4 jointTransform;
 
 void main()
@@ -0,0 +1,90 @@
+#version 430 core
+
+layout (location = 0) in vec3 positions;
+layout (location = 1) in vec2 text_coords;
+layout (location = 2) in vec3 normals;
+layout (location = 3) in ivec4 joints;
+layout (location = 4) in vec4 weights;
+
+out vec2 text_coord;
+out vec3 normal_vec;
+out vec3 frag_position;
+
+// skinning transforms of every mesh drawn this frame, uploaded once per frame (BonePalette)
+layout (std430, binding = 0) buffer BonePalette
+{
+	mat4 bones[];
+};
+
+// the same as dual quaternions (SkinningDualQuaternion)
+struct DualQuaternion
+{
+	vec4 real;
+	vec4 dual;
+	float scale;
+};
+
+layout (std430, binding = 1) buffer DualQuaternionPalette
+{
+	DualQuaternion dualQuaternions[];
+};
+
+// camera and light of the frame, the same in every program (FrameUniforms)
+layout (std140, binding = 0) uniform Frame
+{
+	mat4 proj;
+	mat4 cam;
+	vec3 camera_pos;
+	vec3 light_position;
+	float light_attenuation;
+	vec3 light_color;
+};
+
+// first transform of this mesh in bones or dualQuaternions
+uniform int paletteOffset;
+// SkinningMode::DualQuaternion
+uniform bool dualQuaternionSkinning;
+
+// v + 2 r x (r x v + rw v)
+vec3 Rotate(vec4 r, vec3 v)
+{
+	return v + 2.0f * cross(r.xyz, cross(r.xyz, v) + r.w * v);
+}
+
+void main()
+{
+	vec3 outpos;
+	if (dualQuaternionSkinning)
+	{
+		DualQuaternion q0 = dualQuaternions[paletteOffset + joints.x];
+		DualQuaternion q1 = dualQuaternions[paletteOffset + joints.y];
+		DualQuaternion q2 = dualQuaternions[paletteOffset + joints.z];
+		DualQuaternion q3 = dualQuaternions[paletteOffset + joints.w];
+		// the influences on the other side of the first one are flipped, q and -q are the same
+		vec4 w = weights * vec4(1.0f, dot(q0.real, q1.real) < 0.0f ? -1.0f : 1.0f,
+			dot(q0.real, q2.real) < 0.0f ? -1.0f : 1.0f, dot(q0.real, q3.real) < 0.0f ? -1.0f : 1.0f);
+		vec4 r = ((w.x * q0.real + w.y * q1.real) + w.z * q2.real) + w.w * q3.real;
+		vec4 d = ((w.x * q0.dual + w.y * q1.dual) + w.z * q2.dual) + w.w * q3.dual;
+		float scale = dot(weights, vec4(q0.scale, q1.scale, q2.scale, q3.scale));
+		float len = length(r);
+		r /= len;
+		d /= len;
+
+		vec3 translation = 2.0f * (r.w * d.xyz - d.w * r.xyz + cross(r.xyz, d.xyz));
+		outpos = Rotate(r, scale * positions) + translation;
+		normal_vec = Rotate(r, normals);
+	}
+	else
+	{
+		// same order as the cpu skinning (SkinVertices)
+		mat4 skin = ((weights.x * bones[paletteOffset + joints.x] + weights.y * bones[paletteOffset + joints.y])
+			+ weights.z * bones[paletteOffset + joints.z]) + weights.w * bones[paletteOffset + joints.w];
+		outpos = vec3(skin * vec4(positions, 1.0f));
+		// the joints don't scale unevenly, the blended matrix is good enough for the normals
+		normal_vec = mat3(skin) * normals;
+	}
+
+	frag_position = outpos;
+	gl_Position = proj * cam * vec4(outpos, 1.0f);
+	text_coord = text_coords;
+}
@@ -5,8 +5,17 @@ layout (location = 0) in vec3 positions;
 
 out vec3 frag_position;
 
-uniform mat4 cam;
-uniform mat4 proj;
+// camera and light of the frame, the same in every program (FrameUniforms)
+layout (std140, binding = 0) uniform Frame
+{
+	mat4 proj;
+	mat4 cam;
+	vec3 camera_pos;
+	vec3 light_position;
+	float light_attenuation;
+	vec3 light_color;
+};
+
 uniform mat4 model;
 
 void main()
@@ -0,0 +1,50 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <glm/glm.hpp>
+#include "JointAnimation.h"
+#include "../core/model/Vertex.h"
+
+struct Joint;
+
+// <skin> of the controller the skeleton was read from
+struct SkinData
+{
+	glm::mat4 BindShapeMatrix{ 1.0f };
+	// joint names in the order the vertex weights index them (Joint::ID)
+	std::vector<std::string> JointNames;
+	std::vector<glm::mat4> InverseBindMatrices;
+};
+
+// a <geometry> with the <skin> of its controller, triangulated. The vertices are the distinct
+// position, normal and texture coordinate combinations of the polygons
+struct SkinnedMeshData
+{
+	std::string Name;
+	std::vector<Vertex> Vertices;
+	std::vector<unsigned int> Indices;
+	// the four largest influences of every vertex, weights add up to 1. Indices of
+	// Skin.JointNames, unused influences have weight 0
+	std::vector<glm::ivec4> JointIndices;
+	std::vector<glm::vec4> JointWeights;
+	// every controller has its own joint list and inverse bind matrices
+	SkinData Skin;
+};
+
+// one animation read from a collada file, indexed by Joint::ID like ColladaParser::GetAnimation
+struct AnimationClip
+{
+	std::string Name;
+	std::vector<JointAnimation> Animation;
+};
+
+// everything ColladaParser::Load reads from a single parse of a rig file.
+// Animation-only files can be added later with ColladaParser::AttachAnimation.
+// The skeleton is owned by whoever takes it, usually the Animator.
+struct ColladaAsset
+{
+	Joint* Skeleton = nullptr;
+	SkinData Skin;
+	std::vector<SkinnedMeshData> Meshes;
+	std::vector<AnimationClip> Clips;
+};
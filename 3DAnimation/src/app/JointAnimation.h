@@ -2,10 +2,24 @@
 #include <vector>
 #include <string>
 #include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <glm/gtx/matrix_decompose.hpp>
+
+// The transform of the key frame is decomposed once when the file is read so the
+// animator interpolates translation, rotation and scale directly every frame
 struct KeyFrame
 {
 	float TimeStamp;
-	glm::mat4 Transform{ 1.0f };
+	glm::vec3 Translation{ 0.0f };
+	glm::quat Rotation{ 1.0f, 0.0f, 0.0f, 0.0f };
+	glm::vec3 Scale{ 1.0f };
+
+	void SetTransform(const glm::mat4& transform)
+	{
+		glm::vec3 skew;
+		glm::vec4 perspective;
+		glm::decompose(transform, Scale, Rotation, Translation, skew, perspective);
+	}
 };
 
 
@@ -14,4 +28,4 @@ struct JointAnimation
 {
 	std::string jointName;
 	std::vector<KeyFrame> Frames;
-};
\ No newline at end of file
+};
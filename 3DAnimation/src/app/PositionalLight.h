@@ -1,6 +1,6 @@
 #pragma once
 #include <glm/glm.hpp>
-#include "../core/renderer/ShaderProgram.h"
+#include "../core/renderer/FrameUniforms.h"
 
 class PositionalLight
 {
@@ -16,12 +16,12 @@ public:
 
 	}
 
-	void SetUniforms(ShaderProgram& program)
+	// the light of the Frame uniform block
+	void SetUniforms(FrameUniformData& uniforms) const
 	{
-		program.useProgram();
-		program.setVector3f("light_color", Color);
-		program.setVector3f("light_position",Position);
-		program.setFloat("light_attenuation",Attenuation);
+		uniforms.LightColor = Color;
+		uniforms.LightPosition = Position;
+		uniforms.LightAttenuation = Attenuation;
 	}
 
 };
\ No newline at end of file
@@ -0,0 +1,75 @@
+#ifndef SKELETON_HPP
+#define SKELETON_HPP
+
+#include <vector>
+#include <string>
+#include <utility>
+#include <glm/glm.hpp>
+#include "Joint.h"
+
+// The joint tree flattened into arrays. Joints are stored depth first, so the parent of a
+// joint is always before it and a pose is computed in one forward loop over the arrays.
+// Poses (local or global transforms) use the same order as the skeleton.
+struct Skeleton
+{
+	// index of the parent joint, -1 for the root
+	std::vector<int> Parents;
+	// Joint::ID, the index of the joint in the skin of the file
+	std::vector<int> IDs;
+	std::vector<std::string> Names;
+	std::vector<std::string> Channels;
+	std::vector<glm::mat4> LocalBindTransforms;
+	std::vector<glm::mat4> InverseBindTransforms;
+
+	std::size_t GetJointCount() const { return Parents.size(); }
+
+	// flatten the tree built by ColladaParser or AnimationCache, the tree is not modified
+	static Skeleton FromJointTree(const Joint* root)
+	{
+		Skeleton skeleton;
+		if (!root) return skeleton;
+
+		// (joint, parent index), children pushed in reverse so they come out in order
+		std::vector<std::pair<const Joint*, int>> stack{ { root, -1 } };
+		while (!stack.empty())
+		{
+			const Joint* node = stack.back().first;
+			const int parent = stack.back().second;
+			stack.pop_back();
+
+			const int index = (int)skeleton.Parents.size();
+			skeleton.Parents.push_back(parent);
+			skeleton.IDs.push_back(node->ID);
+			skeleton.Names.push_back(node->Name);
+			skeleton.Channels.push_back(node->Channel);
+			skeleton.LocalBindTransforms.push_back(node->localBindTransform);
+			skeleton.InverseBindTransforms.push_back(node->InverseTransform);
+
+			for (auto it = node->Children.rbegin(); it != node->Children.rend(); ++it)
+				stack.emplace_back(*it, index);
+		}
+		return skeleton;
+	}
+
+	// global[i] = global[parent[i]] * local[i], the root is placed with rootTransform.
+	// local and global can be the same array
+	void ComputeGlobalTransforms(const glm::mat4* local, glm::mat4* global, const glm::mat4& rootTransform = glm::mat4(1.0f)) const
+	{
+		for (std::size_t i = 0; i < Parents.size(); ++i)
+		{
+			const int parent = Parents[i];
+			global[i] = (parent < 0 ? rootTransform : global[parent]) * local[i];
+		}
+	}
+
+	int FindJoint(const std::string& name) const
+	{
+		for (std::size_t i = 0; i < Names.size(); ++i)
+		{
+			if (Names[i] == name) return (int)i;
+		}
+		return -1;
+	}
+};
+
+#endif //SKELETON_HPP
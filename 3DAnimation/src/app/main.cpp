@@ -1,6 +1,19 @@
 #include <vector>
 #include <iostream>
 #include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <cstring>
+#include <cstdlib>
+#include <cmath>
+#include <chrono>
+#include <memory>
+#include <algorithm>
+#include <functional>
+#include <queue>
+#include <regex>
+#include <type_traits>
 #include "imgui/imgui.h"
 #include "imgui/imgui_impl_glfw.h"
 #include "imgui/imgui_impl_opengl3.h"
@@ -12,10 +25,24 @@
 #include "../core/renderer/ShaderProgram.h"
 #include "camera.h"
 #include "../core/utils/ColladaParser.h"
+#include "../core/utils/ColladaIndex.h"
+#include "../core/utils/AnimationCache.h"
+#include "../core/utils/AllocationCounter.h"
 #include "utils.hpp"
 #include "../core/model/Mesh.h"
 #include "Joint.h"
+#include "Skeleton.h"
 #include "../objects/Animator.h"
+#include "../objects/AnimationSystem.h"
+#include "../objects/AnimationBlender.h"
+#include "../objects/Skinning.h"
+#include "../core/renderer/FrameRingBuffer.h"
+#include "../core/renderer/FrameUniforms.h"
+#include "../core/renderer/BonePalette.h"
+#include "../core/renderer/SkinnedMeshRenderer.h"
+#include "../core/renderer/JointRenderer.h"
+#include "../core/renderer/RenderQueue.h"
+#include "../core/renderer/GLCallRecorder.h"
 #include "PositionalLight.h"
 
 int SCR_WIDTH = 800;
@@ -26,6 +53,8 @@ struct GuiData
 {
 	bool setmanual = false;
 	bool freeCamera = false;
+	bool showMesh = true;
+	bool dualQuaternionSkinning = false;
 	float angleX = 0;
 	float angleY = 0;
 	float angleZ = 0;
@@ -42,22 +71,114 @@ struct OpenGLBufferInfo
 };
 
 OpenGLBufferInfo CreateSkeletonLinesBuffers();
-unsigned CreateSkeletonJointsBuffers();
 OpenGLBufferInfo CreateWorldGrid(int slides,std::vector<float>& grid);
 void processInput(GLFWwindow* window, Camera& camera, float elapsedTime, float velocity, ShaderProgram& skelProgram);
-void FillInBindPoseTransforms(Joint* node, std::vector<glm::mat4>& inout_transforms);
-void GetGlobalPositions(Joint* node, const glm::mat4& parentTransform, std::vector<glm::mat4>& transform);
-void PrepareSkeletonLines(Joint* node, const glm::vec4& parent, std::vector<glm::mat4>& transforms, std::vector<glm::vec4>& points);
+void FillInBindPoseTransforms(const Skeleton& skeleton, std::vector<glm::mat4>& inout_transforms);
+std::size_t PrepareSkeletonLines(const Skeleton& skeleton, const std::vector<glm::mat4>& transforms, glm::vec4* points);
 GLFWwindow* InitWindow(const char* tittle, int width, int height);
 void BreathFirstSearchPrint(Joint* node, std::string identation);
 void setupImGui(GLFWwindow*);
 void startImGuiFrame();
 void cleanUpImGui();
-void renderImGui(GuiData& data);
+void renderImGui(GuiData& data, const RenderQueueStats& renderStats);
+int RunAnimationBenchmark(const char* path, int characters, int threads, bool lod, int lodInterval);
+int RunPoseKernelBenchmark(const char* path);
+int RunFloatScannerBenchmark(const char* path);
+int RunColladaIndexBenchmark(const char* path);
+int RunClipCompression(const char* path, float tolerance);
+int RunSkinning(const char* path, int threads);
+int RunGpuSkinningCheck(const char* path);
+int RunAllocationCheck(const char* path, int characters);
+int RunJointDrawCheck(const char* path);
+
+int main(int argc, char** argv)
+{
+	// offline step: 3DAnimation --bake assets/a.dae assets/b.dae ...
+	if (argc > 2 && std::strcmp(argv[1], "--bake") == 0)
+	{
+		int failed = 0;
+		for (int i = 2; i < argc; ++i)
+		{
+			std::string cachePath = AnimationCache::GetCachePath(argv[i]);
+			bool baked = AnimationCache::Bake(argv[i], cachePath.c_str());
+			std::cout << (baked ? "baked " : "failed ") << argv[i] << " -> " << cachePath << std::endl;
+			failed += baked ? 0 : 1;
+		}
+		return failed;
+	}
+
+	// 3DAnimation --bench-animation assets/a.dae [characters] [threads] [--lod [interval]]
+	if (argc > 2 && std::strcmp(argv[1], "--bench-animation") == 0)
+	{
+		int args = argc;
+		int lodInterval = 0;
+		for (int i = 3; i < argc; ++i)
+		{
+			if (std::strcmp(argv[i], "--lod") != 0) continue;
+			args = i;
+			lodInterval = i + 1 < argc ? std::atoi(argv[i + 1]) : 0;
+			break;
+		}
+		return RunAnimationBenchmark(argv[2], args > 3 ? std::atoi(argv[3]) : 500, args > 4 ? std::atoi(argv[4]) : 0, args < argc, lodInterval);
+	}
 
+	// 3DAnimation --bench-pose-kernels assets/a.dae
+	if (argc > 2 && std::strcmp(argv[1], "--bench-pose-kernels") == 0)
+		return RunPoseKernelBenchmark(argv[2]);
+
+	// 3DAnimation --bench-float-scanner assets/a.dae assets/b.dae ...
+	if (argc > 2 && std::strcmp(argv[1], "--bench-float-scanner") == 0)
+	{
+		int failed = 0;
+		for (int i = 2; i < argc; ++i)
+			failed += RunFloatScannerBenchmark(argv[i]);
+		return failed;
+	}
+
+	// 3DAnimation --bench-collada-index assets/a.dae assets/b.dae ...
+	if (argc > 2 && std::strcmp(argv[1], "--bench-collada-index") == 0)
+	{
+		int failed = 0;
+		for (int i = 2; i < argc; ++i)
+			failed += RunColladaIndexBenchmark(argv[i]);
+		return failed;
+	}
+
+	// 3DAnimation --compress assets/a.dae ... [--tolerance units]
+	if (argc > 2 && std::strcmp(argv[1], "--compress") == 0)
+	{
+		float tolerance = 0.0f;
+		for (int i = 2; i + 1 < argc; ++i)
+		{
+			if (std::strcmp(argv[i], "--tolerance") == 0)
+				tolerance = (float)std::atof(argv[i + 1]);
+		}
+
+		int failed = 0;
+		for (int i = 2; i < argc; ++i)
+		{
+			if (std::strcmp(argv[i], "--tolerance") == 0) { ++i; continue; }
+			failed += RunClipCompression(argv[i], tolerance);
+		}
+		return failed;
+	}
+
+	// 3DAnimation --skin assets/a.dae [threads]
+	if (argc > 2 && std::strcmp(argv[1], "--skin") == 0)
+		return RunSkinning(argv[2], argc > 3 ? std::atoi(argv[3]) : 0);
+
+	// 3DAnimation --check-gpu-skinning assets/a.dae
+	if (argc > 2 && std::strcmp(argv[1], "--check-gpu-skinning") == 0)
+		return RunGpuSkinningCheck(argv[2]);
+
+	// 3DAnimation --check-allocations assets/a.dae [characters], built with COUNT_ALLOCATIONS
+	if (argc > 2 && std::strcmp(argv[1], "--check-allocations") == 0)
+		return RunAllocationCheck(argv[2], argc > 3 ? std::atoi(argv[3]) : 100);
+
+	// 3DAnimation --check-joint-draws assets/a.dae
+	if (argc > 2 && std::strcmp(argv[1], "--check-joint-draws") == 0)
+		return RunJointDrawCheck(argv[2]);
 
-int main()
-{
 	GLFWwindow* window = InitWindow("3D animation", SCR_WIDTH, SCR_HEIGHT);
 	setupImGui(window);
 	Camera camera(0.0, 400, 500, fov);
@@ -70,23 +191,64 @@ int main()
 	ShaderProgram linesProgram("Shaders/vertexLines.sh", "Shaders/fragmentLines.sh");
 	//grid shader
 	ShaderProgram gridProgram("Shaders/vertex_grid.sh", "Shaders/fragment_grid.sh");
+	//skinned mesh shader
+	ShaderProgram skinProgram("Shaders/skin_vert.sh", "Shaders/skel_frag.sh");
 	
-	ColladaParser parser;
-	Joint* root = parser.GetJointHerarchy("assets/attack.dae");
+	// the baked file is rebuilt automatically when attack.dae changes
+	AnimationCache cache;
+	if (!cache.Open("assets/attack.dae", AnimationCache::GetCachePath("assets/attack.dae").c_str()))
+		throw std::runtime_error("could not load assets/attack.dae");
+	Joint* root = cache.CreateJointHerarchy();
 	BreathFirstSearchPrint(root, " ");
-	std::vector<JointAnimation>animation = parser.GetAnimation("assets/attack.dae");
-	std::vector<glm::mat4> transforms(animation.size(), glm::mat4(1.0f));
+	std::vector<JointAnimation>animation = cache.CreateAnimation();
 
 	Animator animator{ root,animation };
-	unsigned VAO = CreateSkeletonJointsBuffers();
+	const Skeleton& skeleton = animator.GetSkeleton();
+	// written in place every frame, no allocation after this
+	std::vector<glm::mat4> transforms(skeleton.GetJointCount(), glm::mat4(1.0f));
+
+	// the baked file has no meshes, they are read from the collada file and skinned on the gpu
+	ColladaParser meshParser;
+	ColladaAsset meshAsset = meshParser.Load("assets/attack.dae");
+	delete meshAsset.Skeleton;
+	std::vector<SkinningMesh> skinnedMeshes;
+	for (const SkinnedMeshData& mesh : meshAsset.Meshes)
+		skinnedMeshes.push_back(SkinningMesh::FromMeshData(mesh, skeleton));
+	// everything rebuilt every frame (bone palettes, joint instances, skeleton lines) is written
+	// straight into this buffer
+	FrameRingBuffer frameRing(1 << 20);
+	FrameUniforms frameUniforms(frameRing);
+	BonePalette palette(frameRing);
+	// transforms of all the meshes, the palette takes them in one allocation
+	std::size_t paletteSize = 0;
+	for (const SkinningMesh& mesh : skinnedMeshes)
+		paletteSize += mesh.GetJointCount();
+	std::vector<std::unique_ptr<SkinnedMeshRenderer>> meshRenderers;
+	for (std::size_t i = 0; i < skinnedMeshes.size(); ++i)
+	{
+		meshRenderers.emplace_back(new SkinnedMeshRenderer(nullptr, &skinProgram, &meshAsset.Meshes[i], &skinnedMeshes[i], &palette));
+		meshRenderers.back()->SetUp();
+	}
+	// every joint of the frame in one instanced draw
+	JointRenderer jointRenderer(nullptr, &skelProgram, frameRing);
+	jointRenderer.SetUp();
 
 	// points to make lines between different joints
-	std::vector<glm::vec4> points{ };
+	RingArray linePoints(frameRing, sizeof(glm::vec4));
 	OpenGLBufferInfo skelBuffLinesInfo = CreateSkeletonLinesBuffers();
 
 	// create grid
 	std::vector<float> grid = {};
 	OpenGLBufferInfo gridBufferInfo = CreateWorldGrid(50,grid);
+	glm::mat4 mod(1.f);
+	mod = glm::translate(mod, glm::vec3(-500, 0, -500));
+	mod = glm::scale(mod, glm::vec3(1000, 1000, 1000.f));
+	gridProgram.useProgram();
+	gridProgram.setMatrix("model", mod);
+	gridProgram.stopProgram();
+
+	// every draw of the frame, sorted by state
+	RenderQueue renderQueue;
 
 	float deltaTime = 0.0f;
 	float lastFrame = 0.0f;
@@ -98,6 +260,8 @@ int main()
 		float currentFrame = glfwGetTime();
 		deltaTime = currentFrame - lastFrame;
 		lastFrame = currentFrame;
+		// waits for the gpu to be done with the region of this frame, three frames ago
+		frameRing.BeginFrame();
 
 		if (!data.freeCamera)
 			camera.CheckMouseMovement(*window, glm::vec3(0, 0, 0));
@@ -106,9 +270,6 @@ int main()
 		processInput(window, camera, 1, deltaTime, skelProgram);
 
 		glm::mat4 cameraTranslation = camera.GetCameraTranslationMatrix();
-		//transform joints
-		glm::mat4 jointTransform(1.0f);
-		jointTransform = glm::scale(glm::mat4(1.0f),data.scaleJoints);
 		//transform model
 		glm::mat4 p(1.0f);
 		p = glm::rotate(glm::mat4(1.0f), data.angleX, glm::vec3(1, 0, 0));
@@ -121,57 +282,92 @@ int main()
 		else if (glfwGetKey(window, GLFW_KEY_SPACE) == GLFW_PRESS)
 			animator.Update(deltaTime);
 
-		transforms = animator.GetBoneTransforms();
-		GetGlobalPositions(root, p, transforms);
+		animator.GetGlobalTransforms(transforms.data(), transforms.size(), p);
+
+		// camera and light, bound once for every program
+		FrameUniformData frameData = {};
+		frameData.Projection = projectionMatrix;
+		frameData.View = cameraTranslation;
+		frameData.CameraPosition = camera.GetCameraPosition();
+		light.SetUniforms(frameData);
+		frameUniforms.Upload(frameData);
+
+		// every mesh writes its skinning transforms in the palette, uploaded once
+		palette.Clear(data.dualQuaternionSkinning ? 0 : paletteSize, data.dualQuaternionSkinning ? paletteSize : 0);
+		for (std::size_t i = 0; i < skinnedMeshes.size(); ++i)
+		{
+			std::size_t offset = 0;
+			if (data.dualQuaternionSkinning)
+			{
+				offset = palette.AllocateDualQuaternions(skinnedMeshes[i].GetJointCount());
+				ComputeSkinningDualQuaternions(skinnedMeshes[i], transforms.data(), palette.GetDualQuaternions(offset));
+			}
+			else
+			{
+				offset = palette.Allocate(skinnedMeshes[i].GetJointCount());
+				ComputeSkinningMatrices(skinnedMeshes[i], transforms.data(), palette.GetMatrices(offset));
+			}
+			meshRenderers[i]->SetPaletteOffset(offset);
+			meshRenderers[i]->SetSkinningMode(data.dualQuaternionSkinning ? SkinningMode::DualQuaternion : SkinningMode::LinearBlend);
+		}
+		palette.Upload();
 		
 		glClearColor(0.1, 0.1, 0.2, 1.0f);
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 		//--------------------------------------------------------
 		startImGuiFrame();
 
-		//Draw grid
-		glLineWidth(1);
-		glDisable(GL_DEPTH_TEST);
-		glBindVertexArray(gridBufferInfo.vao);
-		glm::mat4 mod(1.f);
-		mod = glm::translate(mod, glm::vec3(-500, 0, -500));
-		mod = glm::scale(mod, glm::vec3(1000, 1000, 1000.f));
-		gridProgram.useProgram();
-		gridProgram.setMatrix("proj", projectionMatrix);
-		gridProgram.setMatrix("model", mod);
-		gridProgram.setMatrix("cam", cameraTranslation);
-		glDrawElements(GL_LINES, gridBufferInfo.indexSize, GL_UNSIGNED_INT, NULL);
-		
+		//Draw grid, in the background without depth test
+		DrawPacket gridPacket;
+		gridPacket.Program = &gridProgram;
+		gridPacket.VertexArray = gridBufferInfo.vao;
+		gridPacket.State.DepthTest = false;
+		gridPacket.State.LineWidth = 1.0f;
+		gridPacket.Mode = GL_LINES;
+		gridPacket.Indexed = true;
+		gridPacket.Count = (int)gridBufferInfo.indexSize;
+		renderQueue.Submit(gridPacket, RenderLayer::Background);
+
 		//Draw animated joints
-		glEnable(GL_DEPTH_TEST);
-		glBindVertexArray(VAO);
-		skelProgram.useProgram();
-		skelProgram.setMatrix("proj", projectionMatrix);
-		skelProgram.setMatrix("jointTransform", jointTransform);
-		skelProgram.setMatrix("cam", cameraTranslation);
-		skelProgram.setVector3f("camera_pos", camera.GetCameraPosition());
-		light.SetUniforms(skelProgram);
-	
-		for (int i = 0; i < transforms.size(); ++i)
+		jointRenderer.SetJointScale(data.scaleJoints);
+		jointRenderer.Clear(transforms.size());
+		jointRenderer.Add(transforms.data(), transforms.size());
+		jointRenderer.Submit(renderQueue);
+
+		//Draw skinned meshes
+		if (data.showMesh)
 		{
-			skelProgram.setMatrix("animationTransform", transforms[i]);
-		    glDrawArrays(GL_TRIANGLES,0, 36);
+			for (std::unique_ptr<SkinnedMeshRenderer>& renderer : meshRenderers)
+				renderer->Submit(renderQueue);
 		}
 
 		///Draw lines for the skeleton
-		glLineWidth(3);
-		glEnable(GL_DEPTH_TEST);
-		glBindVertexArray(skelBuffLinesInfo.vao);
-		glBindBuffer(GL_ARRAY_BUFFER, skelBuffLinesInfo.vbo);
-		linesProgram.useProgram();
-		linesProgram.setMatrix("proj", projectionMatrix);
-		linesProgram.setMatrix("cam", cameraTranslation);
-		PrepareSkeletonLines(root, glm::vec4(0.0f,0.0f,0.0f,1.0f), transforms, points);
-		glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec4)* points.size(), &points[0], GL_DYNAMIC_DRAW);
-		glDrawArrays(GL_LINES, 0, points.size());
-		points.clear();
-		glBindVertexArray(0);
-		renderImGui(data);
+		linePoints.Clear();
+		const std::size_t lineCount = PrepareSkeletonLines(skeleton, transforms,
+			static_cast<glm::vec4*>(linePoints.Append(2 * skeleton.GetJointCount() * sizeof(glm::vec4))));
+		linePoints.Flush();
+		if (linePoints.IsValid())
+		{
+			DrawPacket linesPacket;
+			linesPacket.Program = &linesProgram;
+			linesPacket.VertexArray = skelBuffLinesInfo.vao;
+			linesPacket.State.LineWidth = 3.0f;
+			linesPacket.Mode = GL_LINES;
+			linesPacket.Count = (int)lineCount;
+			// the points are in the ring buffer of this frame
+			linesPacket.Prepare = [](void* context)
+			{
+				const RingArray& points = *static_cast<const RingArray*>(context);
+				glBindVertexBuffer(0, points.GetBuffer(), points.GetOffset(), sizeof(glm::vec4));
+			};
+			linesPacket.Context = &linePoints;
+			renderQueue.Submit(linesPacket);
+		}
+
+		renderQueue.Execute();
+		renderImGui(data, renderQueue.GetStats());
+		// the region is reused once the gpu passes this point
+		frameRing.EndFrame();
 		//---------------------------------------------------------------------------------
 		glfwSwapBuffers(window);
 		glfwPollEvents();
@@ -225,38 +421,20 @@ void processInput(GLFWwindow* window, Camera& camera, float elapsedTime, float v
 
 }
 
-void GetGlobalPositions(Joint* node, const glm::mat4& parentTransform, std::vector<glm::mat4>&  transform)
+void FillInBindPoseTransforms(const Skeleton& skeleton, std::vector<glm::mat4>& inout_transforms)
 {
-	glm::mat4 currentLocalTransform = transform[node->ID];
-
-	transform[node->ID] =  parentTransform * currentLocalTransform;
-
-	for (Joint* child : node->Children)
-	{
-		GetGlobalPositions(child, transform[node->ID], transform);
-	}
-}
-
-void FillInBindPoseTransforms(Joint* node, std::vector<glm::mat4>& inout_transforms)
-{
-	inout_transforms[node->ID] = node->localBindTransform;
-
-	for (Joint* child : node->Children)
-	{
-		FillInBindPoseTransforms(child, inout_transforms);
-	}
+	inout_transforms = skeleton.LocalBindTransforms;
 }
 
 OpenGLBufferInfo CreateSkeletonLinesBuffers()
 {
+	// no buffer of its own, the points are in the frame ring buffer bound to binding 0 every frame
 	OpenGLBufferInfo info = {};
-	glGenBuffers(1, &info.vbo);
 	glGenVertexArrays(1, &info.vao);
 	glBindVertexArray(info.vao);
-	glBindBuffer(GL_ARRAY_BUFFER, info.vbo);
-	glBufferData(GL_ARRAY_BUFFER, 0, 0, GL_DYNAMIC_DRAW);
 	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(float), 0);
+	glVertexAttribFormat(0, 4, GL_FLOAT, GL_FALSE, 0);
+	glVertexAttribBinding(0, 0);
 	glBindVertexArray(0);
 	
 	return info;
@@ -302,15 +480,19 @@ GLFWwindow* InitWindow(const char* tittle, int width, int height)
 	return window;
 }
 
-// create the points for the skeleton lines in a breath first search fashion
-void PrepareSkeletonLines(Joint* node, const glm::vec4& parent, std::vector<glm::mat4>& transforms, std::vector<glm::vec4>& points)
+// a line from every joint to its parent, the root starts at the origin. points has room for
+// two per joint, returns the number written
+std::size_t PrepareSkeletonLines(const Skeleton& skeleton, const std::vector<glm::mat4>& transforms, glm::vec4* points)
 {
-	points.push_back(parent);
-	points.push_back(transforms[node->ID] * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
-	for (Joint* child : node->Children)
+	const glm::vec4 origin(0.0f, 0.0f, 0.0f, 1.0f);
+	std::size_t count = 0;
+	for (std::size_t i = 0; i < skeleton.GetJointCount(); ++i)
 	{
-		PrepareSkeletonLines(child, transforms[node->ID] * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f), transforms, points);
+		const int parent = skeleton.Parents[i];
+		points[count++] = parent < 0 ? origin : transforms[parent] * origin;
+		points[count++] = transforms[i] * origin;
 	}
+	return count;
 }
 
 void BreathFirstSearchPrint(Joint* node, std::string identation)
@@ -334,74 +516,6 @@ void BreathFirstSearchPrint(Joint* node, std::string identation)
 }
 
 
-unsigned CreateSkeletonJointsBuffers()
-{
-	static float vertices[] = {
-		//back
-		-0.5f, -0.5f, -0.5f,  0.0f, 0.0f, 0.0f,0.0f,-1.0f,
-		 0.5f, -0.5f, -0.5f,  1.0f, 0.0f, 0.0f,0.0f,-1.0f,
-		 0.5f,  0.5f, -0.5f,  1.0f, 1.0f, 0.0f,0.0f,-1.0f,
-		 0.5f,  0.5f, -0.5f,  1.0f, 1.0f, 0.0f,0.0f,-1.0f,
-		-0.5f,  0.5f, -0.5f,  0.0f, 1.0f, 0.0f,0.0f,-1.0f,
-		-0.5f, -0.5f, -0.5f,  0.0f, 0.0f, 0.0f,0.0f,-1.0f,
-		//front
-		-0.5f, -0.5f,  0.5f,  0.0f, 0.0f,  0.0f,0.0f,1.0f,
-		0.5f, -0.5f,  0.5f,  1.0f, 0.0f,  0.0f,0.0f,1.0f,
-		0.5f,  0.5f,  0.5f,  1.0f, 1.0f,  0.0f,0.0f,1.0f,
-		0.5f,  0.5f,  0.5f,  1.0f, 1.0f,  0.0f,0.0f,1.0f,
-		-0.5f,  0.5f,  0.5f,  0.0f, 1.0f, 0.0f,0.0f,1.0f,
-		-0.5f, -0.5f,  0.5f,  0.0f, 0.0f, 0.0f,0.0f,1.0f,
-		//left
-		-0.5f,  0.5f,  0.5f,  1.0f, 0.0f, -1.0f,0.0f,0.0f,
-		-0.5f,  0.5f, -0.5f,  1.0f, 1.0f,  -1.0f,0.0f,0.0f,
-		-0.5f, -0.5f, -0.5f,  0.0f, 1.0f,   -1.0f,0.0f,0.0f,
-		-0.5f, -0.5f, -0.5f,  0.0f, 1.0f,   -1.0f,0.0f,0.0f,
-		-0.5f, -0.5f,  0.5f,  0.0f, 0.0f,   -1.0f,0.0f,0.0f,
-		-0.5f,  0.5f,  0.5f,  1.0f, 0.0f,   -1.0f,0.0f,0.0f,
-		//right
-		 0.5f,  0.5f,  0.5f,  1.0f, 0.0f, 1.0f,0.0f,0.0f,
-		 0.5f,  0.5f, -0.5f,  1.0f, 1.0f,  1.0f,0.0f,0.0f,
-		 0.5f, -0.5f, -0.5f,  0.0f, 1.0f,  1.0f,0.0f,0.0f,
-		 0.5f, -0.5f, -0.5f,  0.0f, 1.0f,  1.0f,0.0f,0.0f,
-		 0.5f, -0.5f,  0.5f,  0.0f, 0.0f,  1.0f,0.0f,0.0f,
-		 0.5f,  0.5f,  0.5f,  1.0f, 0.0f,  1.0f,0.0f,0.0f,
-		 //Bottom
-		-0.5f, -0.5f, -0.5f,  0.0f, 1.0f, 0.0f,-1.0f,0.0f,
-		 0.5f, -0.5f, -0.5f,  1.0f, 1.0f, 0.0f,-1.0f,0.0f,
-		 0.5f, -0.5f,  0.5f,  1.0f, 0.0f, 0.0f,-1.0f,0.0f,
-		 0.5f, -0.5f,  0.5f,  1.0f, 0.0f, 0.0f,-1.0f,0.0f,
-		-0.5f, -0.5f,  0.5f,  0.0f, 0.0f, 0.0f,-1.0f,0.0f,
-		-0.5f, -0.5f, -0.5f,  0.0f, 1.0f, 0.0f,-1.0f,0.0f,
-		// Up
-		-0.5f,  0.5f, -0.5f,  0.0f, 1.0f, 0.0f,1.0f,0.0f,
-		 0.5f,  0.5f, -0.5f,  1.0f, 1.0f, 0.0f,1.0f,0.0f,
-		 0.5f,  0.5f,  0.5f,  1.0f, 0.0f, 0.0f,1.0f,0.0f,
-		 0.5f,  0.5f,  0.5f,  1.0f, 0.0f, 0.0f,1.0f,0.0f,
-		-0.5f,  0.5f,  0.5f,  0.0f, 0.0f, 0.0f,1.0f,0.0f,
-		-0.5f,  0.5f, -0.5f,  0.0f, 1.0f, 0.0f,1.0f,0.0f
-	};
-
-	unsigned int VBO, VAO;
-	glGenVertexArrays(1, &VAO);
-	glGenBuffers(1, &VBO);
-	glBindVertexArray(VAO);
-	glBindBuffer(GL_ARRAY_BUFFER, VBO);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-	// position attribute
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-	glEnableVertexAttribArray(0);
-	// texture coord attribute
-	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
-	glEnableVertexAttribArray(1);
-	// texture coord attribute
-	glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(5 * sizeof(float)));
-	glEnableVertexAttribArray(2);
-	//unbind
-	glBindVertexArray(0);
-	return VAO;
-}
-
-
 void setupImGui(GLFWwindow* window)
 {
 	// Setup Dear ImGui context
@@ -439,7 +553,7 @@ void cleanUpImGui()
 }
 
 
-void renderImGui(GuiData& data)
+void renderImGui(GuiData& data, const RenderQueueStats& renderStats)
 {
 
 	if (ImGui::BeginMainMenuBar())
@@ -473,6 +587,11 @@ void renderImGui(GuiData& data)
 	ImGui::SliderFloat("scale model x", &data.scale.x, -0.5f, 20.0f, "ratio = %.01f");
 	ImGui::SliderFloat("scale model y", &data.scale.y, -0.5f, 20.0f, "ratio = %.01f");
 	ImGui::SliderFloat("scale model z", &data.scale.z, -0.5f, 20.0f, "ratio = %.01f");
+	ImGui::Checkbox("skinned mesh", &data.showMesh);
+	ImGui::Checkbox("dual quaternion skinning", &data.dualQuaternionSkinning);
+	// stays put once every program has been used: the uniforms come from the tables built at link time
+	ImGui::Text("glGetUniformLocation calls: %u", (unsigned)ShaderProgram::GetUniformLocationQueryCount());
+	ImGui::Text("draws: %u, state changes: %u (%u filtered)", (unsigned)renderStats.Draws, (unsigned)renderStats.StateChanges, (unsigned)renderStats.FilteredStateChanges);
 	ImGui::Separator();
 	ImGui::SliderFloat("scale x", &data.scaleJoints.x, 0.0f, 100.0f, "ratio = %.01f");
 	ImGui::SliderFloat("scale y", &data.scaleJoints.y, 0.0f, 100.0f, "ratio = %.01f");
@@ -532,3 +651,842 @@ OpenGLBufferInfo CreateWorldGrid(int slices, std::vector<float>& grid)
 	return info;
 
 }
+
+// updates characters instances of the animation of path with AnimationSystem and prints the throughput.
+// With threads > 0 the update is split over a JobSystem of that many workers. With lod the
+// characters are a crowd going away from the camera, or all evaluated every lodInterval frames
+int RunAnimationBenchmark(const char* path, int characters, int threads, bool lod, int lodInterval)
+{
+	AnimationCache cache;
+	if (!cache.Open(path, AnimationCache::GetCachePath(path).c_str()))
+	{
+		std::cerr << "could not load " << path << std::endl;
+		return 1;
+	}
+	Joint* root = cache.CreateJointHerarchy();
+	Skeleton skeleton = Skeleton::FromJointTree(root);
+	delete root;
+
+	AnimationSystem system;
+	int clip = system.AddClip(system.AddSkeleton(skeleton), cache.CreateAnimation());
+	// different start times and speeds so the characters don't sample the same key frames
+	for (int i = 0; i < characters; ++i)
+		system.AddInstance(clip, 0.75f + 0.5f * (i % 7) / 6.0f, 0.013f * i);
+
+	// a crowd in a row going away from the camera at the origin
+	if (lod)
+	{
+		AnimationLodPolicy policy;
+		if (lodInterval > 0)
+			policy.Levels = { { 0.0f, lodInterval, false } };
+		else
+			policy.Levels = { { 0.0f, 1, false }, { 500.0f, 1, true }, { 1000.0f, 2, true }, { 2000.0f, 4, true } };
+		system.SetLodPolicy(policy);
+		for (int i = 0; i < characters; ++i)
+			system.SetPosition(i, glm::vec3(0.0f, 0.0f, 3000.0f * i / characters));
+	}
+
+	std::unique_ptr<JobSystem> jobs;
+	if (threads > 0)
+		jobs.reset(new JobSystem(threads));
+	auto update = [&]() {
+		if (jobs) system.Update(1.0f / 60.0f, *jobs);
+		else system.Update(1.0f / 60.0f);
+	};
+
+	constexpr int warmup = 30;
+	constexpr int updates = 300;
+	for (int i = 0; i < warmup; ++i)
+		update();
+
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < updates; ++i)
+		update();
+	double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	std::cout << characters << " characters, " << skeleton.GetJointCount() << " joints, " << threads << " threads: "
+		<< std::setprecision(3) << std::fixed << ms / updates << " ms/update, "
+		<< characters * updates / ms << " characters/ms" << std::endl;
+	if (lod)
+	{
+		const AnimationLodStats& stats = system.GetTotalLodStats();
+		std::cout << "lod: " << stats.EvaluatedBones << " bones evaluated, " << stats.SavedBones << " saved ("
+			<< std::setprecision(1) << 100.0 * stats.SavedBones / (stats.EvaluatedBones + stats.SavedBones) << "%), "
+			<< stats.InterpolatedBones << " bones interpolated, " << stats.InterpolatedInstances << " interpolated poses" << std::endl;
+	}
+	return 0;
+}
+
+// blends the key frames of the animation of path with every kernel this cpu runs, prints
+// bones/second and the largest difference with the glm path
+int RunPoseKernelBenchmark(const char* path)
+{
+	AnimationCache cache;
+	if (!cache.Open(path, AnimationCache::GetCachePath(path).c_str()))
+	{
+		std::cerr << "could not load " << path << std::endl;
+		return 1;
+	}
+	std::vector<JointAnimation> animation = cache.CreateAnimation();
+	const float duration = ComputeAnimationDuration(animation);
+
+	// the key frame pairs of every channel at many times, in full batches
+	std::vector<std::unique_ptr<PoseBatch>> batches;
+	std::vector<glm::mat4> reference;
+	PoseBatch batch;
+	batch.Count = 0;
+	for (int step = 0; step < 256 && duration > 0.0f; ++step)
+	{
+		const float time = std::fmod(step * 0.0371f, duration);
+		for (const JointAnimation& channel : animation)
+		{
+			if (channel.Frames.empty()) continue;
+			std::size_t cursor = 0;
+			const KeyFrameSample keys = SampleKeys(channel.Frames, cursor, time);
+			batch.Add(*keys.Previous, *keys.Next, keys.Progression, (int)batch.Count);
+
+			cursor = 0;
+			reference.push_back(SampleKeyFrames(channel.Frames, cursor, time));
+			if (batch.IsFull())
+			{
+				batches.emplace_back(new PoseBatch(batch));
+				batch.Count = 0;
+			}
+		}
+	}
+	if (batches.empty())
+	{
+		std::cerr << path << " has too few animated joints" << std::endl;
+		return 1;
+	}
+	reference.resize(batches.size() * PoseBatch::Capacity);
+
+	glm::mat4 out[PoseBatch::Capacity];
+	const PoseKernelIsa isas[] = { PoseKernelIsa::Scalar, PoseKernelIsa::SSE2, PoseKernelIsa::AVX2 };
+	for (PoseKernelIsa isa : isas)
+	{
+		if (!IsPoseKernelIsaSupported(isa)) continue;
+
+		float maxError = 0.0f;
+		for (std::size_t b = 0; b < batches.size(); ++b)
+		{
+			BlendPoseBatch(*batches[b], out, isa);
+			for (std::size_t i = 0; i < PoseBatch::Capacity; ++i)
+				for (int c = 0; c < 4; ++c)
+					for (int r = 0; r < 4; ++r)
+						maxError = std::max(maxError, std::abs(out[i][c][r] - reference[b * PoseBatch::Capacity + i][c][r]));
+		}
+
+		int rounds = 0;
+		auto start = std::chrono::steady_clock::now();
+		auto elapsed = std::chrono::steady_clock::duration::zero();
+		while (elapsed < std::chrono::milliseconds(500))
+		{
+			for (const auto& b : batches)
+				BlendPoseBatch(*b, out, isa);
+			++rounds;
+			elapsed = std::chrono::steady_clock::now() - start;
+		}
+		double seconds = std::chrono::duration<double>(elapsed).count();
+
+		std::cout << GetPoseKernelIsaName(isa) << (isa == GetPoseKernelIsa() ? " (used)" : "") << ": "
+			<< std::setprecision(1) << std::fixed << rounds * batches.size() * PoseBatch::Capacity / seconds / 1e6 << "M bones/s, max error "
+			<< std::setprecision(7) << maxError << std::endl;
+	}
+	return 0;
+}
+
+// converts the text of every <float_array> and <matrix> of path to floats with the old split +
+// atof path and with ScanFloats, prints floats/second of both and the values that differ
+int RunFloatScannerBenchmark(const char* path)
+{
+	std::ifstream file(path, std::ios::binary);
+	if (!file.is_open())
+	{
+		std::cerr << "could not read " << path << std::endl;
+		return 1;
+	}
+	std::stringstream content;
+	content << file.rdbuf();
+	const std::string text = content.str();
+
+	std::vector<std::string> arrays;
+	for (const char* tag : { "<float_array", "<matrix" })
+	{
+		for (std::size_t start = text.find(tag); start != std::string::npos; start = text.find(tag, start))
+		{
+			const std::size_t begin = text.find('>', start);
+			const std::size_t end = begin == std::string::npos ? begin : text.find('<', begin);
+			if (end == std::string::npos) break;
+			arrays.push_back(text.substr(begin + 1, end - begin - 1));
+			start = end;
+		}
+	}
+
+	std::vector<std::vector<float>> atofValues(arrays.size()), scannedValues(arrays.size());
+	std::vector<std::string> tokens;
+	double atofSeconds = 0.0, scannerSeconds = 0.0;
+	std::size_t floats = 0;
+	constexpr int repeats = 5;
+	for (int repeat = 0; repeat < repeats; ++repeat)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		for (std::size_t i = 0; i < arrays.size(); ++i)
+		{
+			// the loader before FloatScanner.h: a std::string per number
+			tokens.clear();
+			splitString(arrays[i], tokens, ' ');
+			atofValues[i].clear();
+			for (const std::string& token : tokens)
+			{
+				if (!token.empty())
+					atofValues[i].push_back((float)std::atof(token.c_str()));
+			}
+		}
+		auto middle = std::chrono::high_resolution_clock::now();
+		floats = 0;
+		for (std::size_t i = 0; i < arrays.size(); ++i)
+		{
+			scannedValues[i].clear();
+			floats += ScanFloats(arrays[i].c_str(), scannedValues[i]);
+		}
+		auto end = std::chrono::high_resolution_clock::now();
+		atofSeconds += std::chrono::duration<double>(middle - start).count();
+		scannerSeconds += std::chrono::duration<double>(end - middle).count();
+	}
+
+	std::size_t mismatches = 0;
+	for (std::size_t i = 0; i < arrays.size(); ++i)
+	{
+		const std::vector<float>& expected = atofValues[i];
+		const std::vector<float>& scanned = scannedValues[i];
+		mismatches += expected.size() > scanned.size() ? expected.size() - scanned.size() : scanned.size() - expected.size();
+		for (std::size_t k = 0; k < std::min(expected.size(), scanned.size()); ++k)
+			mismatches += std::memcmp(&expected[k], &scanned[k], sizeof(float)) == 0 ? 0 : 1;
+	}
+
+	std::cout << path << ": " << floats << " floats in " << arrays.size() << " arrays, split + atof "
+		<< std::setprecision(1) << std::fixed << floats * repeats / atofSeconds / 1000000.0 << " Mfloat/s, ScanFloats "
+		<< floats * repeats / scannerSeconds / 1000000.0 << " Mfloat/s, " << mismatches << " values differ" << std::defaultfloat << std::endl;
+	return mismatches == 0 ? 0 : 1;
+}
+
+// the breadth first regex search ColladaParser used before ColladaIndex, without its print
+static xmlNode* FindByPropertyRegex(xmlNode* root, const char* property, const std::regex& pattern)
+{
+	std::queue<xmlNode*> q;
+	q.push(root);
+	while (!q.empty())
+	{
+		xmlNode* node = q.front();
+		q.pop();
+		if (!node) continue;
+
+		for (xmlAttr* attr = node->properties; attr; attr = attr->next)
+		{
+			if (std::strcmp((const char*)attr->name, property) == 0 && attr->children &&
+				std::regex_match(std::string((const char*)attr->children->content), pattern))
+				return node;
+		}
+		for (xmlNode* child = node->children; child; child = child->next)
+			q.push(child);
+	}
+	return nullptr;
+}
+
+// ColladaParser::FindRootJoint
+static xmlNode* FindFirstJoint(xmlNode* root)
+{
+	std::queue<xmlNode*> q;
+	q.push(root);
+	while (!q.empty())
+	{
+		xmlNode* node = q.front();
+		q.pop();
+		xmlChar* type = xmlGetProp(node, (const xmlChar*)"type");
+		const bool isJoint = type && std::strcmp((const char*)type, "JOINT") == 0;
+		xmlFree(type);
+		if (isJoint) return node;
+
+		for (xmlNode* child = node->children; child; child = child->next)
+		{
+			if (child->type == XML_ELEMENT_NODE)
+				q.push(child);
+		}
+	}
+	return nullptr;
+}
+
+static void CollectJointNodes(xmlNode* node, std::vector<xmlNode*>& out)
+{
+	out.push_back(node);
+	for (xmlNode* child = node->children; child; child = child->next)
+	{
+		xmlChar* type = xmlGetProp(child, (const xmlChar*)"type");
+		if (type && std::strcmp((const char*)type, "JOINT") == 0)
+			CollectJointNodes(child, out);
+		xmlFree(type);
+	}
+}
+
+// finds the armature, the root joint, the joint names and the transform of every joint of path
+// with the old regex searches and with ColladaIndex (its build included), best of the repeats
+int RunColladaIndexBenchmark(const char* path)
+{
+	xmlDocPtr document = xmlReadFile(path, NULL, XML_PARSE_NOBLANKS);
+	if (!document)
+	{
+		std::cerr << "could not read " << path << std::endl;
+		return 1;
+	}
+	xmlNode* root = xmlDocGetRootElement(document);
+
+	const std::regex armaturePattern("(Armature)"), jointPattern("(JOINT)"), transformPattern("(transform)");
+	const std::regex namesPattern("Armature_[[:w:]]+-skin-joints-array");
+	xmlNode* armature = FindByPropertyRegex(root, "id", armaturePattern);
+	xmlNode* rootJoint = armature ? FindByPropertyRegex(armature, "type", jointPattern) : nullptr;
+	if (!rootJoint)
+	{
+		std::cerr << path << ": no Armature with joints" << std::endl;
+		xmlFreeDoc(document);
+		return 1;
+	}
+	std::vector<xmlNode*> joints;
+	CollectJointNodes(rootJoint, joints);
+
+	std::vector<xmlNode*> regexFound, indexFound;
+	double regexMicroseconds = 1e30, indexMicroseconds = 1e30;
+	std::size_t indexSize = 0;
+	constexpr int repeats = 50;
+	for (int repeat = 0; repeat < repeats; ++repeat)
+	{
+		regexFound.clear();
+		indexFound.clear();
+		auto start = std::chrono::high_resolution_clock::now();
+		xmlNode* node = FindByPropertyRegex(root, "id", armaturePattern);
+		regexFound.push_back(node);
+		regexFound.push_back(FindByPropertyRegex(node, "type", jointPattern));
+		regexFound.push_back(FindByPropertyRegex(root, "id", namesPattern));
+		for (xmlNode* joint : joints)
+			regexFound.push_back(FindByPropertyRegex(joint, "sid", transformPattern));
+		auto middle = std::chrono::high_resolution_clock::now();
+
+		// what ColladaParser does now: the root joint is still a walk, the names go through the
+		// JOINT input of <joints>
+		ColladaIndex index;
+		index.Build(root);
+		node = index.FindById("Armature");
+		indexFound.push_back(node);
+		indexFound.push_back(node ? FindFirstJoint(node) : nullptr);
+		xmlNode* names = nullptr;
+		if (xmlNode* skinJoints = index.FindElement("joints"))
+		{
+			for (xmlNode* input = skinJoints->children; input && !names; input = input->next)
+			{
+				xmlChar* semantic = xmlGetProp(input, (const xmlChar*)"semantic");
+				xmlChar* source = xmlGetProp(input, (const xmlChar*)"source");
+				if (semantic && source && std::strcmp((const char*)semantic, "JOINT") == 0)
+				{
+					xmlNode* sourceNode = index.FindByUrl((const char*)source);
+					names = sourceNode ? xmlFirstElementChild(sourceNode) : nullptr;
+				}
+				xmlFree(semantic);
+				xmlFree(source);
+			}
+		}
+		indexFound.push_back(names);
+		for (xmlNode* joint : joints)
+			indexFound.push_back(index.FindBySid(joint, "transform"));
+		auto end = std::chrono::high_resolution_clock::now();
+
+		indexSize = index.GetSize();
+		regexMicroseconds = std::min(regexMicroseconds, std::chrono::duration<double, std::micro>(middle - start).count());
+		indexMicroseconds = std::min(indexMicroseconds, std::chrono::duration<double, std::micro>(end - middle).count());
+	}
+	xmlFreeDoc(document);
+
+	std::size_t differences = 0;
+	for (std::size_t i = 0; i < regexFound.size(); ++i)
+		differences += regexFound[i] == indexFound[i] ? 0 : 1;
+
+	std::cout << path << ": " << joints.size() << " joints, " << indexSize << " index entries, regex "
+		<< std::setprecision(1) << std::fixed << regexMicroseconds << " us, index " << indexMicroseconds << " us, "
+		<< differences << " nodes differ" << std::defaultfloat << std::endl;
+	return differences == 0 ? 0 : 1;
+}
+
+// compresses the animation of path and prints the compression ratio and the largest error
+int RunClipCompression(const char* path, float tolerance)
+{
+	AnimationCache cache;
+	if (!cache.Open(path, AnimationCache::GetCachePath(path).c_str()))
+	{
+		std::cerr << "could not load " << path << std::endl;
+		return 1;
+	}
+
+	ClipCompressionSettings settings;
+	settings.Tolerance = tolerance;
+	ClipCompressionStats stats;
+	CompressClip(cache.CreateAnimation(), settings, &stats);
+
+	std::cout << path << ": " << stats.OriginalKeys << " -> " << stats.CompressedKeys << " keys, "
+		<< stats.OriginalBytes << " -> " << stats.CompressedBytes << " bytes, ratio "
+		<< std::setprecision(2) << std::fixed << stats.GetRatio() << ", max error "
+		<< std::setprecision(5) << stats.MaxError << " (" << stats.MaxErrorChannel << ", tolerance "
+		<< stats.Tolerance << " at " << stats.ShellDistance << ")" << std::endl;
+	return 0;
+}
+
+// plays the first clip of path and skins its meshes on the cpu with every kernel this cpu runs,
+// linear blend and dual quaternions, prints the cost per vertex and the largest difference with
+// the scalar kernel of the mode
+int RunSkinning(const char* path, int threads)
+{
+	ColladaParser parser;
+	ColladaAsset asset = parser.Load(path);
+	if (!asset.Skeleton || asset.Clips.empty() || asset.Meshes.empty())
+	{
+		std::cerr << "no skinned mesh and animation in " << path << std::endl;
+		delete asset.Skeleton;
+		return 1;
+	}
+
+	Animator animator{ asset.Skeleton, asset.Clips.front().Animation };
+	const Skeleton& skeleton = animator.GetSkeleton();
+	std::vector<glm::mat4> pose(skeleton.GetJointCount());
+	std::unique_ptr<JobSystem> jobs;
+	if (threads > 0)
+		jobs.reset(new JobSystem(threads));
+
+	const PoseKernelIsa isas[] = { PoseKernelIsa::Scalar, PoseKernelIsa::SSE2, PoseKernelIsa::AVX2 };
+	const SkinningMode modes[] = { SkinningMode::LinearBlend, SkinningMode::DualQuaternion };
+	for (const SkinnedMeshData& data : asset.Meshes)
+	{
+		SkinningMesh mesh = SkinningMesh::FromMeshData(data, skeleton);
+		const std::size_t count = mesh.GetVertexCount();
+		std::vector<glm::mat4> skin(mesh.GetJointCount());
+		std::vector<SkinningDualQuaternion> skinDualQuaternions(mesh.GetJointCount());
+		std::vector<glm::vec4> referencePositions(count), referenceNormals(count), positions(count), normals(count);
+		std::cout << data.Name << ": " << count << " vertices, " << data.Indices.size() / 3 << " triangles, " << mesh.GetJointCount() << " joints" << std::endl;
+
+		for (SkinningMode mode : modes)
+		{
+			const bool dualQuaternion = mode == SkinningMode::DualQuaternion;
+			for (PoseKernelIsa isa : isas)
+			{
+				if (!IsPoseKernelIsaSupported(isa)) continue;
+
+				constexpr int frames = 200;
+				float maxDifference = 0.0f;
+				double ms = 0.0;
+				for (int frame = 0; frame < frames; ++frame)
+				{
+					animator.Update(1.0f / 60.0f);
+					animator.GetGlobalTransforms(pose.data(), pose.size());
+					ComputeSkinningMatrices(mesh, pose.data(), skin.data());
+					ComputeSkinningDualQuaternions(mesh, pose.data(), skinDualQuaternions.data());
+					if (dualQuaternion) SkinVertices(mesh, skinDualQuaternions.data(), 0, count, referencePositions.data(), referenceNormals.data(), PoseKernelIsa::Scalar);
+					else SkinVertices(mesh, skin.data(), 0, count, referencePositions.data(), referenceNormals.data(), PoseKernelIsa::Scalar);
+
+					auto start = std::chrono::steady_clock::now();
+					if (jobs && dualQuaternion) SkinVertices(mesh, skinDualQuaternions.data(), positions.data(), normals.data(), *jobs);
+					else if (jobs) SkinVertices(mesh, skin.data(), positions.data(), normals.data(), *jobs);
+					else if (dualQuaternion) SkinVertices(mesh, skinDualQuaternions.data(), 0, count, positions.data(), normals.data(), isa);
+					else SkinVertices(mesh, skin.data(), 0, count, positions.data(), normals.data(), isa);
+					ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+					for (std::size_t i = 0; i < count; ++i)
+					{
+						maxDifference = std::max(maxDifference, glm::length(positions[i] - referencePositions[i]));
+						maxDifference = std::max(maxDifference, glm::length(normals[i] - referenceNormals[i]));
+					}
+				}
+
+				std::cout << "  " << (dualQuaternion ? "dual quaternion " : "linear blend ") << (jobs ? "threads" : GetPoseKernelIsaName(isa)) << ": "
+					<< std::setprecision(1) << std::fixed << count * frames / ms / 1000.0 << " M vertices/s, "
+					<< std::setprecision(2) << ms * 1000000.0 / (count * frames) << " ns/vertex, max difference " << std::setprecision(7) << maxDifference << std::endl;
+				// the threads use the best kernel
+				if (jobs) break;
+			}
+		}
+	}
+	return 0;
+}
+
+// Shaders/skin_vert.sh for one vertex on the cpu, the same operations in the same order.
+// bones and dualQuaternions are the bound palettes, the joints are already offset by paletteOffset
+static void SkinVertexLikeShader(const glm::vec3& vertexPosition, const glm::vec3& vertexNormal, const glm::ivec4& joints, const glm::vec4& weights,
+	const glm::mat4* bones, const SkinningDualQuaternion* dualQuaternions, bool dualQuaternionSkinning, glm::vec3& position, glm::vec3& normal)
+{
+	if (dualQuaternionSkinning)
+	{
+		const SkinningDualQuaternion& q0 = dualQuaternions[joints.x];
+		const SkinningDualQuaternion& q1 = dualQuaternions[joints.y];
+		const SkinningDualQuaternion& q2 = dualQuaternions[joints.z];
+		const SkinningDualQuaternion& q3 = dualQuaternions[joints.w];
+		const glm::vec4 w = weights * glm::vec4(1.0f, glm::dot(q0.Real, q1.Real) < 0.0f ? -1.0f : 1.0f,
+			glm::dot(q0.Real, q2.Real) < 0.0f ? -1.0f : 1.0f, glm::dot(q0.Real, q3.Real) < 0.0f ? -1.0f : 1.0f);
+		glm::vec4 r = ((w.x * q0.Real + w.y * q1.Real) + w.z * q2.Real) + w.w * q3.Real;
+		glm::vec4 d = ((w.x * q0.Dual + w.y * q1.Dual) + w.z * q2.Dual) + w.w * q3.Dual;
+		const float scale = glm::dot(weights, glm::vec4(q0.Scale, q1.Scale, q2.Scale, q3.Scale));
+		const float len = glm::length(r);
+		r /= len;
+		d /= len;
+
+		const glm::vec3 rv(r);
+		auto rotate = [&](const glm::vec3& v) { return v + 2.0f * glm::cross(rv, glm::cross(rv, v) + r.w * v); };
+		const glm::vec3 translation = 2.0f * (r.w * glm::vec3(d) - d.w * rv + glm::cross(rv, glm::vec3(d)));
+		position = rotate(scale * vertexPosition) + translation;
+		normal = rotate(vertexNormal);
+	}
+	else
+	{
+		const glm::mat4 skin = ((weights.x * bones[joints.x] + weights.y * bones[joints.y]) + weights.z * bones[joints.z]) + weights.w * bones[joints.w];
+		position = glm::vec3(skin * glm::vec4(vertexPosition, 1.0f));
+		normal = glm::mat3(skin) * vertexNormal;
+	}
+}
+
+// one vertex of a recorded attribute as the vertex shader reads it, the missing components
+// are (0, 0, 0, 1) like in gl. False if the attribute isn't enabled, isn't of type T (floats of
+// glVertexAttribPointer, ints of glVertexAttribIPointer) or is outside of its buffer
+template <typename T>
+static bool FetchAttribute(const GLCallRecorder& recorder, const GLCallRecorder::VertexAttribute& attribute, std::size_t vertex, glm::tvec4<T>& value)
+{
+	const bool integer = std::is_integral<T>::value;
+	const unsigned int type = integer ? GL_INT : GL_FLOAT;
+	if (!attribute.Enabled || attribute.Integer != integer || attribute.Normalized || attribute.Type != type || attribute.Size < 1 || attribute.Size > 4)
+		return false;
+	const std::size_t size = attribute.Size * sizeof(T);
+	const std::size_t stride = attribute.Stride ? attribute.Stride : size;
+	const unsigned char* data = recorder.GetBufferData(attribute.Buffer, attribute.Offset + vertex * stride, size);
+	if (!data) return false;
+	value = glm::tvec4<T>(0, 0, 0, 1);
+	std::memcpy(&value[0], data, size);
+	return true;
+}
+
+// draws every mesh of path with SkinnedMeshRenderer, BonePalette and the render queue on
+// GLCallRecorder, with and without the persistent mapping of the ring buffer. Every draw is
+// skinned with the math of the skinning shader from what gl would read: the vertex buffer through
+// the recorded attribute pointers, the palette range bound to the storage block and the
+// paletteOffset uniform. Fails if a vertex can't be read, points outside of the palette, or a
+// position (relative to its distance to the origin, at least 1) or a normal is further than the
+// tolerance from the cpu skinning in any frame
+int RunGpuSkinningCheck(const char* path)
+{
+	ColladaParser parser;
+	ColladaAsset asset = parser.Load(path);
+	if (!asset.Skeleton || asset.Clips.empty() || asset.Meshes.empty())
+	{
+		std::cerr << "no skinned mesh and animation in " << path << std::endl;
+		delete asset.Skeleton;
+		return 1;
+	}
+
+	Animator animator{ asset.Skeleton, asset.Clips.front().Animation };
+	const Skeleton& skeleton = animator.GetSkeleton();
+	std::vector<glm::mat4> pose(skeleton.GetJointCount());
+
+	std::vector<SkinningMesh> meshes;
+	std::vector<std::size_t> offsets;
+	std::size_t paletteSize = 0;
+	for (const SkinnedMeshData& data : asset.Meshes)
+	{
+		meshes.push_back(SkinningMesh::FromMeshData(data, skeleton));
+		offsets.push_back(paletteSize);
+		paletteSize += meshes.back().GetJointCount();
+	}
+	// the transforms of the frame for the cpu skinning, copied into the palette: the mapped
+	// buffer is never read back
+	std::vector<glm::mat4> bones(paletteSize);
+	std::vector<SkinningDualQuaternion> dualQuaternions(paletteSize);
+	std::vector<glm::vec4> positions, normals;
+
+	// a few float roundings, the kernels multiply and normalize in their own order
+	constexpr float tolerance = 2e-6f;
+	const SkinningMode modes[] = { SkinningMode::LinearBlend, SkinningMode::DualQuaternion };
+	int failed = 0;
+	for (bool persistent : { true, false })
+	{
+		GLCallRecorder recorder(persistent);
+		ShaderProgram program{};
+		RenderQueue queue;
+		// small, the first frames make it grow
+		FrameRingBuffer ring(1 << 16);
+		BonePalette palette(ring);
+		std::vector<std::unique_ptr<SkinnedMeshRenderer>> renderers;
+		for (std::size_t m = 0; m < meshes.size(); ++m)
+		{
+			renderers.emplace_back(new SkinnedMeshRenderer(nullptr, &program, &asset.Meshes[m], &meshes[m], &palette));
+			renderers.back()->SetUp();
+		}
+
+		for (SkinningMode mode : modes)
+		{
+			const bool dualQuaternion = mode == SkinningMode::DualQuaternion;
+			float maxPosition = 0.0f, maxNormal = 0.0f;
+			std::size_t unreadable = 0;
+			constexpr int frames = 200;
+			for (int frame = 0; frame < frames; ++frame)
+			{
+				ring.BeginFrame();
+				animator.Update(1.0f / 60.0f);
+				animator.GetGlobalTransforms(pose.data(), pose.size());
+				// the same as the frames of the viewer
+				palette.Clear(dualQuaternion ? 0 : paletteSize, dualQuaternion ? paletteSize : 0);
+				for (std::size_t m = 0; m < meshes.size(); ++m)
+				{
+					const std::size_t count = meshes[m].GetJointCount();
+					std::size_t offset;
+					if (dualQuaternion)
+					{
+						ComputeSkinningDualQuaternions(meshes[m], pose.data(), dualQuaternions.data() + offsets[m]);
+						offset = palette.AllocateDualQuaternions(count);
+						std::memcpy(palette.GetDualQuaternions(offset), dualQuaternions.data() + offsets[m], count * sizeof(SkinningDualQuaternion));
+					}
+					else
+					{
+						ComputeSkinningMatrices(meshes[m], pose.data(), bones.data() + offsets[m]);
+						offset = palette.Allocate(count);
+						std::memcpy(palette.GetMatrices(offset), bones.data() + offsets[m], count * sizeof(glm::mat4));
+					}
+					renderers[m]->SetPaletteOffset(offset);
+					renderers[m]->SetSkinningMode(mode);
+				}
+				palette.Upload();
+
+				for (std::size_t m = 0; m < meshes.size(); ++m)
+				{
+					const std::size_t count = meshes[m].GetVertexCount();
+					positions.resize(count);
+					normals.resize(count);
+					if (dualQuaternion) SkinVertices(meshes[m], dualQuaternions.data() + offsets[m], 0, count, positions.data(), normals.data());
+					else SkinVertices(meshes[m], bones.data() + offsets[m], 0, count, positions.data(), normals.data());
+
+					// glDrawElements is gl 1.1 and isn't recorded, the state of the draw is the one
+					// left by the queue
+					renderers[m]->Submit(queue);
+					queue.Execute();
+					int paletteOffset = 0, dualQuaternionSkinning = 0;
+					const GLCallRecorder::BufferRange range = recorder.GetBufferRange(GL_SHADER_STORAGE_BUFFER,
+						dualQuaternion ? BonePalette::DualQuaternionBinding : BonePalette::Binding);
+					const unsigned char* boundPalette = recorder.GetBufferData(range.Buffer, range.Offset, range.Size);
+					const GLCallRecorder::VertexAttribute* attributes = recorder.GetVertexAttributes(renderers[m]->GetVertexArray());
+					if (!recorder.GetUniform("paletteOffset", paletteOffset) || !recorder.GetUniform("dualQuaternionSkinning", dualQuaternionSkinning)
+						|| (dualQuaternionSkinning != 0) != dualQuaternion || !boundPalette || !attributes)
+					{
+						unreadable += count;
+						continue;
+					}
+					const std::size_t entries = range.Size / (dualQuaternion ? sizeof(SkinningDualQuaternion) : sizeof(glm::mat4));
+
+					for (std::size_t i = 0; i < count; ++i)
+					{
+						glm::vec4 vertexPosition, textCoords, vertexNormal, weights;
+						glm::ivec4 joints;
+						bool readable = FetchAttribute(recorder, attributes[0], i, vertexPosition) && FetchAttribute(recorder, attributes[1], i, textCoords)
+							&& FetchAttribute(recorder, attributes[2], i, vertexNormal) && FetchAttribute(recorder, attributes[3], i, joints)
+							&& FetchAttribute(recorder, attributes[4], i, weights);
+						joints += glm::ivec4(paletteOffset);
+						for (int k = 0; k < 4; ++k)
+							readable = readable && joints[k] >= 0 && (std::size_t)joints[k] < entries;
+						if (!readable)
+						{
+							++unreadable;
+							continue;
+						}
+
+						glm::vec3 position, normal;
+						SkinVertexLikeShader(glm::vec3(vertexPosition), glm::vec3(vertexNormal), joints, weights, reinterpret_cast<const glm::mat4*>(boundPalette),
+							reinterpret_cast<const SkinningDualQuaternion*>(boundPalette), dualQuaternion, position, normal);
+						const glm::vec3 expected(positions[i]);
+						maxPosition = std::max(maxPosition, glm::length(position - expected) / std::max(1.0f, glm::length(expected)));
+						// the fragment shader normalizes the normal
+						if (glm::length(normal) > 0.0f)
+							maxNormal = std::max(maxNormal, glm::length(glm::normalize(normal) - glm::vec3(normals[i])));
+					}
+				}
+				ring.EndFrame();
+			}
+
+			const bool passed = unreadable == 0 && maxPosition <= tolerance && maxNormal <= tolerance;
+			std::cout << (ring.IsPersistent() ? "persistent mapping, " : "glBufferSubData, ") << (dualQuaternion ? "dual quaternion" : "linear blend") << ", "
+				<< meshes.size() << " meshes, " << paletteSize << " palette entries: max position difference " << std::setprecision(3) << std::scientific << maxPosition
+				<< ", max normal difference " << maxNormal << std::defaultfloat << ", " << unreadable << " vertices not readable" << (passed ? "" : " FAILED") << std::endl;
+			failed += passed ? 0 : 1;
+		}
+	}
+	return failed;
+}
+
+// updates the animation of path through every per frame pose path (Animator, compressed clip,
+// AnimationBlender, AnimationSystem with and without lod) and counts the heap allocations of
+// the steady state frames. Fails if any path allocates, or if the allocations aren't counted
+// (built without COUNT_ALLOCATIONS)
+int RunAllocationCheck(const char* path, int characters)
+{
+	if (!IsCountingAllocations())
+	{
+		std::cerr << "built without COUNT_ALLOCATIONS, the allocations aren't counted" << std::endl;
+		return 1;
+	}
+	AnimationCache cache;
+	if (!cache.Open(path, AnimationCache::GetCachePath(path).c_str()))
+	{
+		std::cerr << "could not load " << path << std::endl;
+		return 1;
+	}
+	const std::vector<JointAnimation> animation = cache.CreateAnimation();
+	const std::shared_ptr<const CompressedClip> compressed = std::make_shared<CompressedClip>(CompressClip(animation));
+	Animator animator{ cache.CreateJointHerarchy(), animation };
+	Animator compressedAnimator{ cache.CreateJointHerarchy(), compressed };
+	const Skeleton& skeleton = animator.GetSkeleton();
+
+	AnimationBlender blender(skeleton);
+	blender.SetWeight(blender.AddClip(animation), 1.0f);
+	blender.CrossFade(blender.AddClip(animation), 2.0f);
+
+	AnimationSystem system;
+	int clip = system.AddClip(system.AddSkeleton(skeleton), animation);
+	for (int i = 0; i < characters; ++i)
+		system.AddInstance(clip, 0.75f + 0.5f * (i % 7) / 6.0f, 0.013f * i);
+	AnimationSystem lodSystem;
+	clip = lodSystem.AddClip(lodSystem.AddSkeleton(skeleton), animation);
+	AnimationLodPolicy policy;
+	policy.Levels = { { 0.0f, 1, false }, { 500.0f, 1, true }, { 1000.0f, 2, true }, { 2000.0f, 4, true } };
+	lodSystem.SetLodPolicy(policy);
+	for (int i = 0; i < characters; ++i)
+	{
+		lodSystem.AddInstance(clip, 0.75f + 0.5f * (i % 7) / 6.0f, 0.013f * i);
+		lodSystem.SetPosition(i, glm::vec3(0.0f, 0.0f, 3000.0f * i / characters));
+	}
+
+	// written in place every frame, like the main loop
+	std::vector<glm::mat4> locals(skeleton.GetJointCount());
+	std::vector<glm::mat4> globals(skeleton.GetJointCount());
+	const glm::mat4 root(1.0f);
+	struct PosePath
+	{
+		const char* Name;
+		std::function<void()> Frame;
+	};
+	const PosePath paths[] = {
+		{ "Animator", [&]() {
+			animator.Update(1.0f / 60.0f);
+			animator.GetBoneTransforms(locals.data(), locals.size());
+			animator.GetGlobalTransforms(globals.data(), globals.size(), root); } },
+		{ "Animator (compressed clip)", [&]() {
+			compressedAnimator.Update(1.0f / 60.0f);
+			compressedAnimator.GetGlobalTransforms(globals.data(), globals.size(), root); } },
+		{ "AnimationBlender", [&]() {
+			blender.Update(1.0f / 60.0f);
+			blender.GetGlobalTransforms(globals.data(), globals.size(), root); } },
+		{ "AnimationSystem", [&]() { system.Update(1.0f / 60.0f); } },
+		{ "AnimationSystem (lod)", [&]() { lodSystem.Update(1.0f / 60.0f); } },
+	};
+
+	constexpr int warmup = 10;
+	constexpr int frames = 600;
+	int failed = 0;
+	for (const PosePath& pose : paths)
+	{
+		for (int i = 0; i < warmup; ++i)
+			pose.Frame();
+		const std::size_t before = GetAllocationCount();
+		for (int i = 0; i < frames; ++i)
+			pose.Frame();
+		const std::size_t allocations = GetAllocationCount() - before;
+		std::cout << pose.Name << ": " << allocations << " allocations in " << frames << " frames" << std::endl;
+		failed += allocations == 0 ? 0 : 1;
+	}
+	return failed;
+}
+
+// draws the joints of 1, 10 and 100 characters of path with JointRenderer and the render queue
+// on GLCallRecorder, with and without the persistent mapping of the ring buffer. Fails unless
+// every frame is one instanced draw of all the joints reading the transforms of that frame with
+// the joint scale set, and the gl calls of a frame are the same whatever the number of characters
+int RunJointDrawCheck(const char* path)
+{
+	AnimationCache cache;
+	if (!cache.Open(path, AnimationCache::GetCachePath(path).c_str()))
+	{
+		std::cerr << "could not load " << path << std::endl;
+		return 1;
+	}
+	const std::vector<JointAnimation> animation = cache.CreateAnimation();
+	const Animator animator{ cache.CreateJointHerarchy(), animation };
+	const Skeleton& skeleton = animator.GetSkeleton();
+	const std::size_t jointCount = skeleton.GetJointCount();
+
+	int failed = 0;
+	for (bool persistent : { true, false })
+	{
+		std::size_t expectedCalls = 0;
+		for (int characters : { 1, 10, 100 })
+		{
+			GLCallRecorder recorder(persistent);
+			AnimationSystem system;
+			const int clip = system.AddClip(system.AddSkeleton(skeleton), animation);
+			for (int i = 0; i < characters; ++i)
+				system.AddInstance(clip, 0.75f + 0.5f * (i % 7) / 6.0f, 0.013f * i);
+
+			ShaderProgram program{};
+			RenderQueue queue;
+			// small, the first frames with many characters make it grow
+			FrameRingBuffer ring(1 << 16);
+			JointRenderer joints(nullptr, &program, ring);
+			joints.SetUp();
+			const glm::vec3 scale(2.0f, 3.0f, 4.0f);
+			const glm::mat4 jointTransform = glm::scale(glm::mat4(1.0f), scale);
+			joints.SetJointScale(scale);
+
+			const std::size_t bytes = characters * jointCount * sizeof(glm::mat4);
+			bool drawsMatch = true;
+			auto frame = [&]() {
+				ring.BeginFrame();
+				system.Update(1.0f / 60.0f);
+				joints.Clear(characters * jointCount);
+				for (int i = 0; i < characters; ++i)
+					joints.Add(system.GetPalette(i), jointCount);
+				joints.Submit(queue);
+				queue.Execute();
+				ring.EndFrame();
+
+				const std::vector<GLCallRecorder::InstancedDraw>& draws = recorder.GetInstancedDraws();
+				if (draws.empty()) { drawsMatch = false; return; }
+				const GLCallRecorder::VertexBufferBinding& instances = draws.back().Bindings[JointRenderer::InstanceBinding];
+				const unsigned char* data = recorder.GetBufferData(instances.Buffer, instances.Offset, bytes);
+				glm::mat4 uniform(0.0f);
+				drawsMatch = drawsMatch && draws.back().Instances == (int)(characters * jointCount) && instances.Stride == sizeof(glm::mat4)
+					&& data && std::memcmp(data, system.GetPalettes().data(), bytes) == 0
+					&& recorder.GetUniform("jointTransform", &uniform[0][0], 16) && uniform == jointTransform;
+			};
+
+			// the first frames grow the ring buffer, then every region gets its fence
+			constexpr int warmup = 2 * (int)FrameRingBuffer::DefaultFrameCount;
+			constexpr int frames = 60;
+			for (int i = 0; i < warmup; ++i)
+				frame();
+			recorder.ClearCalls();
+			drawsMatch = true;
+			for (int i = 0; i < frames; ++i)
+				frame();
+
+			// the draw, the ring buffer fences or uploads. glEnable of the depth test is gl 1.1 and
+			// isn't counted
+			const std::size_t draws = recorder.GetInstancedDraws().size();
+			const std::size_t calls = recorder.GetCallCount();
+			if (expectedCalls == 0)
+				expectedCalls = calls;
+			const bool passed = draws == frames && drawsMatch && calls == expectedCalls && calls % frames == 0;
+			std::cout << (ring.IsPersistent() ? "persistent mapping, " : "glBufferSubData, ") << characters << " characters x " << jointCount << " joints: "
+				<< draws << " instanced draws in " << frames << " frames, " << (double)calls / frames << " gl calls per frame, instances "
+				<< (drawsMatch ? "and scale match" : "or scale don't match") << (passed ? "" : " FAILED") << std::endl;
+			failed += passed ? 0 : 1;
+		}
+	}
+	return failed;
+}
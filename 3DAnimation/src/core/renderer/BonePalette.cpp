@@ -0,0 +1,57 @@
+#include "BonePalette.h"
+#include <GL/glew.h>
+
+namespace
+{
+	// glBindBufferRange needs offsets multiple of it
+	std::size_t StorageAlignment()
+	{
+		GLint alignment = 0;
+		glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+		return alignment > 0 ? (std::size_t)alignment : 256;
+	}
+
+	void BindStorage(unsigned int binding, const RingArray& array)
+	{
+		if (array.IsValid())
+			glBindBufferRange(GL_SHADER_STORAGE_BUFFER, binding, array.GetBuffer(), array.GetOffset(), array.GetSize());
+	}
+}
+
+BonePalette::BonePalette(FrameRingBuffer& ring)
+	: Matrices(ring, StorageAlignment())
+	, DualQuaternions(ring, StorageAlignment())
+{
+}
+
+void BonePalette::Clear(std::size_t matrixCount, std::size_t dualQuaternionCount)
+{
+	Matrices.Clear(matrixCount * sizeof(glm::mat4));
+	DualQuaternions.Clear(dualQuaternionCount * sizeof(SkinningDualQuaternion));
+}
+
+std::size_t BonePalette::Allocate(std::size_t count)
+{
+	const std::size_t offset = GetMatrixCount();
+	Matrices.Append(count * sizeof(glm::mat4));
+	return offset;
+}
+
+std::size_t BonePalette::AllocateDualQuaternions(std::size_t count)
+{
+	const std::size_t offset = GetDualQuaternionCount();
+	DualQuaternions.Append(count * sizeof(SkinningDualQuaternion));
+	return offset;
+}
+
+void BonePalette::Upload()
+{
+	Matrices.Flush();
+	DualQuaternions.Flush();
+}
+
+void BonePalette::Bind() const
+{
+	BindStorage(Binding, Matrices);
+	BindStorage(DualQuaternionBinding, DualQuaternions);
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include <cstddef>
+#include "glm/glm.hpp"
+#include "objects/Skinning.h"
+#include "core/renderer/FrameRingBuffer.h"
+
+// The skinning transforms of every skinned mesh drawn in a frame, in shader storage buffers
+// (the BonePalette and DualQuaternionPalette blocks of Shaders/skin_vert.sh). Every mesh
+// allocates its range and writes its transforms there (ComputeSkinningMatrices or
+// ComputeSkinningDualQuaternions), straight into the mapped ring buffer of the frame.
+class BonePalette
+{
+	RingArray Matrices;
+	RingArray DualQuaternions;
+public:
+	// binding points of the BonePalette and DualQuaternionPalette blocks
+	static constexpr unsigned int Binding = 0;
+	static constexpr unsigned int DualQuaternionBinding = 1;
+
+	explicit BonePalette(FrameRingBuffer& ring);
+	BonePalette(const BonePalette&) = delete;
+	BonePalette& operator=(const BonePalette&) = delete;
+
+	// starts a frame, after FrameRingBuffer::BeginFrame, with room for the transforms of the
+	// frame: the palettes don't move once written, more than that is drawn from the next frame
+	void Clear(std::size_t matrixCount = 0, std::size_t dualQuaternionCount = 0);
+	// room for count matrices, returns the index of the first one (the paletteOffset uniform).
+	// the memory is the mapped buffer: written once, never read back
+	std::size_t Allocate(std::size_t count);
+	// the same for dual quaternions, which have their own indices
+	std::size_t AllocateDualQuaternions(std::size_t count);
+	// valid until the next Allocate
+	glm::mat4* GetMatrices(std::size_t offset) { return static_cast<glm::mat4*>(Matrices.GetData(offset * sizeof(glm::mat4))); }
+	SkinningDualQuaternion* GetDualQuaternions(std::size_t offset) { return static_cast<SkinningDualQuaternion*>(DualQuaternions.GetData(offset * sizeof(SkinningDualQuaternion))); }
+	std::size_t GetMatrixCount() const { return Matrices.GetSize() / sizeof(glm::mat4); }
+	std::size_t GetDualQuaternionCount() const { return DualQuaternions.GetSize() / sizeof(SkinningDualQuaternion); }
+
+	// makes the transforms visible to gl, a copy only when the ring buffer isn't mapped
+	void Upload();
+	// the ranges of the ring buffer written this frame
+	void Bind() const;
+};
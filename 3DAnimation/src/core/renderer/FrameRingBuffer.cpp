@@ -0,0 +1,230 @@
+#include "FrameRingBuffer.h"
+#include <GL/glew.h>
+#include <algorithm>
+#include <iostream>
+
+namespace
+{
+	// regions stay aligned for any use of the buffer
+	constexpr std::size_t RegionAlignment = 256;
+
+	std::size_t AlignUp(std::size_t value, std::size_t alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+}
+
+FrameRingBuffer::FrameRingBuffer(std::size_t frameSize, std::size_t frameCount, bool allowPersistent)
+	: BufferObject{}
+	, FrameSize(AlignUp(std::max<std::size_t>(frameSize, 1), RegionAlignment))
+	, FrameCount(std::max<std::size_t>(frameCount, 1))
+	, Frame(FrameCount - 1)
+	, Head{}
+	, Demand{}
+	, Persistent(allowPersistent && glewIsSupported("GL_ARB_buffer_storage"))
+	, Mapped(nullptr)
+	, Stalls{}
+{
+	CreateStorage();
+}
+
+FrameRingBuffer::~FrameRingBuffer()
+{
+	DestroyStorage();
+}
+
+void FrameRingBuffer::CreateStorage()
+{
+	const std::size_t total = FrameSize * FrameCount;
+	glGenBuffers(1, &BufferObject);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, BufferObject);
+	if (Persistent)
+	{
+		const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glBufferStorage(GL_COPY_WRITE_BUFFER, total, nullptr, flags);
+		Mapped = static_cast<unsigned char*>(glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, total, flags));
+		if (!Mapped)
+		{
+			std::cerr << "[FrameRingBuffer]: could not map the buffer, uploading with glBufferSubData" << std::endl;
+			// the storage of the buffer can't change any more, a new one
+			Persistent = false;
+			glDeleteBuffers(1, &BufferObject);
+			glGenBuffers(1, &BufferObject);
+			glBindBuffer(GL_COPY_WRITE_BUFFER, BufferObject);
+		}
+	}
+	if (!Persistent)
+	{
+		glBufferData(GL_COPY_WRITE_BUFFER, total, nullptr, GL_STREAM_DRAW);
+		Staging.assign(total, 0);
+		Mapped = Staging.data();
+	}
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	Fences.assign(FrameCount, nullptr);
+}
+
+void FrameRingBuffer::DestroyStorage()
+{
+	for (std::size_t frame = 0; frame < Fences.size(); ++frame)
+		WaitFence(frame);
+	if (Persistent)
+	{
+		glBindBuffer(GL_COPY_WRITE_BUFFER, BufferObject);
+		glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	}
+	glDeleteBuffers(1, &BufferObject);
+	BufferObject = 0;
+	Mapped = nullptr;
+}
+
+void FrameRingBuffer::WaitFence(std::size_t frame)
+{
+	GLsync fence = static_cast<GLsync>(Fences[frame]);
+	if (!fence) return;
+
+	GLenum result = glClientWaitSync(fence, 0, 0);
+	if (result == GL_TIMEOUT_EXPIRED)
+	{
+		++Stalls;
+		// one second at a time, the commands are flushed so the fence is reached
+		while (result == GL_TIMEOUT_EXPIRED)
+			result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+	}
+	glDeleteSync(fence);
+	Fences[frame] = nullptr;
+}
+
+void FrameRingBuffer::BeginFrame()
+{
+	// the regions grow to what a frame asked for
+	if (Demand > FrameSize)
+	{
+		std::cerr << "[FrameRingBuffer]: a frame needs " << Demand << " bytes, the regions grow from " << FrameSize << std::endl;
+		DestroyStorage();
+		FrameSize = AlignUp(Demand + Demand / 2, RegionAlignment);
+		CreateStorage();
+	}
+
+	Frame = (Frame + 1) % FrameCount;
+	WaitFence(Frame);
+	Head = 0;
+	Demand = 0;
+
+	if (!Persistent)
+	{
+		// orphaning: the driver keeps the storage the frames in flight draw with
+		glBindBuffer(GL_COPY_WRITE_BUFFER, BufferObject);
+		glBufferData(GL_COPY_WRITE_BUFFER, FrameSize * FrameCount, nullptr, GL_STREAM_DRAW);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	}
+}
+
+void FrameRingBuffer::EndFrame()
+{
+	if (!Persistent) return;
+
+	if (Fences[Frame])
+		glDeleteSync(static_cast<GLsync>(Fences[Frame]));
+	Fences[Frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+RingAllocation FrameRingBuffer::Allocate(std::size_t size, std::size_t alignment)
+{
+	const std::size_t base = Frame * FrameSize;
+	alignment = std::max<std::size_t>(alignment, 1);
+	const std::size_t start = AlignUp(base + Head, alignment) - base;
+	// what the frame would take with every allocation given, the regions start aligned
+	Demand = AlignUp(Demand, alignment) + size;
+
+	RingAllocation allocation;
+	if (start + size > FrameSize) return allocation;
+
+	allocation.Data = Mapped + base + start;
+	allocation.Offset = base + start;
+	allocation.Size = size;
+	Head = start + size;
+	return allocation;
+}
+
+void FrameRingBuffer::Flush(const RingAllocation& allocation, std::size_t size)
+{
+	if (Persistent || !allocation.IsValid() || size == 0) return;
+
+	glBindBuffer(GL_COPY_WRITE_BUFFER, BufferObject);
+	glBufferSubData(GL_COPY_WRITE_BUFFER, allocation.Offset, std::min(size, allocation.Size), allocation.Data);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+RingArray::RingArray(FrameRingBuffer& ring, std::size_t alignment)
+	: Ring(&ring)
+	, Alignment(alignment)
+	, Data(nullptr)
+	, Capacity{}
+	, Used{}
+	, LastSize{}
+	, Overflowed(false)
+{
+}
+
+void RingArray::Clear(std::size_t reserve)
+{
+	LastSize = Used;
+	Memory = RingAllocation();
+	Data = nullptr;
+	Capacity = 0;
+	Used = 0;
+	Overflowed = false;
+	reserve = std::max(reserve, LastSize);
+	if (reserve > 0)
+	{
+		Memory = Ring->Allocate(reserve, Alignment);
+		Data = static_cast<unsigned char*>(Memory.Data);
+		Capacity = reserve;
+		Overflowed = !Memory.IsValid();
+	}
+	// the ring buffer is full: the frame goes to memory, the regions grow next frame
+	if (Overflowed)
+	{
+		Overflow.resize(Capacity);
+		Data = Overflow.data();
+	}
+}
+
+void* RingArray::Append(std::size_t size)
+{
+	// Capacity is what the ring buffer was asked for, given or not
+	if (Used + size > Capacity)
+	{
+		if (!Overflowed && Used == 0)
+		{
+			// nothing written yet, the array can still move to another allocation
+			Memory = Ring->Allocate(size, Alignment);
+			Data = static_cast<unsigned char*>(Memory.Data);
+			Overflowed = !Memory.IsValid();
+		}
+		else
+		{
+			// the mapping is write only: what was written stays there, the rest of the frame
+			// goes to memory and the array isn't drawn
+			Ring->AddDemand(Used + size - Capacity);
+			Overflowed = true;
+		}
+		Capacity = Used + size;
+		if (Overflowed)
+		{
+			Overflow.resize(Capacity);
+			Data = Overflow.data();
+		}
+	}
+
+	void* data = Data + Used;
+	Used += size;
+	return data;
+}
+
+void RingArray::Flush()
+{
+	if (!Overflowed)
+		Ring->Flush(Memory, Used);
+}
@@ -0,0 +1,112 @@
+#pragma once
+#include <vector>
+#include <cstddef>
+
+// Memory for the data rebuilt every frame (frame uniforms, skeleton lines, joint instances,
+// bone palettes) in one buffer split in a region per frame in flight. The buffer is mapped
+// once for good (glBufferStorage with GL_MAP_PERSISTENT_BIT) and the data is written straight
+// into it: no driver call per frame but a fence per region, waited for before the region is
+// written again.
+// Without GL_ARB_buffer_storage the data goes to a copy in memory and Flush uploads it with
+// glBufferSubData, the buffer orphaned every frame.
+
+// bytes of the buffer for a frame, valid until the end of the frame
+struct RingAllocation
+{
+	void* Data = nullptr;
+	// from the start of the buffer, for glBindBufferRange and glBindVertexBuffer
+	std::size_t Offset = 0;
+	std::size_t Size = 0;
+
+	bool IsValid() const { return Data != nullptr; }
+};
+
+class FrameRingBuffer
+{
+	unsigned int BufferObject;
+	std::size_t FrameSize;
+	std::size_t FrameCount;
+	// region of this frame and bytes of it already given
+	std::size_t Frame;
+	std::size_t Head;
+	// bytes asked for this frame, the regions grow to it at the next BeginFrame
+	std::size_t Demand;
+	bool Persistent;
+	unsigned char* Mapped;
+	// the copy of the buffer when it can't be mapped
+	std::vector<unsigned char> Staging;
+	// GLsync of the last frame that used every region
+	std::vector<void*> Fences;
+	std::size_t Stalls;
+
+	void CreateStorage();
+	void DestroyStorage();
+	void WaitFence(std::size_t frame);
+public:
+	static constexpr std::size_t DefaultFrameCount = 3;
+
+	// frameSize bytes for every frame in flight. allowPersistent false forces the orphaning path
+	FrameRingBuffer(std::size_t frameSize, std::size_t frameCount = DefaultFrameCount, bool allowPersistent = true);
+	~FrameRingBuffer();
+	FrameRingBuffer(const FrameRingBuffer&) = delete;
+	FrameRingBuffer& operator=(const FrameRingBuffer&) = delete;
+
+	// moves to the next region, waiting for the gpu to be done with it
+	void BeginFrame();
+	// fences the region after the draws of the frame
+	void EndFrame();
+
+	// size bytes at an offset multiple of alignment, invalid when the region is full (it grows
+	// at the next frame)
+	RingAllocation Allocate(std::size_t size, std::size_t alignment = 16);
+	// bytes the frame needed and didn't allocate, the regions grow to hold them next frame
+	void AddDemand(std::size_t size) { Demand += size; }
+	// makes the writes to an allocation visible to gl before it is drawn with: nothing to do
+	// with the persistent mapping, glBufferSubData without it
+	void Flush(const RingAllocation& allocation, std::size_t size);
+	void Flush(const RingAllocation& allocation) { Flush(allocation, allocation.Size); }
+
+	unsigned int GetBuffer() const { return BufferObject; }
+	bool IsPersistent() const { return Persistent; }
+	std::size_t GetFrameSize() const { return FrameSize; }
+	// BeginFrame calls that had to wait for the gpu
+	std::size_t GetStallCount() const { return Stalls; }
+};
+
+// An array rebuilt every frame straight in the ring buffer. The mapping is write only, so the
+// array never moves once something is written: it takes the room given to Clear (at least the
+// size of the last frame) and, if it needs more or the ring buffer is full, the rest of the
+// frame goes to memory and the array isn't drawn. The next frame reserves the whole size.
+// Pointers are valid until the next Append, offsets stay valid.
+class RingArray
+{
+	FrameRingBuffer* Ring;
+	std::size_t Alignment;
+	RingAllocation Memory;
+	unsigned char* Data;
+	std::size_t Capacity;
+	std::size_t Used;
+	// size of the last frame, the least Clear reserves
+	std::size_t LastSize;
+	bool Overflowed;
+	std::vector<unsigned char> Overflow;
+public:
+	RingArray(FrameRingBuffer& ring, std::size_t alignment);
+
+	// starts a frame, after FrameRingBuffer::BeginFrame. reserve is the size the frame is
+	// expected to take, more than that is only drawn from the next frame on
+	void Clear(std::size_t reserve = 0);
+	// size bytes at the end of the array
+	void* Append(std::size_t size);
+	// what Append gave, offset bytes from the start of the array
+	void* GetData(std::size_t offset) { return Data + offset; }
+
+	// uploads what was written when the ring buffer isn't mapped, before drawing with it
+	void Flush();
+	// false when the array didn't fit in its allocation, there is nothing to draw with
+	bool IsValid() const { return !Overflowed && Used > 0; }
+	std::size_t GetSize() const { return Used; }
+	// from the start of the ring buffer
+	std::size_t GetOffset() const { return Memory.Offset; }
+	unsigned int GetBuffer() const { return Ring->GetBuffer(); }
+};
@@ -0,0 +1,32 @@
+#include "FrameUniforms.h"
+#include <GL/glew.h>
+#include <cstring>
+#include <iostream>
+#include "core/renderer/FrameRingBuffer.h"
+
+static_assert(sizeof(FrameUniformData) == 176, "FrameUniformData must match the std140 layout of the Frame block");
+static_assert(offsetof(FrameUniformData, CameraPosition) == 128 && offsetof(FrameUniformData, LightPosition) == 144
+	&& offsetof(FrameUniformData, LightAttenuation) == 156 && offsetof(FrameUniformData, LightColor) == 160,
+	"FrameUniformData must match the std140 layout of the Frame block");
+
+FrameUniforms::FrameUniforms(FrameRingBuffer& ring)
+	: Ring(&ring)
+	, Alignment{}
+{
+	GLint alignment = 0;
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+	Alignment = alignment > 0 ? (std::size_t)alignment : 256;
+}
+
+void FrameUniforms::Upload(const FrameUniformData& data)
+{
+	const RingAllocation allocation = Ring->Allocate(sizeof(FrameUniformData), Alignment);
+	if (!allocation.IsValid())
+	{
+		std::cerr << "[FrameUniforms]: no room in the frame ring buffer" << std::endl;
+		return;
+	}
+	std::memcpy(allocation.Data, &data, sizeof(FrameUniformData));
+	Ring->Flush(allocation);
+	glBindBufferRange(GL_UNIFORM_BUFFER, Binding, Ring->GetBuffer(), allocation.Offset, sizeof(FrameUniformData));
+}
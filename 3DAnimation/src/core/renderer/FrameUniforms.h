@@ -0,0 +1,36 @@
+#pragma once
+#include <cstddef>
+#include "glm/glm.hpp"
+
+class FrameRingBuffer;
+
+// The Frame uniform block of the shaders, std140: vec3 members take 16 bytes unless a float
+// follows them.
+struct FrameUniformData
+{
+	glm::mat4 Projection;
+	glm::mat4 View;
+	glm::vec3 CameraPosition;
+	float Padding0;
+	glm::vec3 LightPosition;
+	float LightAttenuation;
+	glm::vec3 LightColor;
+	float Padding1;
+};
+
+// The camera and light of a frame, shared by every program through one uniform block instead
+// of the same uniforms set on each of them. Written once per frame in the ring buffer and bound
+// to Binding, where every shader under Shaders/ declares the block.
+class FrameUniforms
+{
+	FrameRingBuffer* Ring;
+	std::size_t Alignment;
+public:
+	// binding point of the Frame block
+	static constexpr unsigned int Binding = 0;
+
+	explicit FrameUniforms(FrameRingBuffer& ring);
+
+	// first thing of the frame, after FrameRingBuffer::BeginFrame, the region always has room for it
+	void Upload(const FrameUniformData& data);
+};
@@ -0,0 +1,349 @@
+#include "GLCallRecorder.h"
+#include <GL/glew.h>
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <iostream>
+
+// the glew entry points the recorder takes over: type, glew pointer, function of Recording
+#define RECORDED_ENTRY_POINTS(ENTRY) \
+	ENTRY(PFNGLGENBUFFERSPROC, __glewGenBuffers, GenBuffers) \
+	ENTRY(PFNGLDELETEBUFFERSPROC, __glewDeleteBuffers, DeleteBuffers) \
+	ENTRY(PFNGLBINDBUFFERPROC, __glewBindBuffer, BindBuffer) \
+	ENTRY(PFNGLBUFFERDATAPROC, __glewBufferData, BufferData) \
+	ENTRY(PFNGLBUFFERSUBDATAPROC, __glewBufferSubData, BufferSubData) \
+	ENTRY(PFNGLBUFFERSTORAGEPROC, __glewBufferStorage, BufferStorage) \
+	ENTRY(PFNGLMAPBUFFERRANGEPROC, __glewMapBufferRange, MapBufferRange) \
+	ENTRY(PFNGLUNMAPBUFFERPROC, __glewUnmapBuffer, UnmapBuffer) \
+	ENTRY(PFNGLBINDBUFFERRANGEPROC, __glewBindBufferRange, BindBufferRange) \
+	ENTRY(PFNGLGENVERTEXARRAYSPROC, __glewGenVertexArrays, GenVertexArrays) \
+	ENTRY(PFNGLDELETEVERTEXARRAYSPROC, __glewDeleteVertexArrays, DeleteVertexArrays) \
+	ENTRY(PFNGLBINDVERTEXARRAYPROC, __glewBindVertexArray, BindVertexArray) \
+	ENTRY(PFNGLVERTEXATTRIBPOINTERPROC, __glewVertexAttribPointer, VertexAttribPointer) \
+	ENTRY(PFNGLVERTEXATTRIBIPOINTERPROC, __glewVertexAttribIPointer, VertexAttribIPointer) \
+	ENTRY(PFNGLENABLEVERTEXATTRIBARRAYPROC, __glewEnableVertexAttribArray, EnableVertexAttribArray) \
+	ENTRY(PFNGLVERTEXATTRIBFORMATPROC, __glewVertexAttribFormat, VertexAttribFormat) \
+	ENTRY(PFNGLVERTEXATTRIBBINDINGPROC, __glewVertexAttribBinding, VertexAttribBinding) \
+	ENTRY(PFNGLVERTEXBINDINGDIVISORPROC, __glewVertexBindingDivisor, VertexBindingDivisor) \
+	ENTRY(PFNGLBINDVERTEXBUFFERPROC, __glewBindVertexBuffer, BindVertexBuffer) \
+	ENTRY(PFNGLDRAWARRAYSINSTANCEDPROC, __glewDrawArraysInstanced, DrawArraysInstanced) \
+	ENTRY(PFNGLDRAWELEMENTSINSTANCEDPROC, __glewDrawElementsInstanced, DrawElementsInstanced) \
+	ENTRY(PFNGLUSEPROGRAMPROC, __glewUseProgram, UseProgram) \
+	ENTRY(PFNGLDELETEPROGRAMPROC, __glewDeleteProgram, DeleteProgram) \
+	ENTRY(PFNGLGETUNIFORMLOCATIONPROC, __glewGetUniformLocation, GetUniformLocation) \
+	ENTRY(PFNGLUNIFORM1IPROC, __glewUniform1i, Uniform1i) \
+	ENTRY(PFNGLUNIFORMMATRIX4FVPROC, __glewUniformMatrix4fv, UniformMatrix4fv) \
+	ENTRY(PFNGLACTIVETEXTUREPROC, __glewActiveTexture, ActiveTexture) \
+	ENTRY(PFNGLFENCESYNCPROC, __glewFenceSync, FenceSync) \
+	ENTRY(PFNGLCLIENTWAITSYNCPROC, __glewClientWaitSync, ClientWaitSync) \
+	ENTRY(PFNGLDELETESYNCPROC, __glewDeleteSync, DeleteSync)
+
+namespace
+{
+	GLCallRecorder* Active = nullptr;
+
+	// what glew pointed to before the recorder
+	struct SavedEntryPoints
+	{
+#define DECLARE_SAVED(type, pointer, function) type function;
+		RECORDED_ENTRY_POINTS(DECLARE_SAVED)
+#undef DECLARE_SAVED
+		GLboolean BufferStorageSupported;
+	} Saved;
+}
+
+// the gl functions, on the active recorder. The fences are signaled right away
+struct GLCallRecorder::Recording
+{
+	static GLCallRecorder& Get()
+	{
+		++Active->Calls;
+		return *Active;
+	}
+
+	static std::vector<unsigned char>& Bound(GLenum target)
+	{
+		GLCallRecorder& recorder = *Active;
+		return recorder.Buffers[recorder.BoundBuffers[target]];
+	}
+
+	static void GLAPIENTRY GenBuffers(GLsizei count, GLuint* buffers)
+	{
+		GLCallRecorder& recorder = Get();
+		for (GLsizei i = 0; i < count; ++i)
+		{
+			buffers[i] = recorder.NextName++;
+			recorder.Buffers[buffers[i]];
+		}
+	}
+
+	static void GLAPIENTRY DeleteBuffers(GLsizei count, const GLuint* buffers)
+	{
+		GLCallRecorder& recorder = Get();
+		for (GLsizei i = 0; i < count; ++i)
+			recorder.Buffers.erase(buffers[i]);
+	}
+
+	static void GLAPIENTRY BindBuffer(GLenum target, GLuint buffer)
+	{
+		Get().BoundBuffers[target] = buffer;
+	}
+
+	static void GLAPIENTRY BufferData(GLenum target, GLsizeiptr size, const void* data, GLenum)
+	{
+		Get();
+		// new storage, like the driver does when a buffer is orphaned
+		std::vector<unsigned char>& buffer = Bound(target);
+		buffer.assign((std::size_t)size, 0);
+		if (data)
+			std::memcpy(buffer.data(), data, (std::size_t)size);
+	}
+
+	static void GLAPIENTRY BufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const void* data)
+	{
+		Get();
+		std::vector<unsigned char>& buffer = Bound(target);
+		if ((std::size_t)(offset + size) > buffer.size())
+		{
+			std::cerr << "[GLCallRecorder]: glBufferSubData out of the buffer" << std::endl;
+			return;
+		}
+		std::memcpy(buffer.data() + offset, data, (std::size_t)size);
+	}
+
+	static void GLAPIENTRY BufferStorage(GLenum target, GLsizeiptr size, const void* data, GLbitfield)
+	{
+		BufferData(target, size, data, 0);
+	}
+
+	static void* GLAPIENTRY MapBufferRange(GLenum target, GLintptr offset, GLsizeiptr, GLbitfield)
+	{
+		Get();
+		return Bound(target).data() + offset;
+	}
+
+	static GLboolean GLAPIENTRY UnmapBuffer(GLenum)
+	{
+		Get();
+		return GL_TRUE;
+	}
+
+	static void GLAPIENTRY BindBufferRange(GLenum target, GLuint binding, GLuint buffer, GLintptr offset, GLsizeiptr size)
+	{
+		Get().BufferRanges[std::make_pair(target, binding)] = BufferRange{ buffer, (std::size_t)offset, (std::size_t)size };
+	}
+
+	static void GLAPIENTRY GenVertexArrays(GLsizei count, GLuint* arrays)
+	{
+		GLCallRecorder& recorder = Get();
+		for (GLsizei i = 0; i < count; ++i)
+		{
+			arrays[i] = recorder.NextName++;
+			recorder.VertexArrays[arrays[i]];
+		}
+	}
+
+	static void GLAPIENTRY DeleteVertexArrays(GLsizei count, const GLuint* arrays)
+	{
+		GLCallRecorder& recorder = Get();
+		for (GLsizei i = 0; i < count; ++i)
+			recorder.VertexArrays.erase(arrays[i]);
+	}
+
+	static void GLAPIENTRY BindVertexArray(GLuint array)
+	{
+		Get().BoundVertexArray = array;
+	}
+
+	static VertexAttribute* BoundAttribute(GLuint index, const char* function)
+	{
+		GLCallRecorder& recorder = Get();
+		auto array = recorder.VertexArrays.find(recorder.BoundVertexArray);
+		if (array == recorder.VertexArrays.end() || index >= MaxVertexAttributes)
+		{
+			std::cerr << "[GLCallRecorder]: " << function << " without a vertex array" << std::endl;
+			return nullptr;
+		}
+		return &array->second.Attributes[index];
+	}
+
+	static void SetAttribute(GLuint index, GLint size, GLenum type, bool integer, GLboolean normalized, GLsizei stride, const void* pointer, const char* function)
+	{
+		VertexAttribute* attribute = BoundAttribute(index, function);
+		if (!attribute) return;
+		attribute->Integer = integer;
+		attribute->Normalized = normalized == GL_TRUE;
+		attribute->Size = size;
+		attribute->Type = type;
+		attribute->Buffer = Active->BoundBuffers[GL_ARRAY_BUFFER];
+		attribute->Offset = (std::size_t)pointer;
+		attribute->Stride = (std::size_t)stride;
+	}
+
+	static void GLAPIENTRY VertexAttribPointer(GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const void* pointer)
+	{
+		SetAttribute(index, size, type, false, normalized, stride, pointer, "glVertexAttribPointer");
+	}
+
+	static void GLAPIENTRY VertexAttribIPointer(GLuint index, GLint size, GLenum type, GLsizei stride, const void* pointer)
+	{
+		SetAttribute(index, size, type, true, GL_FALSE, stride, pointer, "glVertexAttribIPointer");
+	}
+
+	static void GLAPIENTRY EnableVertexAttribArray(GLuint index)
+	{
+		if (VertexAttribute* attribute = BoundAttribute(index, "glEnableVertexAttribArray"))
+			attribute->Enabled = true;
+	}
+
+	static void GLAPIENTRY VertexAttribFormat(GLuint, GLint, GLenum, GLboolean, GLuint) { Get(); }
+	static void GLAPIENTRY VertexAttribBinding(GLuint, GLuint) { Get(); }
+	static void GLAPIENTRY VertexBindingDivisor(GLuint, GLuint) { Get(); }
+
+	static void GLAPIENTRY BindVertexBuffer(GLuint binding, GLuint buffer, GLintptr offset, GLsizei stride)
+	{
+		GLCallRecorder& recorder = Get();
+		auto array = recorder.VertexArrays.find(recorder.BoundVertexArray);
+		if (array == recorder.VertexArrays.end() || binding >= MaxVertexBufferBindings)
+		{
+			std::cerr << "[GLCallRecorder]: glBindVertexBuffer without a vertex array" << std::endl;
+			return;
+		}
+		VertexBufferBinding& bound = array->second.Bindings[binding];
+		bound.Buffer = buffer;
+		bound.Offset = (std::size_t)offset;
+		bound.Stride = (std::size_t)stride;
+	}
+
+	static void RecordDraw(GLenum mode, GLint first, GLsizei count, GLsizei instances)
+	{
+		GLCallRecorder& recorder = Get();
+		InstancedDraw draw{ mode, first, count, instances, recorder.BoundVertexArray, {} };
+		auto array = recorder.VertexArrays.find(recorder.BoundVertexArray);
+		if (array != recorder.VertexArrays.end())
+			std::copy(std::begin(array->second.Bindings), std::end(array->second.Bindings), draw.Bindings);
+		recorder.Draws.push_back(draw);
+	}
+
+	static void GLAPIENTRY DrawArraysInstanced(GLenum mode, GLint first, GLsizei count, GLsizei instances)
+	{
+		RecordDraw(mode, first, count, instances);
+	}
+
+	static void GLAPIENTRY DrawElementsInstanced(GLenum mode, GLsizei count, GLenum, const void*, GLsizei instances)
+	{
+		RecordDraw(mode, 0, count, instances);
+	}
+
+	static void GLAPIENTRY UseProgram(GLuint) { Get(); }
+	static void GLAPIENTRY DeleteProgram(GLuint) { Get(); }
+
+	static GLint GLAPIENTRY GetUniformLocation(GLuint, const GLchar* name)
+	{
+		GLCallRecorder& recorder = Get();
+		// a new location for every name, the same for every program
+		auto location = recorder.UniformLocations.insert(std::make_pair(std::string(name), (int)recorder.UniformLocations.size()));
+		return location.first->second;
+	}
+
+	static void GLAPIENTRY Uniform1i(GLint location, GLint value)
+	{
+		GLCallRecorder& recorder = Get();
+		// -1 is a uniform the program doesn't use, ignored like gl does
+		if (location >= 0)
+			recorder.UniformValues[location] = value;
+	}
+
+	static void GLAPIENTRY UniformMatrix4fv(GLint location, GLsizei count, GLboolean, const GLfloat* values)
+	{
+		GLCallRecorder& recorder = Get();
+		if (location >= 0)
+			recorder.UniformFloats[location].assign(values, values + 16 * count);
+	}
+	static void GLAPIENTRY ActiveTexture(GLenum) { Get(); }
+
+	static GLsync GLAPIENTRY FenceSync(GLenum, GLbitfield)
+	{
+		// any non null handle, it is never dereferenced
+		return reinterpret_cast<GLsync>((std::size_t)Get().NextName++);
+	}
+
+	static GLenum GLAPIENTRY ClientWaitSync(GLsync, GLbitfield, GLuint64)
+	{
+		Get();
+		return GL_ALREADY_SIGNALED;
+	}
+
+	static void GLAPIENTRY DeleteSync(GLsync) { Get(); }
+};
+
+GLCallRecorder::GLCallRecorder(bool bufferStorage)
+	: Calls{}
+	, BoundVertexArray{}
+	, NextName(1)
+	, BufferStorage(bufferStorage)
+{
+	if (Active)
+		std::cerr << "[GLCallRecorder]: a recorder is already active, it is replaced" << std::endl;
+	Active = this;
+
+#define INSTALL(type, pointer, function) Saved.function = pointer; pointer = &Recording::function;
+	RECORDED_ENTRY_POINTS(INSTALL)
+#undef INSTALL
+	Saved.BufferStorageSupported = __GLEW_ARB_buffer_storage;
+	__GLEW_ARB_buffer_storage = bufferStorage ? GL_TRUE : GL_FALSE;
+}
+
+GLCallRecorder::~GLCallRecorder()
+{
+#define RESTORE(type, pointer, function) pointer = Saved.function;
+	RECORDED_ENTRY_POINTS(RESTORE)
+#undef RESTORE
+	__GLEW_ARB_buffer_storage = Saved.BufferStorageSupported;
+	Active = nullptr;
+}
+
+void GLCallRecorder::ClearCalls()
+{
+	Calls = 0;
+	Draws.clear();
+}
+
+const unsigned char* GLCallRecorder::GetBufferData(unsigned int buffer, std::size_t offset, std::size_t size) const
+{
+	auto it = Buffers.find(buffer);
+	if (it == Buffers.end() || offset + size > it->second.size()) return nullptr;
+	return it->second.data() + offset;
+}
+
+const GLCallRecorder::VertexAttribute* GLCallRecorder::GetVertexAttributes(unsigned int vertexArray) const
+{
+	auto it = VertexArrays.find(vertexArray);
+	return it == VertexArrays.end() ? nullptr : it->second.Attributes;
+}
+
+GLCallRecorder::BufferRange GLCallRecorder::GetBufferRange(unsigned int target, unsigned int binding) const
+{
+	auto it = BufferRanges.find(std::make_pair(target, binding));
+	return it == BufferRanges.end() ? BufferRange() : it->second;
+}
+
+bool GLCallRecorder::GetUniform(const char* name, int& value) const
+{
+	auto location = UniformLocations.find(name);
+	if (location == UniformLocations.end()) return false;
+	auto it = UniformValues.find(location->second);
+	if (it == UniformValues.end()) return false;
+	value = it->second;
+	return true;
+}
+
+bool GLCallRecorder::GetUniform(const char* name, float* values, std::size_t count) const
+{
+	auto location = UniformLocations.find(name);
+	if (location == UniformLocations.end()) return false;
+	auto it = UniformFloats.find(location->second);
+	if (it == UniformFloats.end() || it->second.size() < count) return false;
+	std::copy(it->second.begin(), it->second.begin() + count, values);
+	return true;
+}
@@ -0,0 +1,108 @@
+#pragma once
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+#include <cstddef>
+
+// Stand-in for the gl functions loaded by glew, for the checks of main.cpp that run without a
+// window. While it lives the glew function pointers of the buffers, vertex arrays, programs,
+// uniforms, syncs and instanced draws point to it: every call is counted, the buffers are kept
+// in memory (glMapBufferRange gives that memory), the instanced draws are recorded with the
+// vertex buffers bound to them, and the attribute pointers, indexed buffer ranges and uniforms
+// set last can be read back. The gl 1.1 functions (glEnable, glDrawArrays...) aren't loaded by
+// glew, they still go to the system library where they do nothing without a context.
+// Only one recorder at a time.
+class GLCallRecorder
+{
+public:
+	struct VertexBufferBinding
+	{
+		unsigned int Buffer = 0;
+		std::size_t Offset = 0;
+		std::size_t Stride = 0;
+	};
+
+	static constexpr unsigned int MaxVertexBufferBindings = 16;
+
+	// glVertexAttribPointer (Integer false) or glVertexAttribIPointer of a vertex array, reading
+	// the GL_ARRAY_BUFFER bound at the call. Stride as given, 0 is not replaced by the size
+	struct VertexAttribute
+	{
+		bool Enabled = false;
+		bool Integer = false;
+		bool Normalized = false;
+		int Size = 0;
+		unsigned int Type = 0;
+		unsigned int Buffer = 0;
+		std::size_t Offset = 0;
+		std::size_t Stride = 0;
+	};
+
+	static constexpr unsigned int MaxVertexAttributes = 16;
+
+	// glBindBufferRange of a binding point, buffer 0 if it was never bound
+	struct BufferRange
+	{
+		unsigned int Buffer = 0;
+		std::size_t Offset = 0;
+		std::size_t Size = 0;
+	};
+
+	struct InstancedDraw
+	{
+		unsigned int Mode;
+		int First;
+		int Count;
+		int Instances;
+		unsigned int VertexArray;
+		// the vertex buffers of the vertex array when it was drawn
+		VertexBufferBinding Bindings[MaxVertexBufferBindings];
+	};
+
+	// bufferStorage reports GL_ARB_buffer_storage to glewIsSupported, for the persistent mapping
+	explicit GLCallRecorder(bool bufferStorage = true);
+	~GLCallRecorder();
+	GLCallRecorder(const GLCallRecorder&) = delete;
+	GLCallRecorder& operator=(const GLCallRecorder&) = delete;
+
+	// forgets the calls and draws so far, the buffers and vertex arrays stay
+	void ClearCalls();
+	std::size_t GetCallCount() const { return Calls; }
+	const std::vector<InstancedDraw>& GetInstancedDraws() const { return Draws; }
+	// the memory of a buffer, nullptr if offset + size is outside of it
+	const unsigned char* GetBufferData(unsigned int buffer, std::size_t offset, std::size_t size) const;
+	// MaxVertexAttributes attributes of a vertex array, nullptr if it doesn't exist
+	const VertexAttribute* GetVertexAttributes(unsigned int vertexArray) const;
+	// the range bound last to binding of target (GL_SHADER_STORAGE_BUFFER, GL_UNIFORM_BUFFER...)
+	BufferRange GetBufferRange(unsigned int target, unsigned int binding) const;
+	// the value set last by glUniform1i to the location of name, in any program. False if it was
+	// never looked up or set
+	bool GetUniform(const char* name, int& value) const;
+	// the first count floats set last by glUniformMatrix4fv, the same way
+	bool GetUniform(const char* name, float* values, std::size_t count) const;
+
+private:
+	struct Recording;
+	friend struct Recording;
+
+	std::size_t Calls;
+	std::vector<InstancedDraw> Draws;
+	std::map<unsigned int, std::vector<unsigned char>> Buffers;
+	std::map<unsigned int, unsigned int> BoundBuffers;
+	struct VertexArrayState
+	{
+		VertexBufferBinding Bindings[MaxVertexBufferBindings];
+		VertexAttribute Attributes[MaxVertexAttributes];
+	};
+
+	std::map<unsigned int, VertexArrayState> VertexArrays;
+	std::map<std::pair<unsigned int, unsigned int>, BufferRange> BufferRanges;
+	// the locations handed out by glGetUniformLocation, one per name, and their int values
+	std::map<std::string, int> UniformLocations;
+	std::map<int, int> UniformValues;
+	std::map<int, std::vector<float>> UniformFloats;
+	unsigned int BoundVertexArray;
+	unsigned int NextName;
+	bool BufferStorage;
+};
@@ -0,0 +1,145 @@
+#include "JointRenderer.h"
+#include <GL/glew.h>
+#include <glm/gtc/matrix_transform.hpp>
+#include "core/renderer/ShaderProgram.h"
+#include "core/renderer/RenderQueue.h"
+
+namespace
+{
+	// position, texture coordinates, normal
+	const float CubeVertices[] = {
+		//back
+		-0.5f, -0.5f, -0.5f,  0.0f, 0.0f, 0.0f,0.0f,-1.0f,
+		 0.5f, -0.5f, -0.5f,  1.0f, 0.0f, 0.0f,0.0f,-1.0f,
+		 0.5f,  0.5f, -0.5f,  1.0f, 1.0f, 0.0f,0.0f,-1.0f,
+		 0.5f,  0.5f, -0.5f,  1.0f, 1.0f, 0.0f,0.0f,-1.0f,
+		-0.5f,  0.5f, -0.5f,  0.0f, 1.0f, 0.0f,0.0f,-1.0f,
+		-0.5f, -0.5f, -0.5f,  0.0f, 0.0f, 0.0f,0.0f,-1.0f,
+		//front
+		-0.5f, -0.5f,  0.5f,  0.0f, 0.0f,  0.0f,0.0f,1.0f,
+		0.5f, -0.5f,  0.5f,  1.0f, 0.0f,  0.0f,0.0f,1.0f,
+		0.5f,  0.5f,  0.5f,  1.0f, 1.0f,  0.0f,0.0f,1.0f,
+		0.5f,  0.5f,  0.5f,  1.0f, 1.0f,  0.0f,0.0f,1.0f,
+		-0.5f,  0.5f,  0.5f,  0.0f, 1.0f, 0.0f,0.0f,1.0f,
+		-0.5f, -0.5f,  0.5f,  0.0f, 0.0f, 0.0f,0.0f,1.0f,
+		//left
+		-0.5f,  0.5f,  0.5f,  1.0f, 0.0f, -1.0f,0.0f,0.0f,
+		-0.5f,  0.5f, -0.5f,  1.0f, 1.0f,  -1.0f,0.0f,0.0f,
+		-0.5f, -0.5f, -0.5f,  0.0f, 1.0f,   -1.0f,0.0f,0.0f,
+		-0.5f, -0.5f, -0.5f,  0.0f, 1.0f,   -1.0f,0.0f,0.0f,
+		-0.5f, -0.5f,  0.5f,  0.0f, 0.0f,   -1.0f,0.0f,0.0f,
+		-0.5f,  0.5f,  0.5f,  1.0f, 0.0f,   -1.0f,0.0f,0.0f,
+		//right
+		 0.5f,  0.5f,  0.5f,  1.0f, 0.0f, 1.0f,0.0f,0.0f,
+		 0.5f,  0.5f, -0.5f,  1.0f, 1.0f,  1.0f,0.0f,0.0f,
+		 0.5f, -0.5f, -0.5f,  0.0f, 1.0f,  1.0f,0.0f,0.0f,
+		 0.5f, -0.5f, -0.5f,  0.0f, 1.0f,  1.0f,0.0f,0.0f,
+		 0.5f, -0.5f,  0.5f,  0.0f, 0.0f,  1.0f,0.0f,0.0f,
+		 0.5f,  0.5f,  0.5f,  1.0f, 0.0f,  1.0f,0.0f,0.0f,
+		 //Bottom
+		-0.5f, -0.5f, -0.5f,  0.0f, 1.0f, 0.0f,-1.0f,0.0f,
+		 0.5f, -0.5f, -0.5f,  1.0f, 1.0f, 0.0f,-1.0f,0.0f,
+		 0.5f, -0.5f,  0.5f,  1.0f, 0.0f, 0.0f,-1.0f,0.0f,
+		 0.5f, -0.5f,  0.5f,  1.0f, 0.0f, 0.0f,-1.0f,0.0f,
+		-0.5f, -0.5f,  0.5f,  0.0f, 0.0f, 0.0f,-1.0f,0.0f,
+		-0.5f, -0.5f, -0.5f,  0.0f, 1.0f, 0.0f,-1.0f,0.0f,
+		// Up
+		-0.5f,  0.5f, -0.5f,  0.0f, 1.0f, 0.0f,1.0f,0.0f,
+		 0.5f,  0.5f, -0.5f,  1.0f, 1.0f, 0.0f,1.0f,0.0f,
+		 0.5f,  0.5f,  0.5f,  1.0f, 0.0f, 0.0f,1.0f,0.0f,
+		 0.5f,  0.5f,  0.5f,  1.0f, 0.0f, 0.0f,1.0f,0.0f,
+		-0.5f,  0.5f,  0.5f,  0.0f, 0.0f, 0.0f,1.0f,0.0f,
+		-0.5f,  0.5f, -0.5f,  0.0f, 1.0f, 0.0f,1.0f,0.0f
+	};
+}
+
+JointRenderer::JointRenderer(GameObject* parent, ShaderProgram* shader, FrameRingBuffer& ring)
+	: Renderer(parent, shader)
+	, Instances(ring, sizeof(glm::vec4))
+	, JointTransform(1.0f)
+{
+	VertexArrayObject = 0;
+	VertexBufferObject = 0;
+	ElementBufferObject = 0;
+}
+
+JointRenderer::~JointRenderer()
+{
+	glDeleteBuffers(1, &VertexBufferObject);
+	glDeleteVertexArrays(1, &VertexArrayObject);
+}
+
+void JointRenderer::SetJointScale(const glm::vec3& scale)
+{
+	JointTransform = glm::scale(glm::mat4(1.0f), scale);
+}
+
+void JointRenderer::Render()
+{
+	Instances.Flush();
+	if (!Instances.IsValid()) return;
+
+	Shader->useProgram();
+	Shader->setMatrix(JointTransformUniform, JointTransform);
+	glBindVertexArray(VertexArrayObject);
+	glBindVertexBuffer(InstanceBinding, Instances.GetBuffer(), Instances.GetOffset(), sizeof(glm::mat4));
+	glDrawArraysInstanced(GL_TRIANGLES, 0, 36, (GLsizei)GetInstanceCount());
+	glBindVertexArray(0);
+	Shader->stopProgram();
+}
+
+void JointRenderer::PrepareDraw(void* context)
+{
+	const JointRenderer& renderer = *static_cast<const JointRenderer*>(context);
+	renderer.Shader->setMatrix(renderer.JointTransformUniform, renderer.JointTransform);
+	glBindVertexBuffer(InstanceBinding, renderer.Instances.GetBuffer(), renderer.Instances.GetOffset(), sizeof(glm::mat4));
+}
+
+void JointRenderer::Submit(RenderQueue& queue)
+{
+	Instances.Flush();
+	if (!Instances.IsValid()) return;
+
+	DrawPacket packet;
+	packet.Program = Shader;
+	packet.VertexArray = VertexArrayObject;
+	packet.Mode = GL_TRIANGLES;
+	packet.Count = 36;
+	packet.Instances = (int)GetInstanceCount();
+	packet.Prepare = &JointRenderer::PrepareDraw;
+	packet.Context = this;
+	queue.Submit(packet);
+}
+
+void JointRenderer::SetUp()
+{
+	JointTransformUniform = Shader->getUniform("jointTransform");
+
+	glGenVertexArrays(1, &VertexArrayObject);
+	glBindVertexArray(VertexArrayObject);
+
+	glGenBuffers(1, &VertexBufferObject);
+	glBindBuffer(GL_ARRAY_BUFFER, VertexBufferObject);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(CubeVertices), CubeVertices, GL_STATIC_DRAW);
+	// position attribute
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
+	glEnableVertexAttribArray(0);
+	// texture coord attribute
+	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
+	glEnableVertexAttribArray(1);
+	// normal attribute
+	glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(5 * sizeof(float)));
+	glEnableVertexAttribArray(2);
+
+	// a mat4 attribute takes 4 locations, one column each, and advances once per instance. The
+	// buffer and offset change every frame, Render binds them
+	for (unsigned int column = 0; column < 4; ++column)
+	{
+		glVertexAttribFormat(3 + column, 4, GL_FLOAT, GL_FALSE, column * sizeof(glm::vec4));
+		glVertexAttribBinding(3 + column, InstanceBinding);
+		glEnableVertexAttribArray(3 + column);
+	}
+	glVertexBindingDivisor(InstanceBinding, 1);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindVertexArray(0);
+}
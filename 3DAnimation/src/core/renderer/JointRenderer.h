@@ -0,0 +1,44 @@
+#pragma once
+#include <cstddef>
+#include <cstring>
+#include "Renderer.h"
+#include "ShaderProgram.h"
+#include "core/renderer/FrameRingBuffer.h"
+#include "glm/glm.hpp"
+
+// Draws a cube at every joint of any number of skeletons with one instanced draw call. The
+// transforms of the joints are added every frame straight into the ring buffer, read by the
+// animationTransform attribute of Shaders/skel_vert.sh, the cube scaled by the jointTransform
+// uniform.
+class JointRenderer final : public Renderer
+{
+	RingArray Instances;
+	// the scale of the cubes, set for every draw
+	glm::mat4 JointTransform;
+	// looked up in SetUp
+	UniformHandle JointTransformUniform;
+
+	// the scale and the instances of the frame, the context is the renderer
+	static void PrepareDraw(void* context);
+public:
+	// binding of the instance attributes, set to the range of the frame before drawing
+	static constexpr unsigned int InstanceBinding = 3;
+
+	JointRenderer(GameObject* parent, ShaderProgram* shader, FrameRingBuffer& ring);
+	virtual ~JointRenderer();
+	JointRenderer(const JointRenderer&) = delete;
+	JointRenderer& operator=(const JointRenderer&) = delete;
+
+	// starts a frame, after FrameRingBuffer::BeginFrame
+	void Clear(std::size_t reserve = 0) { Instances.Clear(reserve * sizeof(glm::mat4)); }
+	// the global transforms of the joints of a skeleton (Animator::GetGlobalTransforms)
+	void Add(const glm::mat4* transforms, std::size_t count) { std::memcpy(Instances.Append(count * sizeof(glm::mat4)), transforms, count * sizeof(glm::mat4)); }
+	std::size_t GetInstanceCount() const { return Instances.GetSize() / sizeof(glm::mat4); }
+	// size of the cube of every joint, 1 by default
+	void SetJointScale(const glm::vec3& scale);
+
+	// draws every joint added this frame
+	void Render() override;
+	void Submit(RenderQueue& queue) override;
+	void SetUp()  override;
+};
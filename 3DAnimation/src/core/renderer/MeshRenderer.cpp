@@ -3,6 +3,7 @@
 #include "core/model/Mesh.h"
 #include "core/scene/GameObject.h"
 #include "core/renderer/ShaderProgram.h"
+#include "core/renderer/RenderQueue.h"
 
 MeshRenderer::MeshRenderer(GameObject* parent, ShaderProgram * shader, Mesh * mesh)
 	: Renderer(parent,shader)
@@ -20,6 +21,17 @@ void MeshRenderer::Render()
 	Shader->stopProgram();
 }
 
+void MeshRenderer::Submit(RenderQueue& queue)
+{
+	DrawPacket packet;
+	packet.Program = Shader;
+	packet.VertexArray = VertexArrayObject;
+	packet.Texture = MeshData->m_textures.empty() ? 0 : MeshData->m_textures.front().m_textureID;
+	packet.Mode = GL_TRIANGLES;
+	packet.Indexed = true;
+	packet.Count = (int)MeshData->m_indices.size();
+	queue.Submit(packet);
+}
 
 void MeshRenderer::SetUp()
 {
@@ -9,6 +9,7 @@ public:
 	MeshRenderer(GameObject* parent, ShaderProgram* shader, Mesh* mesh);
 	virtual ~MeshRenderer(){}
 	void Render() override;
+	void Submit(RenderQueue& queue) override;
 	void SetUp()  override;
 	void Update() override;
 	void Input()  override;
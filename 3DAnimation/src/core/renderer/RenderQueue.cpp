@@ -0,0 +1,120 @@
+#include "RenderQueue.h"
+#include <GL/glew.h>
+#include <algorithm>
+#include "core/renderer/ShaderProgram.h"
+
+namespace
+{
+	// the last state set, nothing is known at the start of Execute
+	struct StateCache
+	{
+		const ShaderProgram* Program = nullptr;
+		unsigned int VertexArray = 0;
+		unsigned int Texture = 0;
+		int DepthTest = -1;
+		float LineWidth = 0.0f;
+	};
+}
+
+// layer 8 bits | depth test 1 | program 15 | texture 20 | vertex array 20. Meshes rarely share a
+// vertex array but often a texture, so the texture comes first. The ids are gl names, small
+// numbers, a collision only groups draws less well
+std::uint64_t RenderQueue::MakeSortKey(RenderLayer layer, const DrawPacket& packet)
+{
+	const std::uint64_t program = packet.Program ? (std::uint64_t)packet.Program->getProgramID() : 0;
+	return ((std::uint64_t)layer << 56)
+		| ((std::uint64_t)(packet.State.DepthTest ? 1 : 0) << 55)
+		| ((program & 0x7FFF) << 40)
+		| (((std::uint64_t)packet.Texture & 0xFFFFF) << 20)
+		| ((std::uint64_t)packet.VertexArray & 0xFFFFF);
+}
+
+void RenderQueue::Submit(const DrawPacket& packet, RenderLayer layer)
+{
+	Packets.push_back(packet);
+	Packets.back().Key = MakeSortKey(layer, packet);
+}
+
+void RenderQueue::Execute()
+{
+	Stats = RenderQueueStats();
+	// stable: the draws with the same state keep the order they were submitted in
+	std::stable_sort(Packets.begin(), Packets.end(), [](const DrawPacket& a, const DrawPacket& b) { return a.Key < b.Key; });
+
+	StateCache current;
+	for (const DrawPacket& packet : Packets)
+	{
+		if (packet.Program != current.Program)
+		{
+			packet.Program->useProgram();
+			current.Program = packet.Program;
+			++Stats.StateChanges;
+		}
+		else ++Stats.FilteredStateChanges;
+
+		if (packet.VertexArray != current.VertexArray)
+		{
+			glBindVertexArray(packet.VertexArray);
+			current.VertexArray = packet.VertexArray;
+			++Stats.StateChanges;
+		}
+		else ++Stats.FilteredStateChanges;
+
+		if (packet.Texture != 0)
+		{
+			if (packet.Texture != current.Texture)
+			{
+				glActiveTexture(GL_TEXTURE0);
+				glBindTexture(GL_TEXTURE_2D, packet.Texture);
+				current.Texture = packet.Texture;
+				++Stats.StateChanges;
+			}
+			else ++Stats.FilteredStateChanges;
+		}
+
+		const int depthTest = packet.State.DepthTest ? 1 : 0;
+		if (depthTest != current.DepthTest)
+		{
+			if (depthTest) glEnable(GL_DEPTH_TEST);
+			else glDisable(GL_DEPTH_TEST);
+			current.DepthTest = depthTest;
+			++Stats.StateChanges;
+		}
+		else ++Stats.FilteredStateChanges;
+
+		if (packet.State.LineWidth > 0.0f)
+		{
+			if (packet.State.LineWidth != current.LineWidth)
+			{
+				glLineWidth(packet.State.LineWidth);
+				current.LineWidth = packet.State.LineWidth;
+				++Stats.StateChanges;
+			}
+			else ++Stats.FilteredStateChanges;
+		}
+
+		if (packet.Prepare)
+			packet.Prepare(packet.Context);
+
+		if (packet.Indexed)
+		{
+			const void* indices = (const void*)(packet.First * sizeof(unsigned int));
+			if (packet.Instances > 0)
+				glDrawElementsInstanced(packet.Mode, packet.Count, GL_UNSIGNED_INT, indices, packet.Instances);
+			else
+				glDrawElements(packet.Mode, packet.Count, GL_UNSIGNED_INT, indices);
+		}
+		else if (packet.Instances > 0)
+			glDrawArraysInstanced(packet.Mode, packet.First, packet.Count, packet.Instances);
+		else
+			glDrawArrays(packet.Mode, packet.First, packet.Count);
+		++Stats.Draws;
+	}
+
+	if (!Packets.empty())
+	{
+		glBindVertexArray(0);
+		glUseProgram(0);
+	}
+	Packets.clear();
+}
@@ -0,0 +1,76 @@
+#pragma once
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+class ShaderProgram;
+
+// the order of the passes, the highest bits of the sort key: everything in a layer is drawn
+// before the next one whatever its state
+enum class RenderLayer : unsigned char
+{
+	// drawn first without depth test, the rest draws over it (the grid)
+	Background,
+	Opaque,
+	Overlay
+};
+
+// fixed function state of a draw. 0 line width is a draw that doesn't care
+struct RenderState
+{
+	bool DepthTest = true;
+	float LineWidth = 0.0f;
+};
+
+// A draw and the state it needs. Prepare is called once the program and vertex array are bound,
+// for what belongs to the draw alone (uniforms, ranges of the frame ring buffer).
+struct DrawPacket
+{
+	std::uint64_t Key = 0;
+	const ShaderProgram* Program = nullptr;
+	unsigned int VertexArray = 0;
+	// bound to texture unit 0, 0 is a draw that doesn't sample any
+	unsigned int Texture = 0;
+	RenderState State;
+
+	// GL_TRIANGLES, GL_LINES ...
+	unsigned int Mode = 0;
+	// glDrawElements with unsigned int indices from First, glDrawArrays otherwise
+	bool Indexed = false;
+	int First = 0;
+	int Count = 0;
+	// more than 0 is an instanced draw
+	int Instances = 0;
+
+	void (*Prepare)(void* context) = nullptr;
+	void* Context = nullptr;
+};
+
+// gl calls of the last Execute
+struct RenderQueueStats
+{
+	std::size_t Draws = 0;
+	// program, vertex array, texture, depth test and line width changes issued
+	std::size_t StateChanges = 0;
+	// the ones skipped because the state was already set
+	std::size_t FilteredStateChanges = 0;
+};
+
+// Draws of a frame submitted in any order by the passes and renderers, sorted by layer, depth
+// state, program, texture and vertex array, then drawn setting only the state that changes
+// from one draw to the next.
+class RenderQueue
+{
+	std::vector<DrawPacket> Packets;
+	RenderQueueStats Stats;
+public:
+	static std::uint64_t MakeSortKey(RenderLayer layer, const DrawPacket& packet);
+
+	// the packet is copied, its Prepare context must live until Execute
+	void Submit(const DrawPacket& packet, RenderLayer layer = RenderLayer::Opaque);
+	// draws everything submitted and empties the queue, leaving no program nor vertex array bound
+	void Execute();
+
+	std::size_t GetPacketCount() const { return Packets.size(); }
+	const RenderQueueStats& GetStats() const { return Stats; }
+};
@@ -1,6 +1,7 @@
 #pragma once
 #include "core/scene/Component.h"
 class ShaderProgram;
+class RenderQueue;
 
 class Renderer: public Component
 {
@@ -13,4 +14,8 @@ public:
 	Renderer(GameObject* parent, ShaderProgram* shader):Component(parent),Shader(shader) {};
 	virtual ~Renderer() {}
 	virtual void Render() = 0;
+	// the draws of the renderer for this frame, drawn sorted by state when the queue executes
+	virtual void Submit(RenderQueue& queue) = 0;
+	// the vertex array of the draws, made by SetUp
+	unsigned int GetVertexArray() const { return VertexArrayObject; }
 };
\ No newline at end of file
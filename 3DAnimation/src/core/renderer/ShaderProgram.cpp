@@ -5,10 +5,25 @@
 #include <iostream>
 #include <fstream>
 #include <string>
+#include <algorithm>
 #include "glm/glm.hpp"
 
 namespace
 {
+	std::size_t UniformLocationQueries = 0;
+
+	// FNV-1a, the table is searched without building a std::string from the name
+	unsigned int HashUniformName(const char* name)
+	{
+		unsigned int hash = 2166136261u;
+		for (; *name; ++name)
+		{
+			hash ^= (unsigned char)*name;
+			hash *= 16777619u;
+		}
+		return hash;
+	}
+
 	void DebugProgramLinkError(unsigned int shaderProgramId)
 	{
 		int Result = GL_FALSE;
@@ -49,6 +64,7 @@ ShaderProgram::ShaderProgram(const char* vertexShaderSourcePath, const char* fra
 	vertexShaderID = loadShader(vertexShaderSourcePath, GL_VERTEX_SHADER);
 	fragmentShaderID = loadShader(fragmentShaderSourcePath, GL_FRAGMENT_SHADER);
 	programID = createShaderProgram();
+	reflectUniforms();
 }
 ShaderProgram::ShaderProgram(const char* vertexShaderSourcePath, const char* fragmentShaderSourcePath, const char* geometryShaderSource)
 	: vertexShaderID{}
@@ -60,6 +76,7 @@ ShaderProgram::ShaderProgram(const char* vertexShaderSourcePath, const char* fra
 	fragmentShaderID = loadShader(fragmentShaderSourcePath, GL_FRAGMENT_SHADER);
 	geometryShaderID = loadShader(geometryShaderSource, GL_GEOMETRY_SHADER);
 	programID = createShaderProgramWithGeometry();
+	reflectUniforms();
 }
 
 ShaderProgram::~ShaderProgram()
@@ -78,9 +95,69 @@ void ShaderProgram::stopProgram() const
 	glUseProgram(0);
 }
 
+void ShaderProgram::reflectUniforms()
+{
+	uniforms.clear();
+	GLint count = 0;
+	GLint maxLength = 0;
+	glGetProgramiv(programID, GL_ACTIVE_UNIFORMS, &count);
+	glGetProgramiv(programID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+
+	std::vector<char> name(maxLength + 1);
+	for (GLint i = 0; i < count; ++i)
+	{
+		GLsizei length = 0;
+		GLint size = 0;
+		GLenum type = 0;
+		glGetActiveUniform(programID, i, (GLsizei)name.size(), &length, &size, &type, name.data());
+		// the uniform indices are the ones of the program interface
+		const GLenum property = GL_LOCATION;
+		GLint location = -1;
+		glGetProgramResourceiv(programID, GL_UNIFORM, i, 1, &property, 1, nullptr, &location);
+		// members of uniform blocks have no location
+		if (location < 0) continue;
+
+		std::string uniformName(name.data(), length);
+		uniforms.push_back(UniformEntry{ HashUniformName(uniformName.c_str()), uniformName, location });
+		// arrays are listed as name[0], they are also set by name
+		const std::size_t bracket = uniformName.find('[');
+		if (bracket != std::string::npos)
+		{
+			uniformName.resize(bracket);
+			uniforms.push_back(UniformEntry{ HashUniformName(uniformName.c_str()), uniformName, location });
+		}
+	}
+	std::sort(uniforms.begin(), uniforms.end(), [](const UniformEntry& a, const UniformEntry& b) { return a.Hash < b.Hash; });
+}
+
 int ShaderProgram::getUniformLocation(const char * name) const
 {
-	return glGetUniformLocation(programID, name);
+	const unsigned int hash = HashUniformName(name);
+	auto entry = std::lower_bound(uniforms.begin(), uniforms.end(), hash, [](const UniformEntry& e, unsigned int h) { return e.Hash < h; });
+	for (; entry != uniforms.end() && entry->Hash == hash; ++entry)
+	{
+		if (entry->Name == name)
+			return entry->Location;
+	}
+
+	// not an active uniform by that name (an element of an array, a uniform the compiler
+	// removed), the driver is asked once and the answer kept
+	++UniformLocationQueries;
+	const int location = glGetUniformLocation(programID, name);
+	uniforms.insert(entry, UniformEntry{ hash, name, location });
+	return location;
+}
+
+UniformHandle ShaderProgram::getUniform(const char* name) const
+{
+	UniformHandle uniform;
+	uniform.Location = getUniformLocation(name);
+	return uniform;
+}
+
+std::size_t ShaderProgram::GetUniformLocationQueryCount()
+{
+	return UniformLocationQueries;
 }
 
 void ShaderProgram::setBool(const char* name, bool value) const
@@ -90,14 +167,13 @@ void ShaderProgram::setBool(const char* name, bool value) const
 
 void ShaderProgram::setInt(const char* name, int value) const
 {
-	const GLint& location = glGetUniformLocation(programID, name);
-
+	const GLint& location = getUniformLocation(name);
 	glUniform1i(location, value);
 }
 
 void ShaderProgram::setFloat(const char* name, float value) const
 {
-	const GLint& location = glGetUniformLocation(programID, name);
+	const GLint& location = getUniformLocation(name);
 	glUniform1f(location, value);
 }
 
@@ -119,6 +195,36 @@ void ShaderProgram::setMatrix(const char* name, const glm::mat4 & matrix) const
 	glUniformMatrix4fv(location, 1, false, &matrix[0][0]);
 }
 
+void ShaderProgram::setBool(UniformHandle uniform, bool value) const
+{
+	glUniform1i(uniform.Location, (int)value);
+}
+
+void ShaderProgram::setInt(UniformHandle uniform, int value) const
+{
+	glUniform1i(uniform.Location, value);
+}
+
+void ShaderProgram::setFloat(UniformHandle uniform, float value) const
+{
+	glUniform1f(uniform.Location, value);
+}
+
+void ShaderProgram::setVector3f(UniformHandle uniform, const glm::vec3& vector) const
+{
+	glUniform3f(uniform.Location, vector.x, vector.y, vector.z);
+}
+
+void ShaderProgram::setVector4f(UniformHandle uniform, const glm::vec4& vector) const
+{
+	glUniform4f(uniform.Location, vector.x, vector.y, vector.z, vector.w);
+}
+
+void ShaderProgram::setMatrix(UniformHandle uniform, const glm::mat4& matrix) const
+{
+	glUniformMatrix4fv(uniform.Location, 1, false, &matrix[0][0]);
+}
+
 
 unsigned int ShaderProgram::loadShader(const char* shaderSourcePath,unsigned int type)
 {
@@ -1,13 +1,37 @@
 #pragma once
 
+#include <string>
+#include <vector>
+#include <cstddef>
 #include "glm/glm.hpp"
 
+// location of a uniform of a program, looked up once (ShaderProgram::getUniform). -1 is a
+// uniform the program doesn't use, setting it does nothing like in gl
+struct UniformHandle
+{
+	int Location = -1;
+
+	bool IsValid() const { return Location >= 0; }
+};
+
 class ShaderProgram
 {
+	// an active uniform found at link time, or a name asked for later
+	struct UniformEntry
+	{
+		unsigned int Hash;
+		std::string Name;
+		int Location;
+	};
+
 	int vertexShaderID;
 	int fragmentShaderID;
 	int geometryShaderID;
 	int programID;
+	// sorted by hash, the names only asked for after link are added when they are first used
+	mutable std::vector<UniformEntry> uniforms;
+
+	void reflectUniforms();
 public:
 	ShaderProgram() = default;
 	ShaderProgram(const char* vertexShaderSourcePath, const char* fragmentShaderSourcePath);
@@ -18,9 +42,11 @@ public:
 	int createShaderProgramWithGeometry();
 	unsigned int loadShader(const char* ShaderSourcePath,unsigned int type);
 	void useProgram() const;
+	unsigned int getProgramID() const { return (unsigned int)programID; }
 	void stopProgram()const;
-	// utility uniform functions
+	// utility uniform functions, the locations come from the table built at link time
 	int getUniformLocation(const char* name)const;
+	UniformHandle getUniform(const char* name) const;
 	void setBool(const char* name, bool value) const;
 	void setInt(const char* name, int value) const;
 	void setFloat(const char* name, float value) const;
@@ -28,5 +54,17 @@ public:
 	void setVector4f(const char* name, const glm::vec4&  vector)const;
 
 	void setMatrix(const char* name, const glm::mat4& matrix) const;
+
+	// no lookup at all, the handle must come from this program
+	void setBool(UniformHandle uniform, bool value) const;
+	void setInt(UniformHandle uniform, int value) const;
+	void setFloat(UniformHandle uniform, float value) const;
+	void setVector3f(UniformHandle uniform, const glm::vec3& vector) const;
+	void setVector4f(UniformHandle uniform, const glm::vec4& vector) const;
+	void setMatrix(UniformHandle uniform, const glm::mat4& matrix) const;
+
+	// glGetUniformLocation calls of every program since the start, only the names that are not
+	// active uniforms (array elements past the first) reach the driver, once
+	static std::size_t GetUniformLocationQueryCount();
 };
 
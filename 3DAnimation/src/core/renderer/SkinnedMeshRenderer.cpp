@@ -0,0 +1,109 @@
+#include "SkinnedMeshRenderer.h"
+#include <GL/glew.h>
+#include <cstddef>
+#include "app/ColladaAsset.h"
+#include "objects/Skinning.h"
+#include "core/renderer/BonePalette.h"
+#include "core/renderer/ShaderProgram.h"
+#include "core/renderer/RenderQueue.h"
+
+std::vector<SkinnedVertex> PackSkinnedVertices(const SkinnedMeshData& mesh, const SkinningMesh& skinning)
+{
+	std::vector<SkinnedVertex> vertices(mesh.Vertices.size());
+	for (std::size_t i = 0; i < vertices.size(); ++i)
+	{
+		const Vertex& v = mesh.Vertices[i];
+		SkinnedVertex& out = vertices[i];
+		out.Position = v.position;
+		out.TextCoords = v.text_coords;
+		out.Normal = v.normals;
+		// the cleaned influences: out of the skin ones point at joint 0 with weight 0
+		for (int k = 0; k < 4; ++k)
+		{
+			out.Joints[k] = skinning.Joints[k][i];
+			out.Weights[k] = skinning.Weights[k][i];
+		}
+	}
+	return vertices;
+}
+
+SkinnedMeshRenderer::SkinnedMeshRenderer(GameObject* parent, ShaderProgram* shader, const SkinnedMeshData* mesh, const SkinningMesh* skinning, BonePalette* palette)
+	: Renderer(parent, shader)
+	, MeshData(mesh)
+	, Skinning(skinning)
+	, Palette(palette)
+	, PaletteOffset{}
+	, Mode(SkinningMode::LinearBlend)
+{
+	VertexArrayObject = 0;
+	VertexBufferObject = 0;
+	ElementBufferObject = 0;
+}
+
+SkinnedMeshRenderer::~SkinnedMeshRenderer()
+{
+	glDeleteBuffers(1, &VertexBufferObject);
+	glDeleteBuffers(1, &ElementBufferObject);
+	glDeleteVertexArrays(1, &VertexArrayObject);
+}
+
+void SkinnedMeshRenderer::Render()
+{
+	Shader->useProgram();
+	Shader->setInt(PaletteOffsetUniform, (int)PaletteOffset);
+	Shader->setBool(DualQuaternionUniform, Mode == SkinningMode::DualQuaternion);
+	Palette->Bind();
+	glBindVertexArray(VertexArrayObject);
+	glDrawElements(GL_TRIANGLES, (GLsizei)MeshData->Indices.size(), GL_UNSIGNED_INT, 0);
+	glBindVertexArray(0);
+	Shader->stopProgram();
+}
+
+void SkinnedMeshRenderer::PrepareDraw(void* context)
+{
+	const SkinnedMeshRenderer& renderer = *static_cast<const SkinnedMeshRenderer*>(context);
+	renderer.Shader->setInt(renderer.PaletteOffsetUniform, (int)renderer.PaletteOffset);
+	renderer.Shader->setBool(renderer.DualQuaternionUniform, renderer.Mode == SkinningMode::DualQuaternion);
+	renderer.Palette->Bind();
+}
+
+void SkinnedMeshRenderer::Submit(RenderQueue& queue)
+{
+	DrawPacket packet;
+	packet.Program = Shader;
+	packet.VertexArray = VertexArrayObject;
+	packet.Mode = GL_TRIANGLES;
+	packet.Indexed = true;
+	packet.Count = (int)MeshData->Indices.size();
+	packet.Prepare = &SkinnedMeshRenderer::PrepareDraw;
+	packet.Context = this;
+	queue.Submit(packet);
+}
+
+void SkinnedMeshRenderer::SetUp()
+{
+	const std::vector<SkinnedVertex> vertices = PackSkinnedVertices(*MeshData, *Skinning);
+	PaletteOffsetUniform = Shader->getUniform("paletteOffset");
+	DualQuaternionUniform = Shader->getUniform("dualQuaternionSkinning");
+
+	glGenVertexArrays(1, &VertexArrayObject);
+	glBindVertexArray(VertexArrayObject);
+
+	glGenBuffers(1, &VertexBufferObject);
+	glGenBuffers(1, &ElementBufferObject);
+
+	glBindBuffer(GL_ARRAY_BUFFER, VertexBufferObject);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(SkinnedVertex) * vertices.size(), vertices.data(), GL_STATIC_DRAW);
+	for (unsigned int location = 0; location < 5; ++location)
+		glEnableVertexAttribArray(location);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(SkinnedVertex), (void*)offsetof(SkinnedVertex, Position));
+	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(SkinnedVertex), (void*)offsetof(SkinnedVertex, TextCoords));
+	glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(SkinnedVertex), (void*)offsetof(SkinnedVertex, Normal));
+	// integer attribute, glVertexAttribPointer would convert the indices to float
+	glVertexAttribIPointer(3, 4, GL_INT, sizeof(SkinnedVertex), (void*)offsetof(SkinnedVertex, Joints));
+	glVertexAttribPointer(4, 4, GL_FLOAT, GL_FALSE, sizeof(SkinnedVertex), (void*)offsetof(SkinnedVertex, Weights));
+
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ElementBufferObject);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, MeshData->Indices.size() * sizeof(unsigned int), MeshData->Indices.data(), GL_STATIC_DRAW);
+	glBindVertexArray(0);
+}
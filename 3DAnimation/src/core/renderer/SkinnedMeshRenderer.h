@@ -0,0 +1,57 @@
+#pragma once
+#include <vector>
+#include <cstddef>
+#include "Renderer.h"
+#include "ShaderProgram.h"
+#include "glm/glm.hpp"
+
+struct SkinnedMeshData;
+struct SkinningMesh;
+enum class SkinningMode;
+class BonePalette;
+
+// vertex of the skinning shader (Shaders/skin_vert.sh), the attribute locations in order
+struct SkinnedVertex
+{
+	glm::vec3 Position;
+	glm::vec2 TextCoords;
+	glm::vec3 Normal;
+	// indices of the skin joints, the palette range of the mesh
+	glm::ivec4 Joints;
+	glm::vec4 Weights;
+};
+
+// the vertices of mesh with the influences of skinning, the ones the cpu skinning uses
+std::vector<SkinnedVertex> PackSkinnedVertices(const SkinnedMeshData& mesh, const SkinningMesh& skinning);
+
+// Draws a skinned mesh deformed on the gpu. The skinning transforms are read from the range of
+// the palette given by SetPaletteOffset, matrices (ComputeSkinningMatrices of skinning) or dual
+// quaternions (ComputeSkinningDualQuaternions) depending on the skinning mode.
+class SkinnedMeshRenderer final : public Renderer
+{
+	const SkinnedMeshData* MeshData;
+	const SkinningMesh* Skinning;
+	BonePalette* Palette;
+	std::size_t PaletteOffset;
+	SkinningMode Mode;
+	// looked up in SetUp, set for every draw
+	UniformHandle PaletteOffsetUniform;
+	UniformHandle DualQuaternionUniform;
+
+	// the uniforms and palette of a draw, the context is the renderer
+	static void PrepareDraw(void* context);
+public:
+	SkinnedMeshRenderer(GameObject* parent, ShaderProgram* shader, const SkinnedMeshData* mesh, const SkinningMesh* skinning, BonePalette* palette);
+	virtual ~SkinnedMeshRenderer();
+	SkinnedMeshRenderer(const SkinnedMeshRenderer&) = delete;
+	SkinnedMeshRenderer& operator=(const SkinnedMeshRenderer&) = delete;
+
+	// index of the first skinning transform of the mesh in the palette of this frame
+	void SetPaletteOffset(std::size_t offset) { PaletteOffset = offset; }
+	// linear blend by default
+	void SetSkinningMode(SkinningMode mode) { Mode = mode; }
+	SkinningMode GetSkinningMode() const { return Mode; }
+	void Render() override;
+	void Submit(RenderQueue& queue) override;
+	void SetUp()  override;
+};
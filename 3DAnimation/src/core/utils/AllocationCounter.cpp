@@ -0,0 +1,58 @@
+#include "AllocationCounter.h"
+
+#ifdef COUNT_ALLOCATIONS
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace
+{
+	std::atomic<std::size_t> AllocationCount{ 0 };
+
+	// nullptr when the memory runs out, the throwing forms turn it into bad_alloc
+	void* CountedAllocate(std::size_t size) noexcept
+	{
+		++AllocationCount;
+		return std::malloc(size ? size : 1);
+	}
+
+	void* CountedAllocateOrThrow(std::size_t size)
+	{
+		if (void* memory = CountedAllocate(size))
+			return memory;
+		throw std::bad_alloc();
+	}
+}
+
+void* operator new(std::size_t size) { return CountedAllocateOrThrow(size); }
+void* operator new[](std::size_t size) { return CountedAllocateOrThrow(size); }
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept { return CountedAllocate(size); }
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept { return CountedAllocate(size); }
+
+void operator delete(void* memory) noexcept { std::free(memory); }
+void operator delete[](void* memory) noexcept { std::free(memory); }
+void operator delete(void* memory, std::size_t) noexcept { std::free(memory); }
+void operator delete[](void* memory, std::size_t) noexcept { std::free(memory); }
+void operator delete(void* memory, const std::nothrow_t&) noexcept { std::free(memory); }
+void operator delete[](void* memory, const std::nothrow_t&) noexcept { std::free(memory); }
+
+bool IsCountingAllocations()
+{
+	return true;
+}
+
+std::size_t GetAllocationCount()
+{
+	return AllocationCount.load();
+}
+#else
+bool IsCountingAllocations()
+{
+	return false;
+}
+
+std::size_t GetAllocationCount()
+{
+	return 0;
+}
+#endif
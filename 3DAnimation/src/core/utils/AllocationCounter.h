@@ -0,0 +1,9 @@
+#pragma once
+#include <cstddef>
+
+// Heap allocations of the process, for --check-allocations. The global operator new and delete
+// (every form: sized, array, nothrow) are only replaced when the project is built with
+// COUNT_ALLOCATIONS defined, the viewer keeps the ones of the runtime.
+bool IsCountingAllocations();
+// operator new calls since the start, always 0 without COUNT_ALLOCATIONS
+std::size_t GetAllocationCount();
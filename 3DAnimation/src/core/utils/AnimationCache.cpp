@@ -0,0 +1,449 @@
+#include "AnimationCache.h"
+#include <fstream>
+#include <iostream>
+#include <cstring>
+#include <algorithm>
+#include <cstddef>
+#include <type_traits>
+#include "app/Joint.h"
+#include "ColladaStreamReader.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#define CACHE_ERR "[Animation cache]: "
+
+constexpr uint32_t CACHE_FLAG_AXIS_CORRECTION = 1;
+
+static_assert(std::is_trivially_copyable<KeyFrame>::value, "KeyFrame is stored raw in the cache");
+static_assert(std::is_trivially_copyable<BakedJoint>::value, "BakedJoint is stored raw in the cache");
+static_assert(sizeof(AnimationCacheHeader) % 16 == 0, "header must keep the blocks aligned");
+static_assert(sizeof(BakedJoint) % 16 == 0, "joints must keep the blocks aligned");
+
+namespace
+{
+	bool IsLittleEndianHost()
+	{
+		const uint32_t value = 1;
+		unsigned char first = 0;
+		std::memcpy(&first, &value, 1);
+		return first == 1;
+	}
+
+	uint64_t Align16(uint64_t offset)
+	{
+		return (offset + 15) & ~uint64_t(15);
+	}
+
+	uint64_t Fnv1a(const unsigned char* data, std::size_t size)
+	{
+		uint64_t hash = 14695981039346656037ull;
+		for (std::size_t i = 0; i < size; ++i)
+		{
+			hash ^= data[i];
+			hash *= 1099511628211ull;
+		}
+		return hash;
+	}
+
+	uint32_t AddName(std::string& names, const std::string& name)
+	{
+		uint32_t offset = (uint32_t)names.size();
+		names += name;
+		return offset;
+	}
+
+	// depth first so every parent is written before its children
+	void FlattenSkeleton(Joint* node, int parent, std::vector<BakedJoint>& joints, std::string& names)
+	{
+		BakedJoint baked{};
+		baked.ID = node->ID;
+		baked.Parent = parent;
+		baked.NameOffset = AddName(names, node->Name);
+		baked.NameLength = (uint32_t)node->Name.size();
+		baked.ChannelOffset = AddName(names, node->Channel);
+		baked.ChannelLength = (uint32_t)node->Channel.size();
+		baked.LocalBindTransform = node->localBindTransform;
+		baked.InverseTransform = node->InverseTransform;
+
+		int index = (int)joints.size();
+		joints.push_back(baked);
+
+		for (Joint* child : node->Children)
+			FlattenSkeleton(child, index, joints, names);
+	}
+
+	// size and last write time of a file, the time in the units of the system (100 ns on windows)
+	bool GetSourceStamp(const char* path, uint64_t& size, int64_t& modified)
+	{
+#ifdef _WIN32
+		WIN32_FILE_ATTRIBUTE_DATA info{};
+		if (!GetFileAttributesExA(path, GetFileExInfoStandard, &info)) return false;
+		size = ((uint64_t)info.nFileSizeHigh << 32) | info.nFileSizeLow;
+		modified = (int64_t)(((uint64_t)info.ftLastWriteTime.dwHighDateTime << 32) | info.ftLastWriteTime.dwLowDateTime);
+#else
+		struct stat info {};
+		if (stat(path, &info) != 0) return false;
+		size = (uint64_t)info.st_size;
+#ifdef __APPLE__
+		modified = (int64_t)info.st_mtimespec.tv_sec * 1000000000 + info.st_mtimespec.tv_nsec;
+#else
+		modified = (int64_t)info.st_mtim.tv_sec * 1000000000 + info.st_mtim.tv_nsec;
+#endif
+#endif
+		return true;
+	}
+
+	// rewrites the stamp of the header of a baked file, the file must not be mapped
+	bool WriteSourceStamp(const char* cachePath, uint64_t size, int64_t modified)
+	{
+		std::fstream file(cachePath, std::ios::in | std::ios::out | std::ios::binary);
+		if (!file.is_open()) return false;
+		file.seekp(offsetof(AnimationCacheHeader, SourceSize));
+		file.write((const char*)&size, sizeof(size));
+		file.write((const char*)&modified, sizeof(modified));
+		return !file.fail();
+	}
+
+	// count elements of elementSize from offset inside size bytes, none of it can overflow
+	bool BlockFits(uint64_t offset, uint64_t count, uint64_t elementSize, uint64_t size)
+	{
+		return offset <= size && count <= (size - offset) / elementSize;
+	}
+
+	bool NameFits(uint32_t offset, uint32_t length, uint32_t namesSize)
+	{
+		return (uint64_t)offset + length <= namesSize;
+	}
+
+	// what the blocks point at: parents before their children (the first joint is the root),
+	// frames and names inside their blocks
+	bool IsContentValid(const AnimationCacheHeader& header, const BakedJoint* joints, const BakedChannel* channels)
+	{
+		for (uint32_t i = 0; i < header.JointCount; ++i)
+		{
+			const BakedJoint& joint = joints[i];
+			const bool parentValid = i == 0 ? joint.Parent < 0 : joint.Parent >= 0 && (uint32_t)joint.Parent < i;
+			if (!parentValid
+				|| !NameFits(joint.NameOffset, joint.NameLength, header.NamesSize)
+				|| !NameFits(joint.ChannelOffset, joint.ChannelLength, header.NamesSize))
+				return false;
+		}
+		for (uint32_t i = 0; i < header.ChannelCount; ++i)
+		{
+			const BakedChannel& channel = channels[i];
+			if ((uint64_t)channel.FirstFrame + channel.FrameCount > header.FrameCount
+				|| !NameFits(channel.NameOffset, channel.NameLength, header.NamesSize))
+				return false;
+		}
+		return true;
+	}
+
+	void WritePadding(std::ofstream& out, uint64_t from, uint64_t to)
+	{
+		static const char zeros[16] = {};
+		out.write(zeros, (std::streamsize)(to - from));
+	}
+}
+
+MappedFile::MappedFile()
+	: Data{ nullptr }
+	, Size{}
+#ifdef _WIN32
+	, FileHandle{ INVALID_HANDLE_VALUE }
+	, MappingHandle{ nullptr }
+#else
+	, FileDescriptor{ -1 }
+#endif
+{
+}
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+bool MappedFile::Open(const char* path)
+{
+	Close();
+#ifdef _WIN32
+	FileHandle = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (FileHandle == INVALID_HANDLE_VALUE) return false;
+
+	LARGE_INTEGER size{};
+	if (!GetFileSizeEx(FileHandle, &size) || size.QuadPart == 0) { Close(); return false; }
+
+	MappingHandle = CreateFileMappingA(FileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!MappingHandle) { Close(); return false; }
+
+	Data = (const unsigned char*)MapViewOfFile(MappingHandle, FILE_MAP_READ, 0, 0, 0);
+	if (!Data) { Close(); return false; }
+	Size = (std::size_t)size.QuadPart;
+#else
+	FileDescriptor = open(path, O_RDONLY);
+	if (FileDescriptor < 0) return false;
+
+	struct stat info {};
+	if (fstat(FileDescriptor, &info) != 0 || info.st_size == 0) { Close(); return false; }
+
+	void* data = mmap(nullptr, (std::size_t)info.st_size, PROT_READ, MAP_PRIVATE, FileDescriptor, 0);
+	if (data == MAP_FAILED) { Close(); return false; }
+	Data = (const unsigned char*)data;
+	Size = (std::size_t)info.st_size;
+#endif
+	return true;
+}
+
+void MappedFile::Close()
+{
+#ifdef _WIN32
+	if (Data) UnmapViewOfFile(Data);
+	if (MappingHandle) CloseHandle(MappingHandle);
+	if (FileHandle != INVALID_HANDLE_VALUE) CloseHandle(FileHandle);
+	MappingHandle = nullptr;
+	FileHandle = INVALID_HANDLE_VALUE;
+#else
+	if (Data) munmap((void*)Data, Size);
+	if (FileDescriptor >= 0) close(FileDescriptor);
+	FileDescriptor = -1;
+#endif
+	Data = nullptr;
+	Size = 0;
+}
+
+AnimationCache::AnimationCache()
+	: File{}
+	, Header{ nullptr }
+	, Joints{ nullptr }
+	, Channels{ nullptr }
+	, Frames{ nullptr }
+	, Names{ nullptr }
+{
+}
+
+uint64_t AnimationCache::HashFile(const char* path)
+{
+	MappedFile source;
+	if (!source.Open(path)) return 0;
+	return Fnv1a(source.GetData(), source.GetSize());
+}
+
+std::string AnimationCache::GetCachePath(const char* colladaPath)
+{
+	std::string path = colladaPath;
+	std::size_t dot = path.find_last_of('.');
+	std::size_t slash = path.find_last_of("/\\");
+	if (dot != std::string::npos && (slash == std::string::npos || dot > slash))
+		path.erase(dot);
+	return path + ".anim";
+}
+
+bool AnimationCache::Bake(const char* colladaPath, const char* cachePath, bool applyAxisCorrection)
+{
+	if (!IsLittleEndianHost())
+	{
+		std::cerr << CACHE_ERR << "baking is only supported on little-endian hosts" << std::endl;
+		return false;
+	}
+
+	uint64_t sourceHash = HashFile(colladaPath);
+	uint64_t sourceSize = 0;
+	int64_t sourceModified = 0;
+	if (sourceHash == 0 || !GetSourceStamp(colladaPath, sourceSize, sourceModified))
+	{
+		std::cerr << CACHE_ERR << "can't read " << colladaPath << std::endl;
+		return false;
+	}
+
+	ColladaStreamReader reader;
+	if (!reader.Read(colladaPath, applyAxisCorrection))
+		return false;
+	Joint* root = reader.GetJointHerarchy();
+	const std::vector<JointAnimation>& animation = reader.GetAnimation();
+
+	std::vector<BakedJoint> joints;
+	std::string names;
+	FlattenSkeleton(root, -1, joints, names);
+	delete root;
+
+	std::vector<BakedChannel> channels;
+	std::vector<KeyFrame> frames;
+	channels.reserve(animation.size());
+	for (const JointAnimation& joint : animation)
+	{
+		BakedChannel channel{};
+		channel.FirstFrame = (uint32_t)frames.size();
+		channel.FrameCount = (uint32_t)joint.Frames.size();
+		channel.NameOffset = AddName(names, joint.jointName);
+		channel.NameLength = (uint32_t)joint.jointName.size();
+		frames.insert(frames.end(), joint.Frames.begin(), joint.Frames.end());
+		channels.push_back(channel);
+	}
+
+	AnimationCacheHeader header{};
+	header.Magic = ANIMATION_CACHE_MAGIC;
+	header.Version = ANIMATION_CACHE_VERSION;
+	header.Endian = ANIMATION_CACHE_ENDIAN;
+	header.Flags = applyAxisCorrection ? CACHE_FLAG_AXIS_CORRECTION : 0;
+	header.SourceHash = sourceHash;
+	header.SourceSize = sourceSize;
+	header.SourceModified = sourceModified;
+	header.JointCount = (uint32_t)joints.size();
+	header.ChannelCount = (uint32_t)channels.size();
+	header.FrameCount = (uint32_t)frames.size();
+	header.NamesSize = (uint32_t)names.size();
+	header.JointsOffset = sizeof(AnimationCacheHeader);
+	header.ChannelsOffset = Align16(header.JointsOffset + joints.size() * sizeof(BakedJoint));
+	header.FramesOffset = Align16(header.ChannelsOffset + channels.size() * sizeof(BakedChannel));
+	header.NamesOffset = Align16(header.FramesOffset + frames.size() * sizeof(KeyFrame));
+
+	std::ofstream out(cachePath, std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!out.is_open())
+	{
+		std::cerr << CACHE_ERR << "can't write " << cachePath << std::endl;
+		return false;
+	}
+
+	uint64_t position = 0;
+	out.write((const char*)&header, sizeof(header));
+	position += sizeof(header);
+
+	out.write((const char*)joints.data(), joints.size() * sizeof(BakedJoint));
+	position += joints.size() * sizeof(BakedJoint);
+	WritePadding(out, position, header.ChannelsOffset);
+	position = header.ChannelsOffset;
+
+	out.write((const char*)channels.data(), channels.size() * sizeof(BakedChannel));
+	position += channels.size() * sizeof(BakedChannel);
+	WritePadding(out, position, header.FramesOffset);
+	position = header.FramesOffset;
+
+	out.write((const char*)frames.data(), frames.size() * sizeof(KeyFrame));
+	position += frames.size() * sizeof(KeyFrame);
+	WritePadding(out, position, header.NamesOffset);
+
+	out.write(names.data(), names.size());
+	out.close();
+
+	return !out.fail();
+}
+
+bool AnimationCache::Open(const char* colladaPath, const char* cachePath, bool applyAxisCorrection)
+{
+	uint32_t flags = applyAxisCorrection ? CACHE_FLAG_AXIS_CORRECTION : 0;
+
+	// the source wasn't touched since the bake, it isn't read at all
+	uint64_t sourceSize = 0;
+	int64_t sourceModified = 0;
+	const bool stamped = GetSourceStamp(colladaPath, sourceSize, sourceModified);
+	if (stamped && OpenBaked(cachePath, 0, flags) && Header->SourceSize == sourceSize && Header->SourceModified == sourceModified)
+		return true;
+
+	// touched or copied, the content decides. The same content gets the new stamp so the next
+	// launch doesn't hash it again
+	uint64_t sourceHash = HashFile(colladaPath);
+	if (sourceHash != 0 && OpenBaked(cachePath, sourceHash, flags))
+	{
+		if (!stamped) return true;
+		Close();
+		if (!WriteSourceStamp(cachePath, sourceSize, sourceModified))
+			std::cerr << CACHE_ERR << "can't update " << cachePath << std::endl;
+		return OpenBaked(cachePath, sourceHash, flags);
+	}
+
+	// stale or missing cache, bake it again
+	if (!Bake(colladaPath, cachePath, applyAxisCorrection))
+		return false;
+
+	return OpenBaked(cachePath, sourceHash, flags);
+}
+
+bool AnimationCache::OpenBaked(const char* cachePath, uint64_t expectedHash, uint32_t flags)
+{
+	Close();
+
+	if (!IsLittleEndianHost() || !File.Open(cachePath))
+		return false;
+
+	const unsigned char* data = File.GetData();
+	const std::size_t size = File.GetSize();
+	const AnimationCacheHeader* header = (const AnimationCacheHeader*)data;
+
+	bool valid = size >= sizeof(AnimationCacheHeader)
+		&& header->Magic == ANIMATION_CACHE_MAGIC
+		&& header->Version == ANIMATION_CACHE_VERSION
+		&& header->Endian == ANIMATION_CACHE_ENDIAN
+		&& header->Flags == flags
+		&& (expectedHash == 0 || header->SourceHash == expectedHash)
+		&& BlockFits(header->JointsOffset, header->JointCount, sizeof(BakedJoint), size)
+		&& BlockFits(header->ChannelsOffset, header->ChannelCount, sizeof(BakedChannel), size)
+		&& BlockFits(header->FramesOffset, header->FrameCount, sizeof(KeyFrame), size)
+		&& BlockFits(header->NamesOffset, header->NamesSize, 1, size);
+	// a truncated or corrupted file with a good header, Open bakes it again
+	valid = valid && IsContentValid(*header, (const BakedJoint*)(data + header->JointsOffset), (const BakedChannel*)(data + header->ChannelsOffset));
+
+	if (!valid)
+	{
+		File.Close();
+		return false;
+	}
+
+	Header = header;
+	Joints = (const BakedJoint*)(data + header->JointsOffset);
+	Channels = (const BakedChannel*)(data + header->ChannelsOffset);
+	Frames = (const KeyFrame*)(data + header->FramesOffset);
+	Names = (const char*)(data + header->NamesOffset);
+	return true;
+}
+
+void AnimationCache::Close()
+{
+	File.Close();
+	Header = nullptr;
+	Joints = nullptr;
+	Channels = nullptr;
+	Frames = nullptr;
+	Names = nullptr;
+}
+
+Joint* AnimationCache::CreateJointHerarchy() const
+{
+	if (!Header || Header->JointCount == 0) return nullptr;
+
+	std::vector<Joint*> created(Header->JointCount, nullptr);
+	for (uint32_t i = 0; i < Header->JointCount; ++i)
+	{
+		const BakedJoint& baked = Joints[i];
+		Joint* j = new Joint;
+		j->ID = baked.ID;
+		j->Name = GetName(baked.NameOffset, baked.NameLength);
+		j->Channel = GetName(baked.ChannelOffset, baked.ChannelLength);
+		j->localBindTransform = baked.LocalBindTransform;
+		j->InverseTransform = baked.InverseTransform;
+		created[i] = j;
+
+		if (baked.Parent >= 0)
+			created[baked.Parent]->Children.push_back(j);
+	}
+	return created.front();
+}
+
+std::vector<JointAnimation> AnimationCache::CreateAnimation() const
+{
+	std::vector<JointAnimation> animation(GetChannelCount());
+	for (uint32_t i = 0; i < GetChannelCount(); ++i)
+	{
+		const BakedChannel& channel = Channels[i];
+		animation[i].jointName = GetName(channel.NameOffset, channel.NameLength);
+		animation[i].Frames.assign(GetFrames(channel), GetFrames(channel) + channel.FrameCount);
+	}
+	return animation;
+}
@@ -0,0 +1,139 @@
+#pragma once
+
+#ifndef ANIMATION_CACHE_HPP
+#define ANIMATION_CACHE_HPP
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+#include "app/JointAnimation.h"
+
+struct Joint;
+
+// Binary baked version of a collada file (.anim). Everything the application needs from the
+// skeleton and the animation is stored as plain little-endian data so the file can be mapped
+// in memory and read in place, no xml parsing or float conversion at startup.
+//
+// Layout:  [AnimationCacheHeader][BakedJoint * JointCount][BakedChannel * ChannelCount]
+//          [KeyFrame * FrameCount][names]
+// every block starts at a 16 byte aligned offset
+constexpr uint32_t ANIMATION_CACHE_MAGIC = 0x43414433; // "3DAC"
+// 2: key frames are stored as translation, rotation and scale
+// 3: size and modification time of the source
+constexpr uint32_t ANIMATION_CACHE_VERSION = 3;
+constexpr uint32_t ANIMATION_CACHE_ENDIAN = 0x01020304;
+
+struct AnimationCacheHeader
+{
+	uint32_t Magic;
+	uint32_t Version;
+	uint32_t Endian;
+	uint32_t Flags;
+	uint64_t SourceHash;
+	// when they still match the source isn't hashed again (AnimationCache::Open)
+	uint64_t SourceSize;
+	int64_t SourceModified;
+	uint32_t JointCount;
+	uint32_t ChannelCount;
+	uint32_t FrameCount;
+	uint32_t NamesSize;
+	uint64_t JointsOffset;
+	uint64_t ChannelsOffset;
+	uint64_t FramesOffset;
+	uint64_t NamesOffset;
+	uint32_t Padding[2];
+};
+
+// joints are stored depth first, so the parent is always before its children
+struct BakedJoint
+{
+	int32_t ID;
+	int32_t Parent;
+	uint32_t NameOffset;
+	uint32_t NameLength;
+	uint32_t ChannelOffset;
+	uint32_t ChannelLength;
+	uint32_t Padding[2];
+	glm::mat4 LocalBindTransform;
+	glm::mat4 InverseTransform;
+};
+
+// one channel per entry of the std::vector<JointAnimation>, in the same order
+struct BakedChannel
+{
+	uint32_t FirstFrame;
+	uint32_t FrameCount;
+	uint32_t NameOffset;
+	uint32_t NameLength;
+};
+
+class MappedFile
+{
+	const unsigned char* Data;
+	std::size_t Size;
+#ifdef _WIN32
+	void* FileHandle;
+	void* MappingHandle;
+#else
+	int FileDescriptor;
+#endif
+public:
+	MappedFile();
+	~MappedFile();
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	bool Open(const char* path);
+	void Close();
+	const unsigned char* GetData() const { return Data; }
+	std::size_t GetSize() const { return Size; }
+};
+
+class AnimationCache
+{
+	MappedFile File;
+	const AnimationCacheHeader* Header;
+	const BakedJoint* Joints;
+	const BakedChannel* Channels;
+	const KeyFrame* Frames;
+	const char* Names;
+
+public:
+	AnimationCache();
+	AnimationCache(const AnimationCache&) = delete;
+	AnimationCache& operator=(const AnimationCache&) = delete;
+
+	// parse the collada file and write the baked version to cachePath
+	static bool Bake(const char* colladaPath, const char* cachePath, bool applyAxisCorrection = false);
+	// FNV-1a hash of the whole file content, 0 if the file can't be read
+	static uint64_t HashFile(const char* path);
+	// assets/model.dae -> assets/model.anim
+	static std::string GetCachePath(const char* colladaPath);
+
+	// map cachePath, if it is missing, from another version or baked from a different
+	// collada content it is baked again first. The collada file is only hashed when its size or
+	// modification time changed since the bake
+	bool Open(const char* colladaPath, const char* cachePath, bool applyAxisCorrection = false);
+	// map cachePath without checking the source, expectedHash 0 skips the hash check
+	bool OpenBaked(const char* cachePath, uint64_t expectedHash = 0, uint32_t flags = 0);
+	void Close();
+	bool IsOpen() const { return Header != nullptr; }
+
+	// direct access to the mapped data
+	uint32_t GetJointCount() const { return Header ? Header->JointCount : 0; }
+	uint32_t GetChannelCount() const { return Header ? Header->ChannelCount : 0; }
+	const BakedJoint& GetJoint(uint32_t index) const { return Joints[index]; }
+	const BakedChannel& GetChannel(uint32_t index) const { return Channels[index]; }
+	const KeyFrame* GetFrames(const BakedChannel& channel) const { return Frames + channel.FirstFrame; }
+	std::string GetName(uint32_t offset, uint32_t length) const { return std::string(Names + offset, length); }
+
+	// build the structures used by the rest of the application (Animator owns the returned tree).
+	// The key frames are copied out of the mapping: JointAnimation, Animator and AnimationSystem
+	// keep their own std::vector<KeyFrame> and outlive the cache. What the cache saves is the xml
+	// parsing and the float conversion, a copy of the frames is a memcpy
+	Joint* CreateJointHerarchy() const;
+	std::vector<JointAnimation> CreateAnimation() const;
+};
+
+#endif //ANIMATION_CACHE_HPP
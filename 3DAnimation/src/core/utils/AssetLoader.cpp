@@ -0,0 +1,41 @@
+#include "AssetLoader.h"
+#include "ColladaParser.h"
+
+AssetLoader::AssetLoader(unsigned threadCount)
+	: Jobs{ threadCount }
+{
+	// on this thread, before any job can start a parse
+	InitXmlParser();
+}
+
+std::future<ColladaAsset> AssetLoader::Load(const std::string& path, bool applyAxisCorrection)
+{
+	return Jobs.Submit([path, applyAxisCorrection]() {
+		ColladaParser parser;
+		return parser.Load(path.c_str(), applyAxisCorrection);
+	});
+}
+
+std::vector<std::future<ColladaAsset>> AssetLoader::LoadAll(const std::vector<std::string>& paths, bool applyAxisCorrection)
+{
+	std::vector<std::future<ColladaAsset>> assets;
+	assets.reserve(paths.size());
+	for (const std::string& path : paths)
+		assets.push_back(Load(path, applyAxisCorrection));
+	return assets;
+}
+
+std::future<AnimationClip> AssetLoader::LoadClip(const std::string& path, Joint* skeleton)
+{
+	return Jobs.Submit([path, skeleton]() {
+		// borrow the skeleton, the asset doesn't own it here
+		ColladaAsset asset{};
+		asset.Skeleton = skeleton;
+
+		ColladaParser parser;
+		AnimationClip clip{};
+		if (parser.AttachAnimation(asset, path.c_str()))
+			clip = std::move(asset.Clips.front());
+		return clip;
+	});
+}
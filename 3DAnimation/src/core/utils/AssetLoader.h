@@ -0,0 +1,41 @@
+#pragma once
+
+#ifndef ASSET_LOADER_HPP
+#define ASSET_LOADER_HPP
+#include <string>
+#include <vector>
+#include <future>
+#include "JobSystem.h"
+#include "app/ColladaAsset.h"
+
+struct Joint;
+
+// Parses collada files concurrently, one ColladaParser per job on the worker threads.
+// libxml2 is initialised once before the workers start (InitXmlParser) and is released
+// when the process ends, never by a parser that finishes while others are still reading.
+class AssetLoader
+{
+	JobSystem Jobs;
+
+public:
+	// 0 threads uses one per hardware thread
+	explicit AssetLoader(unsigned threadCount = 0);
+	// waits for the files still queued
+	~AssetLoader() = default;
+	AssetLoader(const AssetLoader&) = delete;
+	AssetLoader& operator=(const AssetLoader&) = delete;
+
+	// skeleton, skin and animation of a rig file, as ColladaParser::Load: without skeleton
+	// when the file can't be read
+	std::future<ColladaAsset> Load(const std::string& path, bool applyAxisCorrection = false);
+	// one job per file, the futures are in the same order as paths
+	std::vector<std::future<ColladaAsset>> LoadAll(const std::vector<std::string>& paths, bool applyAxisCorrection = false);
+	// animation of another file bound to skeleton, as ColladaParser::AttachAnimation.
+	// The skeleton is only read and must be alive until the future is ready.
+	// The clip has no frames if the file has no animation.
+	std::future<AnimationClip> LoadClip(const std::string& path, Joint* skeleton);
+
+	std::size_t GetThreadCount() const { return Jobs.GetThreadCount(); }
+};
+
+#endif //ASSET_LOADER_HPP
@@ -0,0 +1,83 @@
+#include "ColladaIndex.h"
+#include <vector>
+
+void ColladaIndex::Build(xmlNode* root)
+{
+	Clear();
+
+	// depth first in document order, emplace keeps the first node of every key
+	std::vector<xmlNode*> stack;
+	if (root) stack.push_back(root);
+
+	while (!stack.empty())
+	{
+		xmlNode* node = stack.back();
+		stack.pop_back();
+
+		Elements.emplace((const char*)node->name, node);
+
+		for (xmlAttr* attr = node->properties; attr; attr = attr->next)
+		{
+			if (!attr->children || !attr->children->content) continue;
+			const char* name = (const char*)attr->name;
+			const char* value = (const char*)attr->children->content;
+
+			if (std::strcmp(name, "id") == 0)
+				Ids.emplace(value, node);
+			else if (std::strcmp(name, "sid") == 0)
+				Sids.emplace(ScopedKey(node->parent, value), node);
+			else if (std::strcmp(name, "name") == 0)
+				Names.emplace(value, node);
+		}
+
+		// push in reverse so the first child is visited first
+		for (xmlNode* child = node->last; child; child = child->prev)
+		{
+			if (child->type == XML_ELEMENT_NODE)
+				stack.push_back(child);
+		}
+	}
+}
+
+void ColladaIndex::Clear()
+{
+	Ids.clear();
+	Names.clear();
+	Elements.clear();
+	Sids.clear();
+}
+
+xmlNode* ColladaIndex::Find(const NodeMap& map, const char* key)
+{
+	if (!key) return nullptr;
+	auto it = map.find(key);
+	return it != map.end() ? it->second : nullptr;
+}
+
+xmlNode* ColladaIndex::FindById(const char* id) const
+{
+	return Find(Ids, id);
+}
+
+xmlNode* ColladaIndex::FindByUrl(const char* url) const
+{
+	if (!url) return nullptr;
+	return Find(Ids, url[0] == '#' ? url + 1 : url);
+}
+
+xmlNode* ColladaIndex::FindByName(const char* name) const
+{
+	return Find(Names, name);
+}
+
+xmlNode* ColladaIndex::FindElement(const char* tag) const
+{
+	return Find(Elements, tag);
+}
+
+xmlNode* ColladaIndex::FindBySid(const xmlNode* parent, const char* sid) const
+{
+	if (!sid) return nullptr;
+	auto it = Sids.find(ScopedKey(parent, sid));
+	return it != Sids.end() ? it->second : nullptr;
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#ifndef COLLADA_INDEX_HPP
+#define COLLADA_INDEX_HPP
+#include <cstring>
+#include <utility>
+#include <functional>
+#include <unordered_map>
+#include <libxml/tree.h>
+
+// One pass index of a collada document so the parser doesn't walk the tree for every lookup.
+// ids are unique in the document, sids are only unique inside their parent element
+// (every joint has its own <matrix sid="transform">) and for names and element tags the
+// first one in document order is kept.
+class ColladaIndex
+{
+	// keys point into the document, the index is only valid while the document is alive
+	struct StringHash
+	{
+		std::size_t operator()(const char* key) const
+		{
+			// FNV-1a
+			std::size_t hash = 2166136261u;
+			for (; *key; ++key)
+				hash = (hash ^ (unsigned char)*key) * 16777619u;
+			return hash;
+		}
+	};
+
+	struct StringEqual
+	{
+		bool operator()(const char* a, const char* b) const { return std::strcmp(a, b) == 0; }
+	};
+
+	typedef std::pair<const xmlNode*, const char*> ScopedKey;
+
+	struct ScopedKeyHash
+	{
+		std::size_t operator()(const ScopedKey& key) const
+		{
+			return std::hash<const void*>()(key.first) ^ (StringHash()(key.second) << 1);
+		}
+	};
+
+	struct ScopedKeyEqual
+	{
+		bool operator()(const ScopedKey& a, const ScopedKey& b) const
+		{
+			return a.first == b.first && std::strcmp(a.second, b.second) == 0;
+		}
+	};
+
+	typedef std::unordered_map<const char*, xmlNode*, StringHash, StringEqual> NodeMap;
+
+	NodeMap Ids;
+	NodeMap Names;
+	NodeMap Elements;
+	std::unordered_map<ScopedKey, xmlNode*, ScopedKeyHash, ScopedKeyEqual> Sids;
+
+	static xmlNode* Find(const NodeMap& map, const char* key);
+
+public:
+	void Build(xmlNode* root);
+	void Clear();
+
+	xmlNode* FindById(const char* id) const;
+	// url="#id" or source="#id"
+	xmlNode* FindByUrl(const char* url) const;
+	xmlNode* FindByName(const char* name) const;
+	xmlNode* FindElement(const char* tag) const;
+	xmlNode* FindBySid(const xmlNode* parent, const char* sid) const;
+
+	std::size_t GetSize() const { return Ids.size() + Names.size() + Sids.size(); }
+};
+
+#endif //COLLADA_INDEX_HPP
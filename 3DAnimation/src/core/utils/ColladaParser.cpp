@@ -3,11 +3,16 @@
 #include <utility>
 #include <iomanip>
 #include <cassert>
-#include <regex>
+#include <cstring>
+#include <cstdlib>
+#include <mutex>
+#include "FloatScanner.h"
+#include <glm/gtc/type_ptr.hpp>
 #include "app/Joint.h"
 #include "app/JointAnimation.h"
 
 #define READ_COLLADA_ERR  "can't read collada file"
+#define NO_SKELETON_ERR  "no skeleton in collada file"
 #define VISUAL_SCENES "library_visual_scenes"
 #define CONTROLLERS "library_controllers"
 #define ANIMATIONS "library_animations"
@@ -50,10 +55,10 @@ std::string readFile(const char* filePath)
 }
 
 
-glm::mat4 ColladaParser::CreateTransform(const std::vector<float>& matrixValues)
+glm::mat4 ColladaParser::CreateTransform(const float* matrixValues, std::size_t count)
 {
 	constexpr int stride = 16;
-	int matsize = matrixValues.size();
+	int matsize = count - count % stride;
 
 	glm::mat4 transform{};
 	for (int i = 0; i < matsize; i += stride)
@@ -90,10 +95,13 @@ ColladaParser::ColladaParser()
 	, LibraryControllers{nullptr}
 	, Armature{nullptr}
 	, RootJoint{nullptr}
+	, SkeletonRoot{nullptr}
 	, Animation{}
 	, ApplyAxisCorrection{false}
+	, LoadedPath{}
+	, Index{}
 {
-	LIBXML_TEST_VERSION
+	InitXmlParser();
 }
 
 ColladaParser::ColladaParser(ColladaParser && other)
@@ -103,8 +111,11 @@ ColladaParser::ColladaParser(ColladaParser && other)
 	, LibraryControllers{ other.LibraryControllers }
 	, Armature{ other.Armature }
 	, RootJoint{ other.RootJoint }
-	,  Animation{ other.Animation}
+	, SkeletonRoot{ other.SkeletonRoot }
+	,  Animation{ std::move(other.Animation)}
 	, ApplyAxisCorrection{other.ApplyAxisCorrection}
+	, LoadedPath{ std::move(other.LoadedPath) }
+	, Index{ std::move(other.Index) }
 {
 	other.XmlDocument = nullptr;
 	other.Root = nullptr;
@@ -118,14 +129,20 @@ ColladaParser & ColladaParser::operator=(ColladaParser && other)
 {
 	if (this == &other) return *this;
 	 
+	if (XmlDocument)
+		FreeDocument();
+
 	XmlDocument = other.XmlDocument;
 	Root = other.Root;
 	LibraryVisualScenes = other.LibraryVisualScenes;
 	LibraryControllers = other.LibraryControllers;
 	Armature = other.Armature;
 	RootJoint = other.RootJoint;
+	SkeletonRoot = other.SkeletonRoot;
 	ApplyAxisCorrection = other.ApplyAxisCorrection;
 	Animation = std::move(other.Animation);
+	LoadedPath = std::move(other.LoadedPath);
+	Index = std::move(other.Index);
 
 	other.XmlDocument = nullptr;
 	other.Root = nullptr;
@@ -137,7 +154,7 @@ ColladaParser & ColladaParser::operator=(ColladaParser && other)
 	return *this;
 }
 
-inline std::size_t splitString(const std::string &txt, std::vector<std::string> &strs, char ch) 
+std::size_t splitString(const std::string &txt, std::vector<std::string> &strs, char ch) 
 {
 	size_t pos = txt.find(ch);
 	size_t initialPos = 0;
@@ -158,14 +175,35 @@ inline std::size_t splitString(const std::string &txt, std::vector<std::string>
 void ColladaParser::FreeDocument()
 {
 	xmlFreeDoc(XmlDocument);
+	XmlDocument = nullptr;
+	Root = nullptr;
+	LibraryVisualScenes = nullptr;
+	LibraryControllers = nullptr;
+	Armature = nullptr;
+	RootJoint = nullptr;
+	LoadedPath.clear();
+	Index.Clear();
 }
 
 ColladaParser::~ColladaParser()
 {
 	if (XmlDocument)
 		FreeDocument();
-	xmlCleanupParser();
-	xmlMemoryDump();
+}
+
+void InitXmlParser()
+{
+	// libxml2 globals are shared by every parser of every thread: set them up once
+	// before the first parse and only release them when the process ends
+	static std::once_flag once;
+	std::call_once(once, [] {
+		LIBXML_TEST_VERSION
+		xmlInitParser();
+		std::atexit([] {
+			xmlCleanupParser();
+			xmlMemoryDump();
+		});
+	});
 }
 
 std::vector<xmlNode*> findAllWithProperty(xmlNode* a_node, const char* propertyName, const char* value)
@@ -209,52 +247,27 @@ std::vector<xmlNode*> findAllWithProperty(xmlNode* a_node, const char* propertyN
 
 
 
-xmlNode* findByPorperty(xmlNode* a_node, const char* propertyName, std::regex reg)
+// scan the numbers of a <source> (its <float_array> text) without copying the content
+std::size_t ReadFloatArray(xmlNode* source, std::vector<float>& out)
 {
-	std::queue<xmlNode*> q;
-	q.push(a_node);
-	xmlNode* foundNonde = nullptr;
-
-	while (!q.empty())
+	xmlNode* node = source;
+	while (node && node->type != XML_TEXT_NODE && node->type != XML_CDATA_SECTION_NODE)
 	{
-		xmlNode *cur_node = nullptr;
-		cur_node = q.front();
-		q.pop();
-		if (cur_node)
+		if (node->type == XML_ELEMENT_NODE && node->children)
 		{
-			xmlAttr* attr = cur_node->properties;
-
-			while (attr)
+			// reserve once with the count of the array if there is one
+			xmlChar* count = xmlGetProp(node, (const xmlChar*)"count");
+			if (count)
 			{
-				if (strcmp((const char*)attr->name, propertyName) == 0 && attr->children )
-				{
-					std::string name = (const char*)attr->children->content;					
-
-					if (std::regex_match(name, reg))
-					{
-						std::cout << name << std::endl;
-						foundNonde = cur_node;
-						cur_node = nullptr;
-						break;
-					}				
-				}
-				attr = attr->next;
-			}
-			if (foundNonde) break;
-
-			xmlNode* child = cur_node->children;
-
-			while (child != nullptr)
-			{
-				if (cur_node->type == XML_ELEMENT_NODE)
-				{
-					q.push(child);
-					child = child->next;
-				}
+				out.reserve(std::strtoul((const char*)count, nullptr, 10));
+				xmlFree(count);
 			}
 		}
+		node = node->children;
 	}
-	return foundNonde;
+	if (!node || !node->content) return 0;
+
+	return ScanFloats((const char*)node->content, out);
 }
 
 xmlNode* findNodeByName(xmlNode * a_node, const char* name)
@@ -297,19 +310,35 @@ Joint* ColladaParser::GetJointHerarchy(const char * path,bool applyAxisCorrectio
 {
 	ApplyAxisCorrection = applyAxisCorrection;
 
-	xmlKeepBlanksDefault(0);
-	XmlDocument = xmlReadFile(path, NULL, 0);
+	if (XmlDocument)
+		FreeDocument();
+	SkeletonRoot = nullptr;
+
+	XmlDocument = xmlReadFile(path, NULL, XML_PARSE_NOBLANKS);
 	if (XmlDocument == NULL)
-		assert(0 && READ_COLLADA_ERR && path);
+	{
+		std::cerr << READ_COLLADA_ERR << " " << path << std::endl;
+		return nullptr;
+	}
 
+	// kept until the next file, GetAnimation of the same path reuses it
+	LoadedPath = path;
 	Root = xmlDocGetRootElement(XmlDocument);
-	LibraryControllers = findNodeByName(Root, CONTROLLERS);
-	LibraryVisualScenes = findNodeByName(Root, VISUAL_SCENES);
-    Armature = findByPorperty(LibraryVisualScenes, "id", std::regex("(Armature)"));
-	RootJoint = findByPorperty(Armature, "type", std::regex("(JOINT)"));
+	// every lookup below (and the sid of each joint) is a hash lookup from here on
+	Index.Build(Root);
+	LibraryControllers = Index.FindElement(CONTROLLERS);
+	LibraryVisualScenes = Index.FindElement(VISUAL_SCENES);
+	Armature = Index.FindById("Armature");
+	RootJoint = FindRootJoint(Armature);
 	std::unordered_map<std::string, int> boneIndices{};
 	GetJointIndices(boneIndices);
     SkeletonRoot = ParseSkeleton(RootJoint,nullptr,boneIndices);
+	// no armature, or its root isn't one of the skin joints
+	if (!SkeletonRoot)
+	{
+		std::cerr << NO_SKELETON_ERR << " " << path << std::endl;
+		return nullptr;
+	}
 	SkeletonRoot->CalculateInverseBindTransform(glm::mat4(1.0f));
 	//print_tree(SkeletonRoot);
 	return SkeletonRoot;
@@ -317,57 +346,117 @@ Joint* ColladaParser::GetJointHerarchy(const char * path,bool applyAxisCorrectio
 
 std::vector<JointAnimation> ColladaParser::GetAnimation(const char* filepath)
 {
-	xmlKeepBlanksDefault(0);
-	xmlDocPtr document = xmlReadFile(filepath, NULL, 0);
+	// the skeleton file is already parsed, only read the file again if it is a different one
+	xmlDocPtr document = XmlDocument;
+	const bool ownsDocument = !XmlDocument || LoadedPath != filepath;
+	if (ownsDocument)
+	{
+		document = xmlReadFile(filepath, NULL, XML_PARSE_NOBLANKS);
+	}
 
 	if (document == NULL)
-		assert(0 && READ_COLLADA_ERR && filepath);
+	{
+		std::cerr << READ_COLLADA_ERR << " " << filepath << std::endl;
+		return {};
+	}
 
-	xmlNode* root = xmlDocGetRootElement(document);
-	xmlNode* libraryAnimations = findNodeByName(root, ANIMATIONS);
+	xmlNode* libraryAnimations = ownsDocument
+		? findNodeByName(xmlDocGetRootElement(document), ANIMATIONS)
+		: Index.FindElement(ANIMATIONS);
 	
-	if (!libraryAnimations) return {};
+	if (libraryAnimations && SkeletonRoot)
+	{
+		std::unordered_map<std::string, int> remapIndices;
+		//map channel to id
+		MapChannelToId(SkeletonRoot, remapIndices);
 
-	std::unordered_map<std::string, int> boneIndices{};
-	GetJointIndices(boneIndices);
+		Animation = ParseAnimation(libraryAnimations, remapIndices);
+	}
 
-	std::unordered_map<std::string, int> remapIndices;
-	//map name to id
-	MapNameToId(SkeletonRoot, boneIndices, remapIndices);
+	if (ownsDocument)
+		xmlFreeDoc(document);
 
-	Animation = ParseAnimation(libraryAnimations, remapIndices);
+	return libraryAnimations && SkeletonRoot ? Animation : std::vector<JointAnimation>{};
+}
 
-	xmlFreeDoc(document);
-	xmlCleanupParser();
-	xmlMemoryDump();
+ColladaAsset ColladaParser::Load(const char* path, bool applyAxisCorrection)
+{
+	ColladaAsset asset{};
+	asset.Skeleton = GetJointHerarchy(path, applyAxisCorrection);
+	if (!asset.Skeleton)
+	{
+		// unreadable or without skeleton, nothing else is read
+		FreeDocument();
+		return ColladaAsset{};
+	}
+	asset.Skin = ParseSkin();
+	asset.Meshes = ParseSkinnedMeshes();
 
-	return Animation;
+	// same document, no second read
+	xmlNode* libraryAnimations = Index.FindElement(ANIMATIONS);
+	if (libraryAnimations)
+	{
+		std::unordered_map<std::string, int> remapIndices;
+		MapChannelToId(asset.Skeleton, remapIndices);
+		asset.Clips.push_back({ GetClipName(path), ParseAnimation(libraryAnimations, remapIndices) });
+	}
+
+	FreeDocument();
+	return asset;
 }
 
+bool ColladaParser::AttachAnimation(ColladaAsset& asset, const char* path)
+{
+	if (!asset.Skeleton) return false;
+
+	xmlDocPtr document = xmlReadFile(path, NULL, XML_PARSE_NOBLANKS);
+	if (document == NULL)
+	{
+		std::cerr << READ_COLLADA_ERR << " " << path << std::endl;
+		return false;
+	}
+
+	xmlNode* libraryAnimations = findNodeByName(xmlDocGetRootElement(document), ANIMATIONS);
+	if (libraryAnimations)
+	{
+		// the channels are bound to the joints of the loaded skeleton, the rig of this file is not read
+		std::unordered_map<std::string, int> remapIndices;
+		MapChannelToId(asset.Skeleton, remapIndices);
+		asset.Clips.push_back({ GetClipName(path), ParseAnimation(libraryAnimations, remapIndices) });
+	}
+
+	xmlFreeDoc(document);
+	return libraryAnimations != nullptr;
+}
 
-void ColladaParser::MapNameToId(Joint *root, std::unordered_map<std::string, int>& bonesMap, std::unordered_map<std::string, int>& remapIndices)
+std::string ColladaParser::GetClipName(const char* path)
 {
-	std::string channel = root->Channel;
+	std::string name = path;
+	std::size_t slash = name.find_last_of("/\\");
+	if (slash != std::string::npos)
+		name.erase(0, slash + 1);
+	std::size_t dot = name.find_last_of('.');
+	if (dot != std::string::npos)
+		name.erase(dot);
+	return name;
+}
 
-	int id = bonesMap.at(root->Name);
-	remapIndices[channel] = id;
+void ColladaParser::MapChannelToId(Joint *root, std::unordered_map<std::string, int>& remapIndices)
+{
+	remapIndices[root->Channel] = root->ID;
 
 	for (Joint* child : root->Children)
 	{
-		MapNameToId(child, bonesMap, remapIndices);
+		MapChannelToId(child, remapIndices);
 	}
 
 }
 
-glm::mat4 ColladaParser::GetTransformMatrix(std::string& content)
+glm::mat4 ColladaParser::GetTransformMatrix(const char* content)
 {
-	std::vector<std::string> values_str{};
-	splitString(content, values_str, ' ');
-	if (values_str.back().empty())
-		values_str.pop_back();
-
-	std::vector<float> values = std::move(castStringstoType<float>(values_str));
-	glm::mat4 t = CreateTransform(values);
+	float values[16];
+	std::size_t count = ScanFloats(content, content + std::strlen(content), values, 16);
+	glm::mat4 t = CreateTransform(values, count);
 	return t;
 }
 
@@ -377,15 +466,15 @@ Joint* ColladaParser::CreateJoint(xmlNode* node)
 	j->Name = (const char*)node->properties->next->next->children->content;
 	j->Channel = (const char*)node->properties->children->content;
 
-	xmlNode* transform = findByPorperty(node, "sid", std::regex("(transform)"));
+	xmlNode* transform = Index.FindBySid(node, "transform");
 
 	// It must have a transform, if not something went terrible wrong
 	assert(transform != nullptr);
 
 	if (transform && transform->children)
 	{
-		std::string content = (const char*)transform->children->content;
-		assert(!content.empty());
+		const char* content = (const char*)transform->children->content;
+		assert(content && *content);
 		glm::mat4 t = GetTransformMatrix(content);
 		j->localBindTransform = t;
 	}
@@ -396,8 +485,12 @@ Joint* ColladaParser::CreateJoint(xmlNode* node)
 std::vector<JointAnimation> ColladaParser::ParseAnimation(xmlNode* libraryAnimations, const std::unordered_map<std::string, int>& boneIndices)
 {
 
-	// copy the bones to a vector of Joint animations for futher processing
-	std::vector<JointAnimation> jointAnimations(boneIndices.size());
+	// copy the bones to a vector of Joint animations for futher processing, indexed by joint id:
+	// joints sharing a channel leave fewer entries than ids
+	std::size_t size = boneIndices.size();
+	for (auto& j : boneIndices)
+		size = std::max(size, (std::size_t)j.second + 1);
+	std::vector<JointAnimation> jointAnimations(size);
 	for (auto& j : boneIndices)
 		jointAnimations[j.second].jointName = j.first;
 
@@ -455,40 +548,32 @@ std::vector<JointAnimation> ColladaParser::ParseAnimation(xmlNode* libraryAnimat
 
 		// find input data it should be the first node always
 		xmlNode* inputNode = node->children;
-		// get the keyframes
-		std::string keyframeData = (const char*) xmlNodeGetContent(inputNode);
 		//find the output pose matrix   should be second sibling of the input Node
 		xmlNode* outputNode = inputNode->next;
-		// get the matrices
-		std::string matrixTransformsData = (const char*)xmlNodeGetContent(outputNode);
-	    //split the string -> cast to float -> return an array
-		//key frames
-		std::vector<std::string> strings{};
-		splitString(keyframeData, strings,' ');
-		std::vector<float> keyframes = castStringstoType<float>(strings);
-		//matrices
-		strings.clear();
-		splitString(matrixTransformsData, strings, ' ');
-		std::vector<float> transformNumbers = castStringstoType<float>(strings);
+		// scan the keyframes and the matrices straight from the xml text
+		std::vector<float> keyframes;
+		ReadFloatArray(inputNode, keyframes);
+		std::vector<float> transformNumbers;
+		ReadFloatArray(outputNode, transformNumbers);
 
 		std::vector<glm::mat4> transforms;
 		transforms.reserve(transformNumbers.size() / 16);
 		
-		for (int startingIndex = 0; startingIndex < transformNumbers.size(); startingIndex+=16)
+		for (std::size_t startingIndex = 0; startingIndex + 16 <= transformNumbers.size(); startingIndex+=16)
 		{
 			
-			glm::mat4 matrix = CreateTransform({ transformNumbers.begin() + startingIndex,transformNumbers.begin() + startingIndex + 16 });
+			glm::mat4 matrix = CreateTransform(transformNumbers.data() + startingIndex, 16);
 			transforms.push_back(matrix);
 
 		}
 
 		std::vector<KeyFrame> keyframesVector;
 		keyframesVector.reserve(keyframes.size());
-		for (int i = 0; i < transforms.size(); ++i)
+		for (std::size_t i = 0; i < transforms.size() && i < keyframes.size(); ++i)
 		{
 			KeyFrame k;
 			k.TimeStamp = keyframes[i];
-			k.Transform = transforms[i];
+			k.SetTransform(transforms[i]);
 			keyframesVector.push_back(k);
 		}	
 		std::vector<std::string> targetBoneStrings;
@@ -516,7 +601,12 @@ Joint* ColladaParser::ParseSkeleton(xmlNode* node , Joint* parent,const std::uno
 		Joint* j = CreateJoint(node);
 		assert(j);
 
-		if (indices.find(j->Name) == indices.end()) return nullptr;//TODO: handle this situation
+		if (indices.find(j->Name) == indices.end())
+		{
+			// not a joint of the skin
+			delete j;
+			return nullptr;
+		}
 		j->ID = indices.at(j->Name);
 		
 		if (parent)
@@ -545,12 +635,403 @@ Joint* ColladaParser::ParseSkeleton(xmlNode* node , Joint* parent,const std::uno
 	return  parent;
 }
 
+xmlNode* ColladaParser::FindRootJoint(xmlNode* armature)
+{
+	// first node of type JOINT under the armature, breadth first
+	std::queue<xmlNode*> q;
+	q.push(armature);
+
+	while (!q.empty())
+	{
+		xmlNode* cur_node = q.front();
+		q.pop();
+		if (!cur_node) continue;
+
+		xmlChar* type = xmlGetProp(cur_node, (const xmlChar*)"type");
+		const bool isJoint = type && std::strcmp((const char*)type, "JOINT") == 0;
+		xmlFree(type);
+		if (isJoint) return cur_node;
+
+		for (xmlNode* child = cur_node->children; child; child = child->next)
+		{
+			if (child->type == XML_ELEMENT_NODE)
+				q.push(child);
+		}
+	}
+	return nullptr;
+}
+
+xmlNode* ColladaParser::FindJointNames()
+{
+	// <skin><joints><input semantic="JOINT" source="#Armature_..-skin-joints"/></joints></skin>
+	// the source holds the <Name_array> with the joint names
+	xmlNode* joints = Index.FindElement("joints");
+	if (!joints) return nullptr;
+
+	for (xmlNode* input = joints->children; input; input = input->next)
+	{
+		xmlChar* semantic = xmlGetProp(input, (const xmlChar*)"semantic");
+		xmlChar* source = xmlGetProp(input, (const xmlChar*)"source");
+		xmlNode* names = nullptr;
+		if (semantic && source && std::strcmp((const char*)semantic, "JOINT") == 0)
+		{
+			xmlNode* sourceNode = Index.FindByUrl((const char*)source);
+			names = sourceNode ? xmlFirstElementChild(sourceNode) : nullptr;
+		}
+		xmlFree(semantic);
+		xmlFree(source);
+		if (names) return names;
+	}
+	return nullptr;
+}
+
+SkinData ColladaParser::ParseSkin()
+{
+	xmlNode* Ids = FindJointNames();
+	if (!Ids || !Ids->parent || !Ids->parent->parent) return SkinData{};
+
+	// <skin> <bind_shape_matrix/> <source id="..-joints"><Name_array/></source> ... <joints/> </skin>
+	return ParseSkin(Ids->parent->parent);
+}
+
+SkinData ColladaParser::ParseSkin(xmlNode* skinNode)
+{
+	SkinData skin{};
+	std::vector<float> values;
+	for (xmlNode* child = skinNode->children; child; child = child->next)
+	{
+		if (child->type != XML_ELEMENT_NODE) continue;
+
+		if (std::strcmp((const char*)child->name, "bind_shape_matrix") == 0 && child->children)
+		{
+			values.clear();
+			ScanFloats((const char*)child->children->content, values);
+			if (values.size() >= 16)
+				skin.BindShapeMatrix = glm::transpose(glm::make_mat4(values.data()));
+		}
+		else if (std::strcmp((const char*)child->name, "joints") == 0)
+		{
+			for (xmlNode* input = child->children; input; input = input->next)
+			{
+				xmlChar* semantic = xmlGetProp(input, (const xmlChar*)"semantic");
+				xmlChar* source = xmlGetProp(input, (const xmlChar*)"source");
+				// source="#id", the source is a sibling of <joints>
+				xmlNode* s = semantic && source ? Index.FindByUrl((const char*)source) : nullptr;
+				if (s && s->parent == skinNode)
+				{
+					if (std::strcmp((const char*)semantic, "JOINT") == 0)
+					{
+						xmlNode* names = xmlFirstElementChild(s);
+						if (names && names->last && names->last->content)
+						{
+							splitString((const char*)names->last->content, skin.JointNames, ' ');
+							if (!skin.JointNames.empty() && skin.JointNames.back().empty())
+								skin.JointNames.pop_back();
+						}
+					}
+					else if (std::strcmp((const char*)semantic, "INV_BIND_MATRIX") == 0)
+					{
+						values.clear();
+						ReadFloatArray(s, values);
+						for (std::size_t i = 0; i + 16 <= values.size(); i += 16)
+							skin.InverseBindMatrices.push_back(glm::transpose(glm::make_mat4(values.data() + i)));
+					}
+				}
+				xmlFree(semantic);
+				xmlFree(source);
+			}
+		}
+	}
+	return skin;
+}
+
+std::vector<SkinnedMeshData> ColladaParser::ParseSkinnedMeshes()
+{
+	std::vector<SkinnedMeshData> meshes;
+	if (!LibraryControllers) return meshes;
+
+	// <controller><skin source="#geometry-id"> ... <vertex_weights/> </skin></controller>
+	for (xmlNode* controller = xmlFirstElementChild(LibraryControllers); controller; controller = xmlNextElementSibling(controller))
+	{
+		xmlNode* skinNode = xmlFirstElementChild(controller);
+		if (!skinNode || std::strcmp((const char*)skinNode->name, "skin") != 0) continue;
+
+		xmlChar* source = xmlGetProp(skinNode, (const xmlChar*)"source");
+		xmlNode* geometry = source ? Index.FindByUrl((const char*)source) : nullptr;
+		xmlFree(source);
+		if (!geometry) continue;
+
+		SkinnedMeshData mesh;
+		xmlChar* name = xmlGetProp(geometry, (const xmlChar*)"name");
+		if (!name) name = xmlGetProp(geometry, (const xmlChar*)"id");
+		mesh.Name = name ? (const char*)name : "";
+		xmlFree(name);
+
+		std::vector<int> positionIndices;
+		if (!ParseGeometry(geometry, mesh, positionIndices))
+		{
+			std::cerr << "[ColladaParser]: geometry " << mesh.Name << " has no triangles, skipped" << std::endl;
+			continue;
+		}
+		mesh.Skin = ParseSkin(skinNode);
+
+		xmlNode* vertexWeights = nullptr;
+		for (xmlNode* child = xmlFirstElementChild(skinNode); child; child = xmlNextElementSibling(child))
+		{
+			if (std::strcmp((const char*)child->name, "vertex_weights") == 0)
+				vertexWeights = child;
+		}
+		ParseVertexWeights(vertexWeights, positionIndices, mesh);
+		meshes.push_back(std::move(mesh));
+	}
+	return meshes;
+}
+
+namespace
+{
+	// values per element of a <source>, the stride of its <technique_common><accessor>
+	std::size_t GetSourceStride(xmlNode* source)
+	{
+		for (xmlNode* technique = xmlFirstElementChild(source); technique; technique = xmlNextElementSibling(technique))
+		{
+			if (std::strcmp((const char*)technique->name, "technique_common") != 0) continue;
+			xmlNode* accessor = xmlFirstElementChild(technique);
+			xmlChar* stride = accessor ? xmlGetProp(accessor, (const xmlChar*)"stride") : nullptr;
+			const std::size_t value = stride ? std::strtoul((const char*)stride, nullptr, 10) : 1;
+			xmlFree(stride);
+			return value > 0 ? value : 1;
+		}
+		return 1;
+	}
+
+	void ReadIntArray(xmlNode* node, std::vector<int>& out)
+	{
+		if (!node || !node->children || !node->children->content) return;
+		const char* text = (const char*)node->children->content;
+		ScanNumbers(text, text + std::strlen(text), [&](double value) { out.push_back((int)value); });
+	}
+
+	// one <input> of a primitive or of <vertex_weights>
+	struct PrimitiveInput
+	{
+		std::string Semantic;
+		xmlNode* Source = nullptr;
+		int Offset = 0;
+		int Set = 0;
+	};
+
+	std::vector<PrimitiveInput> ReadInputs(xmlNode* parent, const ColladaIndex& index)
+	{
+		std::vector<PrimitiveInput> inputs;
+		for (xmlNode* input = xmlFirstElementChild(parent); input; input = xmlNextElementSibling(input))
+		{
+			if (std::strcmp((const char*)input->name, "input") != 0) continue;
+
+			PrimitiveInput in;
+			xmlChar* semantic = xmlGetProp(input, (const xmlChar*)"semantic");
+			xmlChar* source = xmlGetProp(input, (const xmlChar*)"source");
+			xmlChar* offset = xmlGetProp(input, (const xmlChar*)"offset");
+			xmlChar* set = xmlGetProp(input, (const xmlChar*)"set");
+			in.Semantic = semantic ? (const char*)semantic : "";
+			in.Source = source ? index.FindByUrl((const char*)source) : nullptr;
+			in.Offset = offset ? std::atoi((const char*)offset) : 0;
+			in.Set = set ? std::atoi((const char*)set) : 0;
+			xmlFree(semantic);
+			xmlFree(source);
+			xmlFree(offset);
+			xmlFree(set);
+			inputs.push_back(in);
+		}
+		return inputs;
+	}
+}
+
+bool ColladaParser::ParseGeometry(xmlNode* geometry, SkinnedMeshData& mesh, std::vector<int>& positionIndices)
+{
+	xmlNode* meshNode = xmlFirstElementChild(geometry);
+	if (!meshNode || std::strcmp((const char*)meshNode->name, "mesh") != 0) return false;
+
+	std::vector<float> positions, normals, texCoords;
+	std::size_t normalStride = 3, texCoordStride = 2;
+	// the distinct (position, normal, texture coordinate) of the polygons
+	std::unordered_map<unsigned long long, unsigned int> vertices;
+
+	for (xmlNode* primitive = xmlFirstElementChild(meshNode); primitive; primitive = xmlNextElementSibling(primitive))
+	{
+		const bool triangles = std::strcmp((const char*)primitive->name, "triangles") == 0;
+		const bool polylist = std::strcmp((const char*)primitive->name, "polylist") == 0;
+		if (!triangles && !polylist) continue;
+
+		int positionOffset = -1, normalOffset = -1, texCoordOffset = -1, stride = 1;
+		for (const PrimitiveInput& input : ReadInputs(primitive, Index))
+		{
+			stride = std::max(stride, input.Offset + 1);
+			if (!input.Source) continue;
+
+			if (input.Semantic == "VERTEX")
+			{
+				// <vertices><input semantic="POSITION" source="#..."/></vertices>
+				for (const PrimitiveInput& vertexInput : ReadInputs(input.Source, Index))
+				{
+					if (vertexInput.Semantic == "POSITION" && vertexInput.Source && positions.empty())
+						ReadFloatArray(vertexInput.Source, positions);
+				}
+				positionOffset = input.Offset;
+			}
+			else if (input.Semantic == "NORMAL")
+			{
+				if (normals.empty())
+				{
+					ReadFloatArray(input.Source, normals);
+					normalStride = GetSourceStride(input.Source);
+				}
+				normalOffset = input.Offset;
+			}
+			else if (input.Semantic == "TEXCOORD" && input.Set == 0)
+			{
+				if (texCoords.empty())
+				{
+					ReadFloatArray(input.Source, texCoords);
+					texCoordStride = GetSourceStride(input.Source);
+				}
+				texCoordOffset = input.Offset;
+			}
+		}
+		if (positionOffset < 0) continue;
+
+		std::vector<int> counts, p;
+		for (xmlNode* child = xmlFirstElementChild(primitive); child; child = xmlNextElementSibling(child))
+		{
+			if (std::strcmp((const char*)child->name, "vcount") == 0) ReadIntArray(child, counts);
+			else if (std::strcmp((const char*)child->name, "p") == 0) ReadIntArray(child, p);
+		}
+
+		const std::size_t positionCount = positions.size() / 3;
+		const std::size_t normalCount = normals.size() / normalStride;
+		const std::size_t texCoordCount = texCoords.size() / texCoordStride;
+		auto addVertex = [&](std::size_t corner) -> unsigned int {
+			const int* index = p.data() + corner * stride;
+			const int position = index[positionOffset];
+			const int normal = normalOffset >= 0 ? index[normalOffset] : -1;
+			const int texCoord = texCoordOffset >= 0 ? index[texCoordOffset] : -1;
+			const unsigned long long key = ((unsigned long long)position * (normalCount + 1) + (normal + 1)) * (texCoordCount + 1) + (texCoord + 1);
+
+			auto it = vertices.find(key);
+			if (it != vertices.end()) return it->second;
+
+			Vertex v{};
+			if (position >= 0 && (std::size_t)position < positionCount)
+				v.position = glm::vec3(positions[position * 3], positions[position * 3 + 1], positions[position * 3 + 2]);
+			if (normal >= 0 && (std::size_t)normal < normalCount)
+				v.normals = glm::vec3(normals[normal * normalStride], normals[normal * normalStride + 1], normals[normal * normalStride + 2]);
+			if (texCoord >= 0 && (std::size_t)texCoord < texCoordCount)
+				v.text_coords = glm::vec2(texCoords[texCoord * texCoordStride], texCoords[texCoord * texCoordStride + 1]);
+
+			const unsigned int vertex = (unsigned int)mesh.Vertices.size();
+			mesh.Vertices.push_back(v);
+			positionIndices.push_back(position);
+			vertices.emplace(key, vertex);
+			return vertex;
+		};
+
+		// polygons as triangle fans, <triangles> has no <vcount>
+		const std::size_t corners = p.size() / stride;
+		std::size_t first = 0;
+		for (std::size_t polygon = 0; first < corners; ++polygon)
+		{
+			const std::size_t count = triangles ? 3 : (polygon < counts.size() ? (std::size_t)counts[polygon] : 0);
+			if (count == 0 || first + count > corners) break;
+			for (std::size_t k = 2; k < count; ++k)
+			{
+				mesh.Indices.push_back(addVertex(first));
+				mesh.Indices.push_back(addVertex(first + k - 1));
+				mesh.Indices.push_back(addVertex(first + k));
+			}
+			first += count;
+		}
+	}
+	return !mesh.Indices.empty();
+}
+
+void ColladaParser::ParseVertexWeights(xmlNode* vertexWeights, const std::vector<int>& positionIndices, SkinnedMeshData& mesh)
+{
+	// <vertex_weights><input JOINT/><input WEIGHT/><vcount/><v/></vertex_weights>, one entry per position
+	std::vector<float> weights;
+	std::vector<int> counts, v;
+	int jointOffset = 0, weightOffset = 1, stride = 1;
+	if (vertexWeights)
+	{
+		for (const PrimitiveInput& input : ReadInputs(vertexWeights, Index))
+		{
+			stride = std::max(stride, input.Offset + 1);
+			if (input.Semantic == "JOINT") jointOffset = input.Offset;
+			else if (input.Semantic == "WEIGHT" && input.Source)
+			{
+				weightOffset = input.Offset;
+				ReadFloatArray(input.Source, weights);
+			}
+		}
+		for (xmlNode* child = xmlFirstElementChild(vertexWeights); child; child = xmlNextElementSibling(child))
+		{
+			if (std::strcmp((const char*)child->name, "vcount") == 0) ReadIntArray(child, counts);
+			else if (std::strcmp((const char*)child->name, "v") == 0) ReadIntArray(child, v);
+		}
+	}
+
+	// the four largest influences of every position
+	std::vector<glm::ivec4> positionJoints(counts.size(), glm::ivec4(0));
+	std::vector<glm::vec4> positionWeights(counts.size(), glm::vec4(0.0f));
+	std::vector<std::pair<float, int>> influences;
+	std::size_t next = 0;
+	for (std::size_t position = 0; position < counts.size(); ++position)
+	{
+		influences.clear();
+		for (int k = 0; k < counts[position] && (next + 1) * stride <= v.size(); ++k, ++next)
+		{
+			const int joint = v[next * stride + jointOffset];
+			const int weight = v[next * stride + weightOffset];
+			// joint -1 is the bind shape, it doesn't move the vertex
+			if (joint >= 0 && weight >= 0 && (std::size_t)weight < weights.size())
+				influences.emplace_back(weights[weight], joint);
+		}
+
+		const std::size_t used = std::min<std::size_t>(4, influences.size());
+		std::partial_sort(influences.begin(), influences.begin() + used, influences.end(),
+			[](const std::pair<float, int>& a, const std::pair<float, int>& b) { return a.first > b.first; });
+		float total = 0.0f;
+		for (std::size_t k = 0; k < used; ++k)
+			total += influences[k].first;
+
+		// a vertex without weights follows the first joint of the skin
+		if (total <= 0.0f)
+		{
+			positionWeights[position] = glm::vec4(1.0f, 0.0f, 0.0f, 0.0f);
+			continue;
+		}
+		for (std::size_t k = 0; k < used; ++k)
+		{
+			positionJoints[position][k] = influences[k].second;
+			positionWeights[position][k] = influences[k].first / total;
+		}
+	}
+
+	mesh.JointIndices.resize(positionIndices.size(), glm::ivec4(0));
+	mesh.JointWeights.resize(positionIndices.size(), glm::vec4(1.0f, 0.0f, 0.0f, 0.0f));
+	for (std::size_t vertex = 0; vertex < positionIndices.size(); ++vertex)
+	{
+		const int position = positionIndices[vertex];
+		if (position < 0 || (std::size_t)position >= counts.size()) continue;
+		mesh.JointIndices[vertex] = positionJoints[position];
+		mesh.JointWeights[vertex] = positionWeights[position];
+	}
+}
+
 void ColladaParser::GetJointIndices(std::unordered_map<std::string,int>& m)
 {
-	xmlNode* Ids = findByPorperty(LibraryControllers, "id",std::regex( "Armature\_[[:w:]]+\-skin\-joints\-array"));
+	xmlNode* Ids = FindJointNames();
 
-	assert(Ids && "Error parsing Joint Indices");
-	assert(Ids->last &&"Error parsin Joint Indices has no content");
+	// no skin joints, no joint is found and the skeleton is empty
+	if (!Ids || !Ids->last || !Ids->last->content) return;
 
 	std::string s = (const char*) Ids->last->content;
 
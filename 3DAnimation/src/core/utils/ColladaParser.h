@@ -14,6 +14,9 @@
 #include <glm/glm.hpp>
 #include <glm/gtx/transform.hpp>
 #include "app/JointAnimation.h"
+#include "app/ColladaAsset.h"
+#include "FloatScanner.h"
+#include "ColladaIndex.h"
 
 struct Joint;
 
@@ -29,6 +32,9 @@ class ColladaParser
 	Joint* SkeletonRoot;
 	std::vector<JointAnimation> Animation;
 	bool ApplyAxisCorrection;
+	std::string LoadedPath;
+	// id/sid/name lookups of the loaded document
+	ColladaIndex Index;
 
 public:
 
@@ -43,91 +49,63 @@ public:
 
 	~ColladaParser();
 
+	// nullptr when the file can't be read or has no skeleton
 	Joint* GetJointHerarchy(const char* path,bool ApplyAxisCorrection = false);
 	std::vector<JointAnimation> GetAnimation(const char* filepath);
 
+	// skeleton, skin and animation from a single parse of the file. An empty asset (no
+	// skeleton) when the file can't be read or has no skeleton
+	ColladaAsset Load(const char* path, bool applyAxisCorrection = false);
+	// add the animation of another file (only library_animations is read) as a new clip of asset
+	bool AttachAnimation(ColladaAsset& asset, const char* path);
+
 private:
 
 	Joint* ParseSkeleton(xmlNode* node, Joint* parent,const std::unordered_map<std::string,int>& indices);
 	void GetJointIndices(std::unordered_map<std::string, int>& m);
-	glm::mat4 CreateTransform(const std::vector<float>& matrixValues);
-	glm::mat4 GetTransformMatrix(std::string& content);
+	xmlNode* FindRootJoint(xmlNode* armature);
+	xmlNode* FindJointNames();
+	SkinData ParseSkin();
+	SkinData ParseSkin(xmlNode* skinNode);
+	// the geometry of every <controller> with its skin, in document order
+	std::vector<SkinnedMeshData> ParseSkinnedMeshes();
+	// triangles of geometry, positionIndices gets the <vertices> index of every vertex
+	bool ParseGeometry(xmlNode* geometry, SkinnedMeshData& mesh, std::vector<int>& positionIndices);
+	void ParseVertexWeights(xmlNode* vertexWeights, const std::vector<int>& positionIndices, SkinnedMeshData& mesh);
+	glm::mat4 CreateTransform(const float* matrixValues, std::size_t count);
+	glm::mat4 GetTransformMatrix(const char* content);
 	Joint* CreateJoint(xmlNode* node);
 	std::vector<JointAnimation> ParseAnimation(xmlNode* libraryAnimations, const std::unordered_map<std::string, int>& indices);
 	void FreeDocument();
-	void MapNameToId(Joint *root, std::unordered_map<std::string, int>& bonesMap, std::unordered_map<std::string, int>& remapIndices);
+	void MapChannelToId(Joint *root, std::unordered_map<std::string, int>& remapIndices);
+	static std::string GetClipName(const char* path);
 
 };
 
 
 
+// once per process, every ColladaParser and ColladaStreamReader calls it
+void InitXmlParser();
 std::string readFile(const char* filePath);
+std::size_t splitString(const std::string &txt, std::vector<std::string> &strs, char ch);
 
 
 template <typename T>
 inline std::vector<T> getArrayData(const std::string& title, const std::string& data)
 {
-	int start = data.find(title);
-
-	//read the desire row/line
-	std::string row{};
-	int startpoint = start + title.size();
-	while (data[startpoint] != '<')
-	{
-		row += data[startpoint];
-		++startpoint;
-	}
-	int arrayStart = row.find(">") +1;
-	row = row.substr(arrayStart);
-
-	auto splitString = [&](const std::string &txt, std::vector<std::string> &strs, char ch) -> std::size_t
-	{
-		size_t pos = txt.find(ch);
-		size_t initialPos = 0;
-		strs.clear();
-
-		// Decompose statement
-		while (pos != std::string::npos) {
-			strs.push_back(txt.substr(initialPos, pos - initialPos));
-			initialPos = pos + 1;
-			pos = txt.find(ch, initialPos);
-		}
-		// Add the last one
-		strs.push_back(txt.substr(initialPos, std::min(pos, txt.size()) - initialPos + 1));
-
-		return strs.size();
-	};
-
-	// get the floats in string format from the row
-	std::vector<std::string> num_str;
-	splitString(row, num_str, ' ');
-	if (num_str.back().empty())
-		num_str.pop_back();
-	
-	// cast strings to floats
-	std::vector<T> nums;
-	for (int i = 0; i < num_str.size(); ++i)
-	{
-		T f = ::atof(num_str[i].c_str());
-		nums.push_back(f);
-	}
-
-	return nums;
-}
+	std::size_t start = data.find(title);
+	if (start == std::string::npos) return {};
 
+	// the numbers go from the end of the opening tag to the next '<'
+	std::size_t arrayStart = data.find('>', start + title.size());
+	std::size_t arrayEnd = data.find('<', arrayStart);
+	if (arrayStart == std::string::npos || arrayEnd == std::string::npos) return {};
 
-template <typename T>
-inline std::vector<T> castStringstoType(const std::vector<std::string>& num_str)
-{
 	std::vector<T> nums;
-	for (int i = 0; i < num_str.size(); ++i)
-	{
-		T f = ::atof(num_str[i].c_str());
-		nums.push_back(f);
-	}
+	ScanNumbers(data.data() + arrayStart + 1, data.data() + arrayEnd, [&](double value) {
+		nums.push_back((T)value);
+	});
 	return nums;
 }
 
-
-
 #endif //COLLADA_PARSER_HPP
\ No newline at end of file
@@ -0,0 +1,462 @@
+#include "ColladaStreamReader.h"
+#include <iostream>
+#include <cstring>
+#include <climits>
+#include <algorithm>
+#include <glm/gtx/transform.hpp>
+#include "app/Joint.h"
+#include "ColladaParser.h"
+
+#define READ_COLLADA_ERR  "[Collada stream]: "
+#define VISUAL_SCENES "library_visual_scenes"
+#define CONTROLLERS "library_controllers"
+#define ANIMATIONS "library_animations"
+
+namespace
+{
+	bool IsWordChar(char c)
+	{
+		return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+	}
+
+	// same ids as ColladaParser::GetJointIndices: Armature_<word>-skin-joints-array
+	bool IsJointNamesId(const std::string& id)
+	{
+		static const std::string prefix = "Armature_";
+		static const std::string suffix = "-skin-joints-array";
+		if (id.size() <= prefix.size() + suffix.size()) return false;
+		if (id.compare(0, prefix.size(), prefix) != 0) return false;
+		if (id.compare(id.size() - suffix.size(), suffix.size(), suffix) != 0) return false;
+		return std::all_of(id.begin() + prefix.size(), id.end() - suffix.size(), IsWordChar);
+	}
+
+	std::size_t ReadCount(xmlTextReaderPtr reader)
+	{
+		xmlChar* count = xmlTextReaderGetAttribute(reader, (const xmlChar*)"count");
+		if (!count) return 0;
+		std::size_t value = std::strtoul((const char*)count, nullptr, 10);
+		xmlFree(count);
+		return value;
+	}
+}
+
+ColladaStreamReader::ColladaStreamReader()
+	: Reader{ nullptr }
+	, ApplyAxisCorrection{ false }
+	, SkeletonRoot{ nullptr }
+{
+	InitXmlParser();
+	Reset();
+}
+
+ColladaStreamReader::~ColladaStreamReader()
+{
+	if (Reader)
+		xmlFreeTextReader(Reader);
+}
+
+void ColladaStreamReader::Reset()
+{
+	Current = Section::None;
+	SectionDepth = -1;
+	FoundJointNames = false;
+	JointNames.clear();
+	FoundArmature = false;
+	InArmature = false;
+	ArmatureDepth = -1;
+	JointNodes.clear();
+	OpenJoints.clear();
+	RootJoint = -1;
+	FoundAnimations = false;
+	FirstChildDone = false;
+	InChannel = false;
+	ChannelDepth = -1;
+	CurrentChannel = ChannelNode{};
+	Channels.clear();
+	Capture = nullptr;
+	CaptureFloats = nullptr;
+	CaptureDepth = -1;
+	SkeletonRoot = nullptr;
+	Animation.clear();
+}
+
+bool ColladaStreamReader::Read(const char* path, bool applyAxisCorrection)
+{
+	Reset();
+	ApplyAxisCorrection = applyAxisCorrection;
+
+	Reader = xmlReaderForFile(path, NULL, XML_PARSE_NOBLANKS);
+	if (!Reader)
+	{
+		std::cerr << READ_COLLADA_ERR << "can't open " << path << std::endl;
+		return false;
+	}
+
+	int result = 0;
+	while ((result = xmlTextReaderRead(Reader)) == 1)
+	{
+		const int depth = xmlTextReaderDepth(Reader);
+		switch (xmlTextReaderNodeType(Reader))
+		{
+		case XML_READER_TYPE_ELEMENT:
+		{
+			const bool isEmpty = xmlTextReaderIsEmptyElement(Reader) == 1;
+			OnElement((const char*)xmlTextReaderConstLocalName(Reader), depth, isEmpty);
+			// empty elements don't get an end element
+			if (isEmpty)
+				OnEndElement(depth);
+			break;
+		}
+		case XML_READER_TYPE_END_ELEMENT:
+			OnEndElement(depth);
+			break;
+		case XML_READER_TYPE_TEXT:
+		case XML_READER_TYPE_CDATA:
+			if (Capture && depth > CaptureDepth)
+				Capture->append((const char*)xmlTextReaderConstValue(Reader));
+			else if (CaptureFloats && depth > CaptureDepth)
+				ScanFloats((const char*)xmlTextReaderConstValue(Reader), *CaptureFloats);
+			break;
+		default:
+			break;
+		}
+	}
+
+	xmlFreeTextReader(Reader);
+	Reader = nullptr;
+
+	if (result != 0)
+	{
+		std::cerr << READ_COLLADA_ERR << "error parsing " << path << std::endl;
+		return false;
+	}
+	if (!FoundJointNames || RootJoint < 0)
+	{
+		std::cerr << READ_COLLADA_ERR << "no skeleton in " << path << std::endl;
+		return false;
+	}
+
+	std::unordered_map<std::string, int> indices{};
+	std::vector<std::string> names{};
+	splitString(JointNames, names, ' ');
+	for (std::size_t i = 0; i < names.size(); ++i)
+		indices[names[i]] = (int)i;
+
+	SkeletonRoot = BuildSkeleton(RootJoint, nullptr, indices);
+	if (!SkeletonRoot)
+	{
+		std::cerr << READ_COLLADA_ERR << "root joint is not skinned in " << path << std::endl;
+		return false;
+	}
+	SkeletonRoot->CalculateInverseBindTransform(glm::mat4(1.0f));
+
+	if (FoundAnimations)
+		BuildAnimation(SkeletonRoot, indices);
+
+	JointNodes.clear();
+	Channels.clear();
+	return true;
+}
+
+void ColladaStreamReader::OnElement(const char* name, int depth, bool isEmpty)
+{
+	if (Current == Section::None)
+	{
+		// only the first library of each kind is read, like findNodeByName does
+		if (std::strcmp(name, CONTROLLERS) == 0 && !FoundJointNames)
+			Current = Section::Controllers;
+		else if (std::strcmp(name, VISUAL_SCENES) == 0 && !FoundArmature)
+			Current = Section::VisualScenes;
+		else if (std::strcmp(name, ANIMATIONS) == 0 && !FoundAnimations)
+		{
+			Current = Section::Animations;
+			FoundAnimations = true;
+		}
+
+		if (Current != Section::None)
+			SectionDepth = depth;
+		return;
+	}
+
+	switch (Current)
+	{
+	case Section::Controllers:
+	{
+		std::string id;
+		if (!FoundJointNames && GetAttribute("id", id) && IsJointNamesId(id))
+		{
+			FoundJointNames = true;
+			StartCapture(&JointNames, depth, isEmpty);
+		}
+		break;
+	}
+	case Section::VisualScenes:
+		OnVisualScenesElement(depth, isEmpty);
+		break;
+	case Section::Animations:
+		OnAnimationsElement(depth, isEmpty);
+		break;
+	default:
+		break;
+	}
+}
+
+void ColladaStreamReader::OnEndElement(int depth)
+{
+	if (depth == CaptureDepth)
+	{
+		Capture = nullptr;
+		CaptureFloats = nullptr;
+		CaptureDepth = -1;
+	}
+
+	switch (Current)
+	{
+	case Section::VisualScenes:
+		if (!OpenJoints.empty() && JointNodes[OpenJoints.back()].Depth == depth)
+			OpenJoints.pop_back();
+		if (InArmature && depth == ArmatureDepth)
+			InArmature = false;
+		break;
+	case Section::Animations:
+		if (InChannel && depth == ChannelDepth)
+		{
+			AddChannel();
+			InChannel = false;
+		}
+		if (depth == SectionDepth + 1)
+			FirstChildDone = true;
+		break;
+	default:
+		break;
+	}
+
+	if (depth == SectionDepth)
+	{
+		Current = Section::None;
+		SectionDepth = -1;
+	}
+}
+
+void ColladaStreamReader::OnVisualScenesElement(int depth, bool isEmpty)
+{
+	std::string value;
+	if (!FoundArmature && GetAttribute("id", value) && value == "Armature")
+	{
+		FoundArmature = true;
+		InArmature = !isEmpty;
+		ArmatureDepth = depth;
+	}
+
+	if (!InArmature) return;
+
+	if (GetAttribute("type", value) && value == "JOINT")
+	{
+		JointNode node{};
+		GetAttribute(0, node.Channel);
+		GetAttribute(2, node.Name);
+		node.Depth = depth;
+		node.TransformDepth = INT_MAX;
+
+		// children are the joints directly below another joint
+		const int index = (int)JointNodes.size();
+		if (!OpenJoints.empty() && JointNodes[OpenJoints.back()].Depth == depth - 1)
+			JointNodes[OpenJoints.back()].Children.push_back(index);
+		// the root is the shallowest joint of the armature
+		if (RootJoint < 0 || depth < JointNodes[RootJoint].Depth)
+			RootJoint = index;
+
+		JointNodes.push_back(std::move(node));
+		if (!isEmpty)
+			OpenJoints.push_back(index);
+	}
+	else if (!OpenJoints.empty() && GetAttribute("sid", value) && value == "transform")
+	{
+		// the transform of a joint is the shallowest sid="transform" below it
+		JointNode& joint = JointNodes[OpenJoints.back()];
+		if (depth < joint.TransformDepth)
+		{
+			joint.TransformDepth = depth;
+			joint.Transform.clear();
+			StartCapture(&joint.Transform, depth, isEmpty);
+		}
+	}
+}
+
+void ColladaStreamReader::OnAnimationsElement(int depth, bool isEmpty)
+{
+	// In blender you can assign your animations inside actions. If the first child is an
+	// action container the bone animations are its children, if not they are the children
+	// of library_animations
+	if (ChannelDepth < 0 && depth == SectionDepth + 1)
+	{
+		std::string id;
+		GetAttribute("id", id);
+		ChannelDepth = id.find("action") == std::string::npos ? depth : depth + 1;
+	}
+
+	const bool isContainerChild = ChannelDepth == SectionDepth + 1 || !FirstChildDone;
+	if (depth == ChannelDepth && isContainerChild)
+	{
+		InChannel = true;
+		CurrentChannel = ChannelNode{};
+		return;
+	}
+
+	if (InChannel && depth == ChannelDepth + 1)
+	{
+		const int child = CurrentChannel.ChildCount++;
+		// the target of the last child (the channel) is the one that counts
+		CurrentChannel.Target.clear();
+		CurrentChannel.HasTarget = GetAttribute("target", CurrentChannel.Target);
+
+		if (child == 0)
+			StartCapture(&CurrentChannel.Input, depth, isEmpty);
+		else if (child == 1)
+			StartCapture(&CurrentChannel.Output, depth, isEmpty);
+	}
+	else if (CaptureFloats && !isEmpty)
+	{
+		// <float_array count=""> inside the source, reserve once
+		CaptureFloats->reserve(ReadCount(Reader));
+	}
+}
+
+void ColladaStreamReader::StartCapture(std::string* target, int depth, bool isEmpty)
+{
+	if (isEmpty) return;
+	Capture = target;
+	CaptureDepth = depth;
+}
+
+void ColladaStreamReader::StartCapture(std::vector<float>* target, int depth, bool isEmpty)
+{
+	if (isEmpty) return;
+	CaptureFloats = target;
+	CaptureDepth = depth;
+}
+
+bool ColladaStreamReader::GetAttribute(const char* name, std::string& value)
+{
+	if (xmlTextReaderMoveToAttribute(Reader, (const xmlChar*)name) != 1)
+		return false;
+	const xmlChar* content = xmlTextReaderConstValue(Reader);
+	value.assign(content ? (const char*)content : "");
+	xmlTextReaderMoveToElement(Reader);
+	return true;
+}
+
+bool ColladaStreamReader::GetAttribute(int index, std::string& value)
+{
+	if (xmlTextReaderMoveToAttributeNo(Reader, index) != 1)
+		return false;
+	const xmlChar* content = xmlTextReaderConstValue(Reader);
+	value.assign(content ? (const char*)content : "");
+	xmlTextReaderMoveToElement(Reader);
+	return true;
+}
+
+void ColladaStreamReader::AddChannel()
+{
+	ChannelNode& channel = CurrentChannel;
+	if (channel.ChildCount < 2 || !channel.HasTarget) return;
+
+	const std::vector<float>& keyframes = channel.Input;
+	const std::vector<float>& transformNumbers = channel.Output;
+
+	std::vector<KeyFrame> frames;
+	frames.reserve(transformNumbers.size() / 16);
+	for (std::size_t start = 0, i = 0; start + 16 <= transformNumbers.size() && i < keyframes.size(); start += 16, ++i)
+	{
+		KeyFrame k;
+		k.TimeStamp = keyframes[i];
+		k.SetTransform(CreateTransform(transformNumbers, start));
+		frames.push_back(k);
+	}
+
+	std::vector<std::string> targetBoneStrings;
+	splitString(channel.Target, targetBoneStrings, '/');
+	Channels.emplace_back(targetBoneStrings.front(), std::move(frames));
+
+	// release the arrays, the next bone doesn't need them
+	std::vector<float>().swap(channel.Input);
+	std::vector<float>().swap(channel.Output);
+}
+
+glm::mat4 ColladaStreamReader::CreateTransform(const std::vector<float>& values, std::size_t offset) const
+{
+	glm::mat4 m{};
+	for (int c = 0; c < 4; ++c)
+	{
+		for (int r = 0; r < 4; ++r)
+		{
+			m[c][r] = values[offset++];
+		}
+	}
+	return glm::transpose(m);
+}
+
+Joint* ColladaStreamReader::BuildSkeleton(int node, Joint* parent, const std::unordered_map<std::string, int>& indices)
+{
+	const JointNode& source = JointNodes[node];
+	if (indices.find(source.Name) == indices.end()) return parent;
+
+	Joint* j = new Joint;
+	j->Name = source.Name;
+	j->Channel = source.Channel;
+	j->ID = indices.at(j->Name);
+
+	// It must have a transform, if not something went terrible wrong
+	assert(!source.Transform.empty());
+	std::vector<float> values;
+	ScanFloats(source.Transform.c_str(), values);
+	if (values.size() >= 16)
+	{
+		j->localBindTransform = CreateTransform(values, values.size() - values.size() % 16 - 16);
+		// apply z correction of 90 degrees around x axis, only to the root. Blender has Z axis Up
+		if (!parent && ApplyAxisCorrection)
+			j->localBindTransform = glm::rotate(j->localBindTransform, glm::radians(-90.0f), glm::vec3(1, 0, 0));
+	}
+
+	if (parent)
+		parent->Children.push_back(j);
+	else
+		parent = j;
+
+	for (int child : source.Children)
+		BuildSkeleton(child, j, indices);
+
+	return parent;
+}
+
+void ColladaStreamReader::MapNameToId(Joint* root, const std::unordered_map<std::string, int>& indices, std::unordered_map<std::string, int>& remapIndices)
+{
+	remapIndices[root->Channel] = indices.at(root->Name);
+
+	for (Joint* child : root->Children)
+		MapNameToId(child, indices, remapIndices);
+}
+
+void ColladaStreamReader::BuildAnimation(Joint* root, const std::unordered_map<std::string, int>& indices)
+{
+	std::unordered_map<std::string, int> remapIndices;
+	MapNameToId(root, indices, remapIndices);
+
+	std::size_t size = remapIndices.size();
+	for (auto& j : remapIndices)
+		size = std::max(size, (std::size_t)j.second + 1);
+
+	Animation.assign(size, JointAnimation{});
+	for (auto& j : remapIndices)
+		Animation[j.second].jointName = j.first;
+
+	for (auto& channel : Channels)
+	{
+		auto it = std::find_if(Animation.begin(), Animation.end(), [&](const JointAnimation& joint) {
+			return joint.jointName == channel.first;
+			});
+
+		if (it != Animation.end())
+			it->Frames = std::move(channel.second);
+	}
+}
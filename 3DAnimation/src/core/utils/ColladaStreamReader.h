@@ -0,0 +1,105 @@
+#pragma once
+
+#ifndef COLLADA_STREAM_READER_HPP
+#define COLLADA_STREAM_READER_HPP
+#include <string>
+#include <vector>
+#include <utility>
+#include <unordered_map>
+#include <libxml/xmlreader.h>
+#include <glm/glm.hpp>
+#include "app/JointAnimation.h"
+
+struct Joint;
+
+// Reads the skeleton and the animation of a collada file in a single forward pass with
+// xmlTextReader. The document tree is never built: only the joint nodes and the float
+// arrays of the bone being read are kept in memory, numbers are scanned as the text arrives.
+// Produces the same Joint tree and JointAnimation vector as
+// ColladaParser::GetJointHerarchy + ColladaParser::GetAnimation.
+class ColladaStreamReader
+{
+	enum class Section { None, Controllers, VisualScenes, Animations };
+
+	// joint node of library_visual_scenes, converted to Joint once the whole file is read
+	struct JointNode
+	{
+		std::string Name;
+		std::string Channel;
+		std::string Transform;
+		int TransformDepth;
+		int Depth;
+		std::vector<int> Children;
+	};
+
+	// <animation> node of one bone: times in the first child, matrices in the second
+	// and the target bone in the last one (the channel)
+	struct ChannelNode
+	{
+		int ChildCount;
+		bool HasTarget;
+		std::string Target;
+		std::vector<float> Input;
+		std::vector<float> Output;
+	};
+
+	xmlTextReaderPtr Reader;
+	bool ApplyAxisCorrection;
+	Section Current;
+	int SectionDepth;
+
+	// library_controllers
+	bool FoundJointNames;
+	std::string JointNames;
+	// library_visual_scenes
+	bool FoundArmature;
+	bool InArmature;
+	int ArmatureDepth;
+	std::vector<JointNode> JointNodes;
+	std::vector<int> OpenJoints;
+	int RootJoint;
+	// library_animations
+	bool FoundAnimations;
+	bool FirstChildDone;
+	bool InChannel;
+	int ChannelDepth;
+	ChannelNode CurrentChannel;
+	std::vector<std::pair<std::string, std::vector<KeyFrame>>> Channels;
+	// text content of the element being captured, appended (or scanned) until its end element
+	std::string* Capture;
+	std::vector<float>* CaptureFloats;
+	int CaptureDepth;
+
+	Joint* SkeletonRoot;
+	std::vector<JointAnimation> Animation;
+
+public:
+	ColladaStreamReader();
+	ColladaStreamReader(const ColladaStreamReader&) = delete;
+	ColladaStreamReader& operator=(const ColladaStreamReader&) = delete;
+	~ColladaStreamReader();
+
+	bool Read(const char* path, bool applyAxisCorrection = false);
+	// the caller owns the returned tree, as with ColladaParser
+	Joint* GetJointHerarchy() const { return SkeletonRoot; }
+	const std::vector<JointAnimation>& GetAnimation() const { return Animation; }
+
+private:
+	void Reset();
+	void OnElement(const char* name, int depth, bool isEmpty);
+	void OnEndElement(int depth);
+	void OnVisualScenesElement(int depth, bool isEmpty);
+	void OnAnimationsElement(int depth, bool isEmpty);
+	void StartCapture(std::string* target, int depth, bool isEmpty);
+	void StartCapture(std::vector<float>* target, int depth, bool isEmpty);
+	bool GetAttribute(const char* name, std::string& value);
+	bool GetAttribute(int index, std::string& value);
+
+	Joint* BuildSkeleton(int node, Joint* parent, const std::unordered_map<std::string, int>& indices);
+	void BuildAnimation(Joint* root, const std::unordered_map<std::string, int>& indices);
+	void MapNameToId(Joint* root, const std::unordered_map<std::string, int>& indices, std::unordered_map<std::string, int>& remapIndices);
+	void AddChannel();
+	glm::mat4 CreateTransform(const std::vector<float>& values, std::size_t offset) const;
+};
+
+#endif //COLLADA_STREAM_READER_HPP
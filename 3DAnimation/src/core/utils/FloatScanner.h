@@ -0,0 +1,143 @@
+#pragma once
+
+#ifndef FLOAT_SCANNER_HPP
+#define FLOAT_SCANNER_HPP
+#include <cstdint>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+// Single pass scanner for the whitespace separated numbers of collada arrays
+// (<float_array>, <matrix>, <p>, <vcount>...). It reads straight from the text buffer,
+// no std::string per number. Values are the same atof would return: numbers with up to
+// 15 significant digits and a small exponent are computed exactly in double, anything
+// else goes through strtod.
+
+inline bool IsScannerSpace(char c)
+{
+	return c == ' ' || c == '\n' || c == '\t' || c == '\r' || c == '\f' || c == '\v';
+}
+
+// parse the number at [p, end) and advance p to the character after it.
+// invalid tokens are read as 0, like atof does
+inline double ScanNumber(const char*& p, const char* end)
+{
+	static const double powersOf10[] = {
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+
+	const char* start = p;
+	bool negative = false;
+	if (p < end && (*p == '-' || *p == '+'))
+	{
+		negative = *p == '-';
+		++p;
+	}
+
+	uint64_t mantissa = 0;
+	int digits = 0;
+	int exponent = 0;
+	bool anyDigit = false;
+
+	while (p < end && *p == '0') { ++p; anyDigit = true; }
+	while (p < end && *p >= '0' && *p <= '9')
+	{
+		if (digits < 19) mantissa = mantissa * 10 + (*p - '0');
+		else ++exponent;
+		++digits; ++p; anyDigit = true;
+	}
+	if (p < end && *p == '.')
+	{
+		++p;
+		if (digits == 0)
+			while (p < end && *p == '0') { ++p; --exponent; anyDigit = true; }
+		while (p < end && *p >= '0' && *p <= '9')
+		{
+			if (digits < 19) { mantissa = mantissa * 10 + (*p - '0'); --exponent; }
+			++digits; ++p; anyDigit = true;
+		}
+	}
+	if (anyDigit && p < end && (*p == 'e' || *p == 'E'))
+	{
+		const char* e = p + 1;
+		bool negativeExponent = false;
+		if (e < end && (*e == '-' || *e == '+'))
+		{
+			negativeExponent = *e == '-';
+			++e;
+		}
+		if (e < end && *e >= '0' && *e <= '9')
+		{
+			int value = 0;
+			while (e < end && *e >= '0' && *e <= '9')
+			{
+				if (value < 100000) value = value * 10 + (*e - '0');
+				++e;
+			}
+			exponent += negativeExponent ? -value : value;
+			p = e;
+		}
+	}
+
+	const bool isSeparated = p == end || IsScannerSpace(*p);
+	if (anyDigit && isSeparated && digits <= 15 && exponent >= -22 && exponent <= 22)
+	{
+		// exact: the mantissa fits in 53 bits and the power of 10 is exact in double
+		double value = (double)mantissa;
+		value = exponent < 0 ? value / powersOf10[-exponent] : value * powersOf10[exponent];
+		return negative ? -value : value;
+	}
+
+	// slow path: long mantissas, big exponents, inf/nan or garbage
+	while (p < end && !IsScannerSpace(*p)) ++p;
+	char token[64];
+	std::size_t length = (std::size_t)(p - start);
+	if (length >= sizeof(token)) length = sizeof(token) - 1;
+	std::memcpy(token, start, length);
+	token[length] = '\0';
+	return std::strtod(token, nullptr);
+}
+
+// call onNumber(double) for every number in [begin, end), returns how many were found
+template <typename F>
+inline std::size_t ScanNumbers(const char* begin, const char* end, F&& onNumber)
+{
+	std::size_t count = 0;
+	const char* p = begin;
+	while (true)
+	{
+		while (p < end && IsScannerSpace(*p)) ++p;
+		if (p >= end) break;
+		onNumber(ScanNumber(p, end));
+		++count;
+	}
+	return count;
+}
+
+// append the numbers of text to out
+inline std::size_t ScanFloats(const char* begin, const char* end, std::vector<float>& out)
+{
+	return ScanNumbers(begin, end, [&](double value) { out.push_back((float)value); });
+}
+
+inline std::size_t ScanFloats(const char* text, std::vector<float>& out)
+{
+	return text ? ScanFloats(text, text + std::strlen(text), out) : 0;
+}
+
+// write up to capacity numbers to a caller provided buffer, returns how many were written
+inline std::size_t ScanFloats(const char* begin, const char* end, float* out, std::size_t capacity)
+{
+	std::size_t written = 0;
+	const char* p = begin;
+	while (written < capacity)
+	{
+		while (p < end && IsScannerSpace(*p)) ++p;
+		if (p >= end) break;
+		out[written++] = (float)ScanNumber(p, end);
+	}
+	return written;
+}
+
+#endif //FLOAT_SCANNER_HPP
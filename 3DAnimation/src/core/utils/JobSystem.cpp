@@ -0,0 +1,142 @@
+#include "JobSystem.h"
+#include <algorithm>
+#include <exception>
+
+JobSystem::JobSystem(unsigned threadCount)
+	: Pending{ 0 }
+	, NextQueue{ 0 }
+	, Stopping{ false }
+{
+	if (threadCount == 0)
+		threadCount = std::thread::hardware_concurrency();
+	if (threadCount == 0)
+		threadCount = 1;
+
+	for (unsigned i = 0; i < threadCount; ++i)
+		Queues.emplace_back(new WorkerQueue);
+
+	Workers.reserve(threadCount);
+	for (unsigned i = 0; i < threadCount; ++i)
+		Workers.emplace_back(&JobSystem::WorkerLoop, this, i);
+}
+
+JobSystem::~JobSystem()
+{
+	{
+		std::lock_guard<std::mutex> lock(SleepMutex);
+		Stopping = true;
+	}
+	Wake.notify_all();
+
+	for (std::thread& worker : Workers)
+		worker.join();
+}
+
+void JobSystem::Push(std::function<void()> job, unsigned queue)
+{
+	{
+		std::lock_guard<std::mutex> lock(Queues[queue]->Mutex);
+		Queues[queue]->Jobs.push_back(std::move(job));
+	}
+	++Pending;
+
+	// taking the lock makes sure a worker checking Pending is either before the check or waiting
+	{
+		std::lock_guard<std::mutex> lock(SleepMutex);
+	}
+	Wake.notify_one();
+}
+
+bool JobSystem::RunOne(unsigned queue)
+{
+	std::function<void()> job;
+	const unsigned count = (unsigned)Queues.size();
+
+	for (unsigned i = 0; i < count && !job; ++i)
+	{
+		WorkerQueue& q = *Queues[(queue + i) % count];
+		std::lock_guard<std::mutex> lock(q.Mutex);
+		if (q.Jobs.empty()) continue;
+
+		// own queue from the back (the newest job, still in cache), the others from the front
+		if (i == 0)
+		{
+			job = std::move(q.Jobs.back());
+			q.Jobs.pop_back();
+		}
+		else
+		{
+			job = std::move(q.Jobs.front());
+			q.Jobs.pop_front();
+		}
+	}
+
+	if (!job) return false;
+
+	--Pending;
+	job();
+	return true;
+}
+
+void JobSystem::WorkerLoop(unsigned index)
+{
+	for (;;)
+	{
+		if (RunOne(index)) continue;
+
+		std::unique_lock<std::mutex> lock(SleepMutex);
+		Wake.wait(lock, [this]() { return Stopping || Pending > 0; });
+
+		// finish the queues before leaving so no future is left without a value
+		if (Stopping && Pending == 0) return;
+	}
+}
+
+void JobSystem::ParallelFor(std::size_t count, std::size_t chunkSize, const std::function<void(std::size_t, std::size_t)>& body)
+{
+	if (count == 0) return;
+	if (chunkSize == 0) chunkSize = 1;
+
+	const std::size_t chunks = (count + chunkSize - 1) / chunkSize;
+	std::atomic<std::size_t> remaining{ chunks };
+	// the first exception of a chunk, rethrown once every chunk is done. The chunks not started
+	// yet are skipped
+	std::exception_ptr error;
+	std::atomic<bool> failed{ false };
+	std::mutex errorMutex;
+
+	// consecutive chunks go to the same worker, the first chunks to the first worker...
+	for (std::size_t c = 0; c < chunks; ++c)
+	{
+		const std::size_t begin = c * chunkSize;
+		const std::size_t end = std::min(begin + chunkSize, count);
+		const unsigned queue = (unsigned)(c * Queues.size() / chunks);
+
+		Push([&body, &remaining, &error, &failed, &errorMutex, begin, end]() {
+			try
+			{
+				if (!failed)
+					body(begin, end);
+			}
+			catch (...)
+			{
+				std::lock_guard<std::mutex> lock(errorMutex);
+				if (!error)
+					error = std::current_exception();
+				failed = true;
+			}
+			--remaining;
+		}, queue);
+	}
+
+	// help until the last chunk is finished, remaining and body live in this frame
+	unsigned queue = NextQueue++ % Queues.size();
+	while (remaining > 0)
+	{
+		if (!RunOne(queue))
+			std::this_thread::yield();
+	}
+
+	if (error)
+		std::rethrow_exception(error);
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#ifndef JOB_SYSTEM_HPP
+#define JOB_SYSTEM_HPP
+#include <deque>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <future>
+#include <functional>
+#include <type_traits>
+#include <condition_variable>
+
+// Pool of worker threads, every worker has its own queue of jobs. A worker takes the newest
+// job of its queue and when it is empty steals the oldest one of another worker, so work
+// balances itself when some jobs are longer than others.
+// Submit returns a future with the result (or the exception) of the job.
+// The destructor runs the jobs still queued and joins the workers.
+class JobSystem
+{
+	struct WorkerQueue
+	{
+		std::mutex Mutex;
+		std::deque<std::function<void()>> Jobs;
+	};
+
+	std::vector<std::thread> Workers;
+	std::vector<std::unique_ptr<WorkerQueue>> Queues;
+	// jobs pushed and not taken yet, the workers sleep while it is 0
+	std::atomic<std::size_t> Pending;
+	std::atomic<unsigned> NextQueue;
+	std::mutex SleepMutex;
+	std::condition_variable Wake;
+	bool Stopping;
+
+public:
+	// 0 threads uses one per hardware thread
+	explicit JobSystem(unsigned threadCount = 0);
+	~JobSystem();
+	JobSystem(const JobSystem&) = delete;
+	JobSystem& operator=(const JobSystem&) = delete;
+
+	template <typename F>
+	std::future<typename std::result_of<F()>::type> Submit(F job);
+
+	// body(begin, end) over [0, count) in chunks of chunkSize. The chunks are spread over the
+	// worker queues in order and the calling thread runs (or steals) chunks too until all are
+	// done, so it can be called from a job as well. An exception of body is rethrown here once no
+	// chunk is running, the chunks not started by then are skipped
+	void ParallelFor(std::size_t count, std::size_t chunkSize, const std::function<void(std::size_t, std::size_t)>& body);
+
+	std::size_t GetThreadCount() const { return Workers.size(); }
+
+private:
+	void Push(std::function<void()> job, unsigned queue);
+	// run one job of queue, or steal one from the others. false if every queue was empty
+	bool RunOne(unsigned queue);
+	void WorkerLoop(unsigned index);
+};
+
+template <typename F>
+inline std::future<typename std::result_of<F()>::type> JobSystem::Submit(F job)
+{
+	typedef typename std::result_of<F()>::type Result;
+
+	// std::function has to be copyable, the task is shared with it
+	auto task = std::make_shared<std::packaged_task<Result()>>(std::move(job));
+	std::future<Result> result = task->get_future();
+	Push([task]() { (*task)(); }, NextQueue++ % Queues.size());
+	return result;
+}
+
+#endif //JOB_SYSTEM_HPP
@@ -0,0 +1,152 @@
+#include "AnimationBlender.h"
+#include <cmath>
+#include <algorithm>
+#include "AnimationSampling.h"
+
+AnimationBlender::AnimationBlender(const Skeleton& skeleton)
+	: Bones{ skeleton }
+	, BindPose(skeleton.GetJointCount())
+	, CurrentPosTransform(skeleton.LocalBindTransforms)
+{
+	for (std::size_t i = 0; i < Bones.GetJointCount(); ++i)
+		BindPose[i].SetTransform(Bones.LocalBindTransforms[i]);
+}
+
+int AnimationBlender::AddClip(const std::vector<JointAnimation>& animation)
+{
+	ClipState clip;
+	clip.Animation = animation;
+	clip.JointChannels = BindChannelsToJoints(Bones, clip.Animation, "[AnimationBlender]: ");
+	clip.Cursors.assign(Bones.GetJointCount(), 0);
+	clip.Duration = ComputeAnimationDuration(clip.Animation);
+	clip.Time = 0.0f;
+	clip.Speed = 1.0f;
+	clip.Weight = 0.0f;
+	clip.TargetWeight = 0.0f;
+	clip.FadeRate = 0.0f;
+	Clips.push_back(std::move(clip));
+	return (int)Clips.size() - 1;
+}
+
+void AnimationBlender::SetWeight(int clip, float weight)
+{
+	Clips[clip].Weight = weight;
+	Clips[clip].TargetWeight = weight;
+	Clips[clip].FadeRate = 0.0f;
+}
+
+void AnimationBlender::FadeTo(int clip, float weight, float duration)
+{
+	if (duration <= 0.0f)
+	{
+		SetWeight(clip, weight);
+		return;
+	}
+	Clips[clip].TargetWeight = weight;
+	Clips[clip].FadeRate = std::abs(weight - Clips[clip].Weight) / duration;
+}
+
+void AnimationBlender::CrossFade(int clip, float duration)
+{
+	for (int c = 0; c < (int)Clips.size(); ++c)
+		FadeTo(c, c == clip ? 1.0f : 0.0f, duration);
+}
+
+void AnimationBlender::SetTime(int clip, float time)
+{
+	Clips[clip].Time = time;
+}
+
+void AnimationBlender::SetSpeed(int clip, float speed)
+{
+	Clips[clip].Speed = speed;
+}
+
+void AnimationBlender::Update(float dt)
+{
+	float totalWeight = 0.0f;
+	int weighted = 0;
+	for (ClipState& clip : Clips)
+	{
+		if (clip.Weight != clip.TargetWeight)
+		{
+			const float step = clip.FadeRate * dt;
+			if (std::abs(clip.TargetWeight - clip.Weight) <= step)
+				clip.Weight = clip.TargetWeight;
+			else
+				clip.Weight += clip.TargetWeight > clip.Weight ? step : -step;
+		}
+		if (clip.Weight > 0.0f)
+		{
+			totalWeight += clip.Weight;
+			++weighted;
+		}
+	}
+
+	if (totalWeight <= 0.0f)
+	{
+		std::copy(Bones.LocalBindTransforms.begin(), Bones.LocalBindTransforms.end(), CurrentPosTransform.begin());
+		return;
+	}
+
+	// only the clips that are heard play, a clip faded out stays where it stopped
+	for (ClipState& clip : Clips)
+	{
+		if (clip.Weight <= 0.0f) continue;
+		clip.Time += dt * clip.Speed;
+		if (clip.Duration > 0.0f)
+		{
+			clip.Time = std::fmod(clip.Time, clip.Duration);
+			if (clip.Time < 0.0f) clip.Time += clip.Duration;
+		}
+	}
+
+	// a block of joints at a time: every clip adds its interpolated keys to the sum, which the
+	// kernels normalize into matrices
+	PoseBatch batch, sum;
+	const std::size_t jointCount = Bones.GetJointCount();
+	for (std::size_t begin = 0; begin < jointCount; begin += PoseBatch::Capacity)
+	{
+		const std::size_t end = std::min(jointCount, begin + PoseBatch::Capacity);
+		bool first = true;
+		for (ClipState& clip : Clips)
+		{
+			if (clip.Weight <= 0.0f) continue;
+			GatherClip(clip, begin, end, batch);
+			// a clip on its own is its pose, whatever its weight
+			if (weighted == 1)
+			{
+				BlendPoseBatch(batch, CurrentPosTransform.data());
+				break;
+			}
+			AccumulatePoseBatch(batch, clip.Weight / totalWeight, first, sum);
+			first = false;
+		}
+		if (weighted > 1)
+			BlendPoseBatch(sum, CurrentPosTransform.data());
+	}
+}
+
+void AnimationBlender::GatherClip(ClipState& clip, std::size_t begin, std::size_t end, PoseBatch& batch)
+{
+	batch.Count = 0;
+	for (std::size_t i = begin; i < end; ++i)
+	{
+		const int channel = clip.JointChannels[i];
+		if (channel < 0 || clip.Animation[channel].Frames.empty())
+		{
+			batch.Add(BindPose[i], BindPose[i], 0.0f, (int)i);
+			continue;
+		}
+
+		const KeyFrameSample keys = SampleKeys(clip.Animation[channel].Frames, clip.Cursors[i], clip.Time);
+		batch.Add(*keys.Previous, *keys.Next, keys.Progression, (int)i);
+	}
+}
+
+std::size_t AnimationBlender::GetGlobalTransforms(glm::mat4* out, std::size_t count, const glm::mat4& rootTransform) const
+{
+	if (count < Bones.GetJointCount()) return 0;
+	Bones.ComputeGlobalTransforms(CurrentPosTransform.data(), out, rootTransform);
+	return Bones.GetJointCount();
+}
@@ -0,0 +1,72 @@
+#pragma once
+#include <vector>
+#include <cstddef>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include "../app/Skeleton.h"
+#include "../app/JointAnimation.h"
+#include "PoseKernels.h"
+
+// Plays several clips of one skeleton at the same time and blends them by weight, with timed
+// crossfades. Every clip with weight is sampled into a local translation, rotation and scale
+// per joint and added to the pose with its weight (divided by the sum of the weights). The
+// blended pose becomes matrices once, so the hierarchy (Skeleton::ComputeGlobalTransforms)
+// runs once whatever the number of clips.
+// Update doesn't allocate, everything is sized when the clips are added.
+class AnimationBlender
+{
+	struct ClipState
+	{
+		std::vector<JointAnimation> Animation;
+		// channel of every joint of the skeleton, -1 if it has none
+		std::vector<int> JointChannels;
+		// one per joint, like Animator
+		std::vector<std::size_t> Cursors;
+		float Duration;
+		float Time;
+		float Speed;
+		float Weight;
+		// the weight moves to TargetWeight by FadeRate per second
+		float TargetWeight;
+		float FadeRate;
+	};
+
+	Skeleton Bones;
+	std::vector<ClipState> Clips;
+	// bind pose decomposed, the joints a clip doesn't animate keep it
+	std::vector<KeyFrame> BindPose;
+	// local transforms of the blended pose
+	std::vector<glm::mat4> CurrentPosTransform;
+
+public:
+	explicit AnimationBlender(const Skeleton& skeleton);
+
+	// the clip starts with weight 0, returns its index
+	int AddClip(const std::vector<JointAnimation>& animation);
+
+	// weight right away, stops a fade of the clip
+	void SetWeight(int clip, float weight);
+	// linear fade from the current weight to weight in duration seconds
+	void FadeTo(int clip, float weight, float duration);
+	// fades clip in to weight 1 and every other clip out in duration seconds
+	void CrossFade(int clip, float duration);
+	void SetTime(int clip, float time);
+	void SetSpeed(int clip, float speed);
+
+	// advances the fades and the clips with weight, then blends them
+	void Update(float dt);
+
+	float GetWeight(int clip) const { return Clips[clip].Weight; }
+	float GetTime(int clip) const { return Clips[clip].Time; }
+	std::size_t GetClipCount() const { return Clips.size(); }
+	const Skeleton& GetSkeleton() const { return Bones; }
+
+	// local transforms in skeleton order, valid until the next Update
+	const std::vector<glm::mat4>& GetBoneTransforms() const { return CurrentPosTransform; }
+	// model space transforms, same as Animator::GetGlobalTransforms
+	std::size_t GetGlobalTransforms(glm::mat4* out, std::size_t count, const glm::mat4& rootTransform = glm::mat4(1.0f)) const;
+
+private:
+	// the keys around the time of clip for the joints [begin, end), bind pose where it has none
+	void GatherClip(ClipState& clip, std::size_t begin, std::size_t end, PoseBatch& batch);
+};
@@ -0,0 +1,89 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <cstddef>
+#include "../app/Skeleton.h"
+
+// Level of detail of the animation update. The characters far from the camera evaluate their
+// pose every few frames, showing the interpolation of the last two evaluated local poses in
+// between (the hierarchy still runs every frame), and can hold the small joints at the ends
+// of the skeleton (fingers, toes) in the bind pose.
+
+struct AnimationLodLevel
+{
+	// the level is used from this distance to the camera on, in world units
+	float Distance = 0.0f;
+	// the pose is evaluated once every UpdateInterval frames, 1 is every frame
+	int UpdateInterval = 1;
+	// the joints of AnimationLodPolicy::DetailJoints keep the bind pose
+	bool SkipDetailJoints = false;
+};
+
+struct AnimationLodPolicy
+{
+	// sorted by Distance. Empty turns the level of detail off
+	std::vector<AnimationLodLevel> Levels;
+	// a joint whose name contains one of these is a detail joint, and so are its children.
+	// Not leaves of the skeleton: the parser drops the *_End joints, which leaves the head
+	// at the end of its chain like a finger tip
+	std::vector<std::string> DetailJoints{ "HandThumb", "HandIndex", "HandMiddle", "HandRing", "HandPinky", "Toe" };
+
+	// index of the level for distance, -1 if there is none
+	int SelectLevel(float distance) const
+	{
+		int level = -1;
+		for (std::size_t i = 0; i < Levels.size() && Levels[i].Distance <= distance; ++i)
+			level = (int)i;
+		return level;
+	}
+};
+
+// bone evaluations (joints sampled from their clip: cursor, key frames and their interpolation)
+// with and without level of detail
+struct AnimationLodStats
+{
+	std::size_t EvaluatedBones = 0;
+	// the joints a full update would have sampled and weren't: every joint on the frames between
+	// two evaluations and the joints held in the bind pose. Only the sampling is saved, the
+	// joints that move are still blended (InterpolatedBones) and the hierarchy still runs
+	std::size_t SavedBones = 0;
+	// joints blended between the last two evaluated poses on the frames between two evaluations
+	std::size_t InterpolatedBones = 0;
+	std::size_t EvaluatedInstances = 0;
+	// instances shown as the interpolation of their last two poses
+	std::size_t InterpolatedInstances = 0;
+
+	void Add(const AnimationLodStats& other)
+	{
+		EvaluatedBones += other.EvaluatedBones;
+		SavedBones += other.SavedBones;
+		InterpolatedBones += other.InterpolatedBones;
+		EvaluatedInstances += other.EvaluatedInstances;
+		InterpolatedInstances += other.InterpolatedInstances;
+	}
+};
+
+// 1 for the detail joints of policy, in skeleton order
+inline std::vector<unsigned char> ComputeDetailJointMask(const Skeleton& skeleton, const AnimationLodPolicy& policy)
+{
+	std::vector<unsigned char> mask(skeleton.GetJointCount(), 0);
+	for (std::size_t i = 0; i < skeleton.GetJointCount(); ++i)
+	{
+		// the parent is before the joint
+		const int parent = skeleton.Parents[i];
+		if (parent >= 0 && mask[parent])
+		{
+			mask[i] = 1;
+			continue;
+		}
+		for (const std::string& name : policy.DetailJoints)
+		{
+			if (skeleton.Names[i].find(name) != std::string::npos)
+			{
+				mask[i] = 1;
+				break;
+			}
+		}
+	}
+	return mask;
+}
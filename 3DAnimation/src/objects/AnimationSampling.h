@@ -0,0 +1,187 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <iostream>
+#include <algorithm>
+#include <unordered_map>
+#include <glm/gtx/transform.hpp>
+#include <glm/gtx/quaternion.hpp>
+#include "../app/Skeleton.h"
+#include "../app/JointAnimation.h"
+#include "PoseKernels.h"
+
+// Key frame sampling shared by Animator and AnimationSystem
+
+inline float GetKeyTime(const KeyFrame& frame) { return frame.TimeStamp; }
+inline float GetKeyTime(float time) { return time; }
+
+// moves cursor to the first key with a time > time, keys are key frames or their times
+template <typename Key>
+inline void AdvanceCursor(const std::vector<Key>& frames, std::size_t& cursor, float time)
+{
+	const std::size_t count = frames.size();
+	if (cursor > count) cursor = count;
+
+	// playing forward the next frame is the same one or one of the following two
+	const bool behind = cursor > 0 && GetKeyTime(frames[cursor - 1]) > time;
+	if (!behind)
+	{
+		for (int step = 0; step < 2 && cursor < count && GetKeyTime(frames[cursor]) <= time; ++step)
+			++cursor;
+		if (cursor == count || GetKeyTime(frames[cursor]) > time) return;
+	}
+
+	// loop wrap-around or a seek
+	auto it = std::upper_bound(frames.begin(), frames.end(), time, [](float t, const Key& k) {
+		return t < GetKeyTime(k);
+	});
+	cursor = it - frames.begin();
+}
+
+inline float GetProgression(float previousTimeStamp, float nextTimeStamp, float currentTime)
+{
+	float totalTime = nextTimeStamp - previousTimeStamp;
+	if (totalTime <= 0.0f) return 0.0f;
+	float currentTimePoint = currentTime - previousTimeStamp;
+	return currentTimePoint / totalTime;
+}
+
+// the two key frames of a channel around time and the progression between them
+struct KeyFrameSample
+{
+	const KeyFrame* Previous;
+	const KeyFrame* Next;
+	float Progression;
+};
+
+// the keys around time from cursor (moved forward like AdvanceCursor), frames can't be empty.
+// Before the first frame or after the last one both are the same key and the pose is held
+inline KeyFrameSample SampleKeys(const std::vector<KeyFrame>& frames, std::size_t& cursor, float time)
+{
+	AdvanceCursor(frames, cursor, time);
+	const KeyFrame& previous = frames[cursor > 0 ? cursor - 1 : 0];
+	const KeyFrame& next = frames[cursor < frames.size() ? cursor : frames.size() - 1];
+	return KeyFrameSample{ &previous, &next, GetProgression(previous.TimeStamp, next.TimeStamp, time) };
+}
+
+// the local pose of the keys decomposed, with the rotation of the kernels (ApproximateSlerp)
+inline void InterpolateKeys(const KeyFrameSample& keys, KeyFrame& pose)
+{
+	pose.Translation = keys.Previous->Translation + (keys.Next->Translation - keys.Previous->Translation) * keys.Progression;
+	pose.Rotation = ApproximateSlerp(keys.Previous->Rotation, keys.Next->Rotation, keys.Progression);
+	pose.Scale = keys.Previous->Scale + (keys.Next->Scale - keys.Previous->Scale) * keys.Progression;
+}
+
+inline glm::quat InterpolateRotations(const glm::quat& prev, const glm::quat& next, float progression)
+{
+	glm::quat rotation = glm::slerp(prev,next,progression);
+	rotation = glm::normalize(rotation);
+	return rotation;
+}
+
+inline glm::vec3 InterpolateTranslations(const glm::vec3& prev, const glm::vec3& next, float progression)
+{
+	return glm::mix(prev, next, progression);
+}
+
+inline glm::mat4 GetMatrixForm(const glm::quat& rotation, const glm::vec3& offset, const glm::vec3& scale)
+{
+	glm::mat4 translationMatrix = glm::translate(glm::mat4(1.0f), offset);
+	glm::mat4 rotationMatrix = glm::toMat4(rotation);
+	return   translationMatrix * rotationMatrix * glm::scale(glm::mat4(1.0f), scale);
+}
+
+// local transform of a channel at time, frames can't be empty.
+// The glm path, SampleClip gives the same pose within the tolerance of PoseKernels.h
+inline glm::mat4 SampleKeyFrames(const std::vector<KeyFrame>& frames, std::size_t& cursor, float time)
+{
+	//Find previous key frame and next keframe for the Current time, and the progression between them
+	const KeyFrameSample keys = SampleKeys(frames, cursor, time);
+
+	// Interpolate, the key frames are already decomposed
+	glm::quat finalRotation = InterpolateRotations(keys.Previous->Rotation, keys.Next->Rotation, keys.Progression);
+	glm::vec3 finalTranslation = InterpolateTranslations(keys.Previous->Translation, keys.Next->Translation, keys.Progression);
+	glm::vec3 finalScale = InterpolateTranslations(keys.Previous->Scale, keys.Next->Scale, keys.Progression);
+
+	return GetMatrixForm(finalRotation, finalTranslation, finalScale);
+}
+
+// local transforms (skeleton order) of a clip at time, one cursor per joint.
+// Joints without channel (or with skip[i] != 0, if skip is given) keep their bind pose,
+// the others are gathered in batches and blended by the SIMD kernels
+inline void SampleClip(const Skeleton& bones, const std::vector<JointAnimation>& animation, const std::vector<int>& jointChannels,
+	std::size_t* cursors, float time, glm::mat4* local, const unsigned char* skip = nullptr)
+{
+	PoseBatch batch;
+	batch.Count = 0;
+
+	for (std::size_t i = 0; i < bones.GetJointCount(); ++i)
+	{
+		const int channel = jointChannels[i];
+		if (channel < 0 || animation[channel].Frames.empty() || (skip && skip[i]))
+		{
+			local[i] = bones.LocalBindTransforms[i];
+			continue;
+		}
+
+		const KeyFrameSample keys = SampleKeys(animation[channel].Frames, cursors[i], time);
+		batch.Add(*keys.Previous, *keys.Next, keys.Progression, (int)i);
+		if (batch.IsFull())
+		{
+			BlendPoseBatch(batch, local);
+			batch.Count = 0;
+		}
+	}
+
+	if (batch.Count > 0)
+		BlendPoseBatch(batch, local);
+}
+
+// time of the last key frame of all the channels
+inline float ComputeAnimationDuration(const std::vector<JointAnimation>& anim)
+{
+	float duration = 0;
+	for (const JointAnimation& joint : anim)
+	{
+		for (const KeyFrame& f : joint.Frames)
+		{
+			if (f.TimeStamp >= duration)
+				duration = f.TimeStamp;
+		}
+	}
+	return duration;
+}
+
+inline bool HasKeyFrames(const JointAnimation& channel) { return !channel.Frames.empty(); }
+
+// index in animation of the channel of every joint of skeleton, -1 if it has none.
+// Mismatches are reported here once, tag is the prefix of the messages.
+// A channel is anything with a jointName and a HasKeyFrames overload
+template <typename Channel>
+inline std::vector<int> BindChannelsToJoints(const Skeleton& skeleton, const std::vector<Channel>& animation, const char* tag)
+{
+	std::unordered_map<std::string, int> channels;
+	for (std::size_t c = 0; c < animation.size(); ++c)
+		channels.emplace(animation[c].jointName, (int)c);
+
+	std::vector<bool> used(animation.size(), false);
+	std::vector<int> jointChannels(skeleton.GetJointCount(), -1);
+	for (std::size_t i = 0; i < skeleton.GetJointCount(); ++i)
+	{
+		auto it = channels.find(skeleton.Channels[i]);
+		if (it == channels.end())
+		{
+			std::cerr << tag << "joint " << skeleton.Names[i] << " has no channel, it keeps its bind pose" << std::endl;
+			continue;
+		}
+		jointChannels[i] = it->second;
+		used[it->second] = true;
+	}
+
+	for (std::size_t c = 0; c < animation.size(); ++c)
+	{
+		if (!used[c] && HasKeyFrames(animation[c]))
+			std::cerr << tag << "channel " << animation[c].jointName << " doesn't animate any joint" << std::endl;
+	}
+	return jointChannels;
+}
@@ -0,0 +1,300 @@
+#include "AnimationSystem.h"
+#include <cmath>
+#include <algorithm>
+#include "AnimationSampling.h"
+
+namespace
+{
+	// the last poses of the entries become the previous ones
+	void ShiftPoses(PoseBatch& batch)
+	{
+		const std::size_t n = batch.Count;
+		std::copy(batch.Q1x, batch.Q1x + n, batch.Q0x); std::copy(batch.Q1y, batch.Q1y + n, batch.Q0y);
+		std::copy(batch.Q1z, batch.Q1z + n, batch.Q0z); std::copy(batch.Q1w, batch.Q1w + n, batch.Q0w);
+		std::copy(batch.T1x, batch.T1x + n, batch.T0x); std::copy(batch.T1y, batch.T1y + n, batch.T0y); std::copy(batch.T1z, batch.T1z + n, batch.T0z);
+		std::copy(batch.S1x, batch.S1x + n, batch.S0x); std::copy(batch.S1y, batch.S1y + n, batch.S0y); std::copy(batch.S1z, batch.S1z + n, batch.S0z);
+	}
+
+	void SetLastPose(PoseBatch& batch, std::size_t i, const KeyFrame& pose)
+	{
+		batch.Q1x[i] = pose.Rotation.x; batch.Q1y[i] = pose.Rotation.y; batch.Q1z[i] = pose.Rotation.z; batch.Q1w[i] = pose.Rotation.w;
+		batch.T1x[i] = pose.Translation.x; batch.T1y[i] = pose.Translation.y; batch.T1z[i] = pose.Translation.z;
+		batch.S1x[i] = pose.Scale.x; batch.S1y[i] = pose.Scale.y; batch.S1z[i] = pose.Scale.z;
+	}
+}
+
+int AnimationSystem::AddSkeleton(const Skeleton& skeleton)
+{
+	Skeletons.push_back(SkeletonData{ skeleton, {}, {}, 0, std::vector<KeyFrame>(skeleton.GetJointCount()) });
+	SkeletonData& data = Skeletons.back();
+	for (std::size_t i = 0; i < skeleton.GetJointCount(); ++i)
+		data.BindPose[i].SetTransform(skeleton.LocalBindTransforms[i]);
+	UpdateDetailMask(data);
+	return (int)Skeletons.size() - 1;
+}
+
+int AnimationSystem::AddClip(int skeletonId, const std::vector<JointAnimation>& animation)
+{
+	if (skeletonId < 0 || skeletonId >= (int)Skeletons.size()) return -1;
+
+	ClipData clip;
+	clip.SkeletonId = skeletonId;
+	clip.Duration = ComputeAnimationDuration(animation);
+	clip.Animation = animation;
+	clip.JointChannels = BindChannelsToJoints(Skeletons[skeletonId].Bones, clip.Animation, "[AnimationSystem]: ");
+	Clips.push_back(std::move(clip));
+	return (int)Clips.size() - 1;
+}
+
+int AnimationSystem::AddInstance(int clipId, float speed, float startTime)
+{
+	if (clipId < 0 || clipId >= (int)Clips.size()) return -1;
+
+	const int instance = (int)Times.size();
+	const int skeletonId = Clips[clipId].SkeletonId;
+	const Skeleton& bones = Skeletons[skeletonId].Bones;
+
+	InstanceSkeletons.push_back(skeletonId);
+	InstanceClips.push_back(clipId);
+	Times.push_back(startTime);
+	Speeds.push_back(speed);
+	PaletteOffsets.push_back(Palettes.size());
+	Palettes.insert(Palettes.end(), bones.GetJointCount(), glm::mat4(1.0f));
+	Cursors.insert(Cursors.end(), bones.GetJointCount(), 0);
+	Positions.push_back(glm::vec3(0.0f));
+	LodFrames.push_back(0);
+	HistoryValid.push_back(0);
+	HistorySkippedDetail.push_back(0);
+	BatchOffsets.push_back(InterpolationBatches.size());
+	InterpolationBatches.resize(InterpolationBatches.size() + GetBatchCount(bones.GetJointCount()));
+	DetailEntries.push_back(0);
+	Skeletons[skeletonId].Instances.push_back(instance);
+	UpdateOrderDirty = true;
+	return instance;
+}
+
+void AnimationSystem::SetClip(int instance, int clipId, float startTime)
+{
+	if (clipId < 0 || clipId >= (int)Clips.size()) return;
+	if (Clips[clipId].SkeletonId != InstanceSkeletons[instance]) return;
+
+	InstanceClips[instance] = clipId;
+	Times[instance] = startTime;
+
+	// the cursors point into the key frames of the previous clip
+	const std::size_t jointCount = Skeletons[InstanceSkeletons[instance]].Bones.GetJointCount();
+	std::fill(Cursors.begin() + PaletteOffsets[instance], Cursors.begin() + PaletteOffsets[instance] + jointCount, 0);
+	HistoryValid[instance] = 0;
+}
+
+void AnimationSystem::SetLodPolicy(const AnimationLodPolicy& policy)
+{
+	LodPolicy = policy;
+	for (SkeletonData& skeleton : Skeletons)
+		UpdateDetailMask(skeleton);
+	std::fill(HistoryValid.begin(), HistoryValid.end(), 0);
+}
+
+void AnimationSystem::UpdateDetailMask(SkeletonData& skeleton)
+{
+	skeleton.DetailMask = ComputeDetailJointMask(skeleton.Bones, LodPolicy);
+	skeleton.DetailCount = (std::size_t)std::count(skeleton.DetailMask.begin(), skeleton.DetailMask.end(), 1);
+}
+
+void AnimationSystem::AddLodStats(const AnimationLodStats& stats)
+{
+	std::lock_guard<std::mutex> lock(LodStatsMutex);
+	LodStats.Add(stats);
+}
+
+void AnimationSystem::Update(float dt)
+{
+	AnimationLodStats stats;
+	for (const SkeletonData& skeleton : Skeletons)
+	{
+		for (int instance : skeleton.Instances)
+			UpdateInstance(skeleton, instance, dt, stats);
+	}
+	LodStats = stats;
+	TotalLodStats.Add(stats);
+}
+
+void AnimationSystem::Update(float dt, JobSystem& jobs, std::size_t chunkSize)
+{
+	if (UpdateOrderDirty)
+	{
+		UpdateOrder.clear();
+		for (const SkeletonData& skeleton : Skeletons)
+			UpdateOrder.insert(UpdateOrder.end(), skeleton.Instances.begin(), skeleton.Instances.end());
+		UpdateOrderDirty = false;
+	}
+
+	// a chunk is a run of instances of (mostly) the same skeleton, big rigs make slow chunks
+	// and the idle threads steal the chunks still queued on the busy ones
+	LodStats = AnimationLodStats{};
+	jobs.ParallelFor(UpdateOrder.size(), chunkSize, [this, dt](std::size_t begin, std::size_t end) {
+		AnimationLodStats stats;
+		for (std::size_t i = begin; i < end; ++i)
+		{
+			const int instance = UpdateOrder[i];
+			UpdateInstance(Skeletons[InstanceSkeletons[instance]], instance, dt, stats);
+		}
+		AddLodStats(stats);
+	});
+	TotalLodStats.Add(LodStats);
+}
+
+void AnimationSystem::UpdateInstance(const SkeletonData& skeleton, int instance, float dt, AnimationLodStats& stats)
+{
+	const ClipData& clip = Clips[InstanceClips[instance]];
+
+	float time = Times[instance] + dt * Speeds[instance];
+	if (clip.Duration > 0.0f)
+	{
+		time = std::fmod(time, clip.Duration);
+		if (time < 0.0f) time += clip.Duration;
+	}
+	Times[instance] = time;
+
+	const std::size_t jointCount = skeleton.Bones.GetJointCount();
+	glm::mat4* palette = Palettes.data() + PaletteOffsets[instance];
+	const int level = LodPolicy.SelectLevel(glm::length(Positions[instance] - ViewPosition));
+	const int interval = level < 0 ? 1 : LodPolicy.Levels[level].UpdateInterval;
+	const bool skipDetail = level >= 0 && LodPolicy.Levels[level].SkipDetailJoints;
+	const std::size_t skipped = skipDetail ? skeleton.DetailCount : 0;
+
+	if (interval <= 1)
+	{
+		EvaluateInstance(skeleton, instance, time, level, palette);
+		HistoryValid[instance] = 0;
+		stats.EvaluatedBones += jointCount - skipped;
+		stats.SavedBones += skipped;
+		++stats.EvaluatedInstances;
+		return;
+	}
+
+	// the instance shows the way from its previous to its last evaluated pose while the next
+	// one is due: it runs one interval behind its time
+	PoseBatch* batches = InterpolationBatches.data() + BatchOffsets[instance];
+	const std::size_t batchCount = GetBatchCount(jointCount);
+	int& frames = LodFrames[instance];
+	const bool evaluate = !HistoryValid[instance] || ++frames >= interval;
+	if (evaluate)
+	{
+		if (HistoryValid[instance])
+		{
+			SampleInterpolation(skeleton, instance, time, skipDetail);
+			HistorySkippedDetail[instance] = (unsigned char)(((HistorySkippedDetail[instance] << 1) | skipDetail) & 3);
+			frames = 0;
+		}
+		else
+		{
+			StartInterpolation(skeleton, instance);
+			SampleInterpolation(skeleton, instance, time, skipDetail);
+			for (std::size_t b = 0; b < batchCount; ++b)
+				ShiftPoses(batches[b]);
+			HistorySkippedDetail[instance] = skipDetail ? 3 : 0;
+			// spread the evaluations of the instances over the frames of the interval
+			frames = instance % interval;
+			HistoryValid[instance] = 1;
+		}
+		stats.EvaluatedBones += jointCount - skipped;
+		stats.SavedBones += skipped;
+		++stats.EvaluatedInstances;
+	}
+	else
+	{
+		stats.SavedBones += jointCount;
+		++stats.InterpolatedInstances;
+	}
+
+	// the joints without keys, and the detail joints when both evaluations left them in bind
+	// pose, don't move. The others are interpolated like key frames (a lerp of the matrices
+	// isn't a rotation), then the local pose is made global in place
+	const bool detailInBind = HistorySkippedDetail[instance] == 3;
+	for (std::size_t i = 0; i < jointCount; ++i)
+	{
+		const int channel = clip.JointChannels[i];
+		if (channel < 0 || clip.Animation[channel].Frames.empty() || (detailInBind && skeleton.DetailMask[i]))
+			palette[i] = skeleton.Bones.LocalBindTransforms[i];
+	}
+
+	const float t = (float)frames / interval;
+	const std::size_t blended = detailInBind ? DetailEntries[instance] : jointCount;
+	for (std::size_t b = 0; b < batchCount && b * PoseBatch::Capacity < blended; ++b)
+	{
+		// the detail joints in bind pose are the last entries, out of the count while it blends
+		PoseBatch& batch = batches[b];
+		const std::size_t count = batch.Count;
+		batch.Count = std::min(count, blended - b * PoseBatch::Capacity);
+		std::fill(batch.Progression, batch.Progression + batch.Count, t);
+		BlendPoseBatch(batch, palette);
+		if (!evaluate)
+			stats.InterpolatedBones += batch.Count;
+		batch.Count = count;
+	}
+	skeleton.Bones.ComputeGlobalTransforms(palette, palette);
+}
+
+void AnimationSystem::EvaluateInstance(const SkeletonData& skeleton, int instance, float time, int level, glm::mat4* palette)
+{
+	const ClipData& clip = Clips[InstanceClips[instance]];
+	std::size_t* cursors = Cursors.data() + PaletteOffsets[instance];
+	const bool skipDetail = level >= 0 && LodPolicy.Levels[level].SkipDetailJoints;
+	const unsigned char* skip = skipDetail ? skeleton.DetailMask.data() : nullptr;
+
+	// local pose, then made global in place: the parent is always before the joint
+	SampleClip(skeleton.Bones, clip.Animation, clip.JointChannels, cursors, time, palette, skip);
+	skeleton.Bones.ComputeGlobalTransforms(palette, palette);
+}
+
+void AnimationSystem::StartInterpolation(const SkeletonData& skeleton, int instance)
+{
+	const ClipData& clip = Clips[InstanceClips[instance]];
+	const std::size_t jointCount = skeleton.Bones.GetJointCount();
+	PoseBatch* batches = InterpolationBatches.data() + BatchOffsets[instance];
+	for (std::size_t b = 0; b < GetBatchCount(jointCount); ++b)
+		batches[b].Count = 0;
+
+	// the joints with keys that aren't detail joints, then the detail ones
+	std::size_t entries = 0;
+	for (unsigned char detail = 0; detail < 2; ++detail)
+	{
+		if (detail)
+			DetailEntries[instance] = entries;
+		for (std::size_t i = 0; i < jointCount; ++i)
+		{
+			const int channel = clip.JointChannels[i];
+			if (skeleton.DetailMask[i] != detail || channel < 0 || clip.Animation[channel].Frames.empty()) continue;
+			batches[entries / PoseBatch::Capacity].Add(skeleton.BindPose[i], skeleton.BindPose[i], 0.0f, (int)i);
+			++entries;
+		}
+	}
+}
+
+void AnimationSystem::SampleInterpolation(const SkeletonData& skeleton, int instance, float time, bool skipDetail)
+{
+	const ClipData& clip = Clips[InstanceClips[instance]];
+	std::size_t* cursors = Cursors.data() + PaletteOffsets[instance];
+	PoseBatch* batches = InterpolationBatches.data() + BatchOffsets[instance];
+
+	// the same keys and rotation as SampleClip, kept decomposed
+	for (std::size_t b = 0; b < GetBatchCount(skeleton.Bones.GetJointCount()); ++b)
+	{
+		PoseBatch& batch = batches[b];
+		ShiftPoses(batch);
+		for (std::size_t i = 0; i < batch.Count; ++i)
+		{
+			const int joint = batch.Targets[i];
+			if (skipDetail && skeleton.DetailMask[joint])
+			{
+				SetLastPose(batch, i, skeleton.BindPose[joint]);
+				continue;
+			}
+
+			KeyFrame pose;
+			InterpolateKeys(SampleKeys(clip.Animation[clip.JointChannels[joint]].Frames, cursors[joint], time), pose);
+			SetLastPose(batch, i, pose);
+		}
+	}
+}
@@ -0,0 +1,130 @@
+#pragma once
+#include <vector>
+#include <mutex>
+#include <cstddef>
+#include <glm/glm.hpp>
+#include "../app/Skeleton.h"
+#include "../app/JointAnimation.h"
+#include "../core/utils/JobSystem.h"
+#include "AnimationLod.h"
+#include "PoseKernels.h"
+
+// Updates many characters in one call. Skeletons and clips are shared, every instance only
+// has its clip, time, speed, key frame cursors and a slice of one big palette of matrices.
+// The update goes skeleton by skeleton so the parents and bind pose of the rig stay in cache
+// while all the instances that use it are animated.
+// With a level of detail policy the instances far from the view position are evaluated less
+// often and with fewer joints (AnimationLod.h).
+class AnimationSystem
+{
+	struct SkeletonData
+	{
+		Skeleton Bones;
+		// instances of this skeleton, in the order they were added
+		std::vector<int> Instances;
+		// detail joints of the policy, and how many
+		std::vector<unsigned char> DetailMask;
+		std::size_t DetailCount;
+		// bind pose decomposed, for the detail joints of the instances updated every few frames
+		std::vector<KeyFrame> BindPose;
+	};
+
+	struct ClipData
+	{
+		int SkeletonId;
+		float Duration;
+		std::vector<JointAnimation> Animation;
+		// channel of every joint of the skeleton, -1 if it has none
+		std::vector<int> JointChannels;
+	};
+
+	std::vector<SkeletonData> Skeletons;
+	std::vector<ClipData> Clips;
+
+	// instances, one entry per instance in every array
+	std::vector<int> InstanceSkeletons;
+	std::vector<int> InstanceClips;
+	std::vector<float> Times;
+	std::vector<float> Speeds;
+	std::vector<std::size_t> PaletteOffsets;
+	// one cursor per joint of the skeleton, from PaletteOffsets too
+	std::vector<std::size_t> Cursors;
+	std::vector<glm::vec3> Positions;
+	// frames since the last evaluation, and if InterpolationBatches hold the last two evaluations
+	std::vector<int> LodFrames;
+	std::vector<unsigned char> HistoryValid;
+	// bit 0 if the last evaluation left the detail joints in bind pose, bit 1 the previous one
+	std::vector<unsigned char> HistorySkippedDetail;
+
+	// model space transforms of all the instances, in skeleton order
+	std::vector<glm::mat4> Palettes;
+	// the joints with keys of the instances updated every few frames and their two last evaluated
+	// local poses (previous on the 0 side, last on the 1 side): a frame between two evaluations
+	// only sets the progression and blends them. GetBatchCount(joints) batches per instance from
+	// BatchOffsets, the detail joints are the entries from DetailEntries on
+	std::vector<PoseBatch> InterpolationBatches;
+	std::vector<std::size_t> BatchOffsets;
+	std::vector<std::size_t> DetailEntries;
+
+	AnimationLodPolicy LodPolicy;
+	glm::vec3 ViewPosition{ 0.0f };
+	AnimationLodStats LodStats;
+	AnimationLodStats TotalLodStats;
+	std::mutex LodStatsMutex;
+
+	// all the instances grouped by skeleton, what the threads split in chunks
+	std::vector<int> UpdateOrder;
+	bool UpdateOrderDirty = false;
+
+public:
+	int AddSkeleton(const Skeleton& skeleton);
+	// the channels are bound to the joints of the skeleton here, once
+	int AddClip(int skeletonId, const std::vector<JointAnimation>& animation);
+	// returns -1 if the clip doesn't exist
+	int AddInstance(int clipId, float speed = 1.0f, float startTime = 0.0f);
+
+	// the clip must be of the same skeleton, playback starts again from startTime
+	void SetClip(int instance, int clipId, float startTime = 0.0f);
+	void SetSpeed(int instance, float speed) { Speeds[instance] = speed; }
+	void SetTime(int instance, float time) { Times[instance] = time; }
+	// world position of the instance, its distance to the view position selects its level of detail
+	void SetPosition(int instance, const glm::vec3& position) { Positions[instance] = position; }
+
+	// the levels apply from the next Update, an empty policy updates everything every frame
+	void SetLodPolicy(const AnimationLodPolicy& policy);
+	const AnimationLodPolicy& GetLodPolicy() const { return LodPolicy; }
+	// usually the camera position
+	void SetViewPosition(const glm::vec3& position) { ViewPosition = position; }
+
+	// advance every instance dt seconds (times its speed) and compute the palettes
+	void Update(float dt);
+	// same as Update(dt) split over the threads of jobs in chunks of chunkSize instances.
+	// Every instance only writes its own time, cursors and palette, so the result is the
+	// same as the single threaded one whatever thread runs each chunk
+	void Update(float dt, JobSystem& jobs, std::size_t chunkSize = 32);
+
+	std::size_t GetInstanceCount() const { return Times.size(); }
+	float GetTime(int instance) const { return Times[instance]; }
+	const Skeleton& GetSkeleton(int skeletonId) const { return Skeletons[skeletonId].Bones; }
+	// model space transforms of one instance, GetSkeleton(...).GetJointCount() of them
+	const glm::mat4* GetPalette(int instance) const { return Palettes.data() + PaletteOffsets[instance]; }
+	// the palettes of all the instances, one after the other
+	const std::vector<glm::mat4>& GetPalettes() const { return Palettes; }
+
+	// bone evaluations of the last Update, and of all of them since ResetLodStats
+	const AnimationLodStats& GetLodStats() const { return LodStats; }
+	const AnimationLodStats& GetTotalLodStats() const { return TotalLodStats; }
+	void ResetLodStats() { TotalLodStats = AnimationLodStats{}; }
+
+private:
+	void UpdateDetailMask(SkeletonData& skeleton);
+	void AddLodStats(const AnimationLodStats& stats);
+	void UpdateInstance(const SkeletonData& skeleton, int instance, float dt, AnimationLodStats& stats);
+	// the pose of the instance at time into palette, model space
+	void EvaluateInstance(const SkeletonData& skeleton, int instance, float time, int level, glm::mat4* palette);
+	// the joints of the interpolation batches of the instance
+	void StartInterpolation(const SkeletonData& skeleton, int instance);
+	// the last pose of the interpolation batches becomes the previous one, and the pose at time the last one
+	void SampleInterpolation(const SkeletonData& skeleton, int instance, float time, bool skipDetail);
+	static std::size_t GetBatchCount(std::size_t jointCount) { return (jointCount + PoseBatch::Capacity - 1) / PoseBatch::Capacity; }
+};
@@ -1,43 +1,74 @@
 #pragma once
 #include <vector>
+#include <memory>
 #include <algorithm>
 #include <glm/gtx/quaternion.hpp>
-#include <glm/gtx/matrix_decompose.hpp>
 #include "../app/Joint.h"
+#include "../app/Skeleton.h"
 #include "../app/JointAnimation.h"
+#include "AnimationSampling.h"
+#include "ClipCompression.h"
 
 class Animator
 {
 	Joint* Root;
+	// flat copy of Root, the pose is computed over it
+	Skeleton Bones;
 	float Duration; 
 	float CurrentTime;
 	bool ApplyCorrection;
 	std::vector<JointAnimation> Animation;
+	// when set it is played instead of Animation, decoding only the keys it samples.
+	// Shared, the animators of many characters play the same clip
+	std::shared_ptr<const CompressedClip> Compressed;
+	// index in Animation (or Compressed->Tracks) of the channel of every joint (skeleton order), -1 if it has none
+	std::vector<int> JointChannels;
+	// local transform of every joint, in skeleton order
 	std::vector<glm::mat4> CurrentPosTransform;
+	// playback position of every joint in its channel: the first key frame after the
+	// current time. Advances with the time and is searched again on a jump back
+	std::vector<std::size_t> Cursors;
 public:
-	KeyFrame Previous;
-	KeyFrame Next;
 	Animator( Joint* root, const std::vector<JointAnimation>& animation,bool correction = false)
 		: Root{root}
+		, Bones{ Skeleton::FromJointTree(root) }
 		, Duration{}
 		, CurrentTime{}
 		, ApplyCorrection{correction}
 		, Animation{animation}
-		, CurrentPosTransform(animation.size(),glm::mat4(1.0f))
+		, CurrentPosTransform(Bones.GetJointCount(),glm::mat4(1.0f))
+		, Cursors(Bones.GetJointCount(), 0)
     {
 
 
 		Duration = ComputeDuration(Animation);
+		BindChannels();
+	}
 
+	Animator(Joint* root, std::shared_ptr<const CompressedClip> clip, bool correction = false)
+		: Root{ root }
+		, Bones{ Skeleton::FromJointTree(root) }
+		, Duration{ clip->Duration }
+		, CurrentTime{}
+		, ApplyCorrection{ correction }
+		, Compressed{ std::move(clip) }
+		, CurrentPosTransform(Bones.GetJointCount(), glm::mat4(1.0f))
+		, Cursors(Bones.GetJointCount(), 0)
+	{
+		BindChannels();
 	}
 
 	Animator(Animator& anim)
 		: Root{ nullptr }
+		, Bones{ anim.Bones }
 		, Duration{}
 		, CurrentTime{}
 		, ApplyCorrection{ anim.ApplyCorrection }
 		, Animation{ anim.Animation }
-		, CurrentPosTransform(Animation.size(), glm::mat4(1.0f))
+		, Compressed{ anim.Compressed }
+		, JointChannels{ anim.JointChannels }
+		, CurrentPosTransform(Bones.GetJointCount(), glm::mat4(1.0f))
+		, Cursors(Bones.GetJointCount(), 0)
 	{
 		//CopyTree(Root, anim.Root);
 	}
@@ -51,145 +82,89 @@ public:
 		}
 	}
 
-	float ComputeDuration(const std::vector<JointAnimation>& anim)
+	// play another animation of the same skeleton from the start
+	void SetAnimation(const std::vector<JointAnimation>& animation)
 	{
-		float duration = 0;
-		for (const JointAnimation& joint : anim)
-		{
-			if (!joint.Frames.empty())
-			{
-				for (KeyFrame f : joint.Frames)
-				{
-					if (f.TimeStamp >= duration)
-					{
-						duration = f.TimeStamp;
-					}
-				}
-			}
-
-		}
-		return duration;
+		Animation = animation;
+		Compressed.reset();
+		Cursors.assign(Bones.GetJointCount(), 0);
+		CurrentTime = 0.0f;
+		Duration = ComputeDuration(Animation);
+		BindChannels();
 	}
 
-
-
-	void Update(float dt)
+	// play a compressed clip of the same skeleton from the start
+	void SetAnimation(std::shared_ptr<const CompressedClip> clip)
 	{
-		  CurrentTime += 1* dt;
-		  CurrentTime = fmod(CurrentTime, Duration);
-		  CalculateBoneTransform(Root);
+		Animation.clear();
+		Compressed = std::move(clip);
+		Cursors.assign(Bones.GetJointCount(), 0);
+		CurrentTime = 0.0f;
+		Duration = Compressed->Duration;
+		BindChannels();
 	}
-	
-
 
-	void CalculateBoneTransform(Joint* node)
+	// resolve the channel of every joint once, the update never compares names
+	void BindChannels()
 	{
-		auto it = std::find_if(Animation.begin(), Animation.end(), [&](auto& a) {return a.jointName == node->Channel;});
-
-		
-		assert(it != Animation.end() && "Bone should be always there\n");
-
-		glm::mat4 localNewPositionTransform = node->localBindTransform;
-
-		// if this bone has animation compute the local transform for this bone
-		if (!it->Frames.empty())
-		{
-			localNewPositionTransform = ComputeNewBonePosition(it->Frames);			
-		}
-
-		// add the transform from parent to child
-		CurrentPosTransform[node->ID] =  localNewPositionTransform;
-
-
-		// repite process with all the children
-		for (Joint* child : node->Children)
-		{
-			CalculateBoneTransform(child);
-		}
+		if (Compressed)
+			JointChannels = BindChannelsToJoints(Bones, Compressed->Tracks, "[Animator]: ");
+		else
+			JointChannels = BindChannelsToJoints(Bones, Animation, "[Animator]: ");
 	}
 
-
-	glm::mat4 ComputeNewBonePosition(const std::vector<KeyFrame>& frames)
+	float ComputeDuration(const std::vector<JointAnimation>& anim)
 	{
-		//Find previous key frame and next keframe for the Current time
-		KeyFrame previous{Previous},next{Next};
-		bool found = false;
-		for (const KeyFrame& kframe : frames)
-		{
-			if (kframe.TimeStamp <= CurrentTime)
-			{
-				found = true;
-				previous = kframe;
-			}
-			else if (kframe.TimeStamp > CurrentTime)
-			{
-				next = kframe;
-				break;
-			}
-		}
-
-		Previous = previous; Next = next;
-
-		// Get the rotation and translation in vector and quaternion form from previos and next frame
-		glm::quat prevRot{}; glm::vec3 prevTrans{};
-	    ExtractRotationAndTranslation(prevRot,prevTrans,previous.Transform);
-
-		glm::quat nextRot{}; glm::vec3 nextTrans{};
-		ExtractRotationAndTranslation(nextRot, nextTrans, next.Transform);
+		return ComputeAnimationDuration(anim);
+	}
 
-		// Get the progression factor to interpolate base on it
-		float progression = GetProgression(previous.TimeStamp, next.TimeStamp,CurrentTime);
 
-		// Interpolate 
-		glm::quat finalRotation = InterpolateRotations(prevRot, nextRot, progression);
-		glm::vec3 finalTranslation = InterpolateTranslations(prevTrans, nextTrans,progression);
-		// final transforms
-		glm::mat4 finalBoneLocalPositionTransform = GetMatrixForm(finalRotation, finalTranslation);
 
-		return finalBoneLocalPositionTransform;
-	}
-	
-	void ExtractRotationAndTranslation(glm::quat& rot, glm::vec3& offset, glm::mat4 transform)
+	void Update(float dt)
 	{
-		glm::vec3 scale;
-		glm::vec3 skew;
-		glm::vec4 perspective;
-		glm::decompose(transform, scale, rot, offset, skew, perspective);
+		  CurrentTime += 1* dt;
+		  CurrentTime = fmod(CurrentTime, Duration);
+		  CalculateBoneTransforms();
 	}
+	
 
-	float GetProgression(float previousTimeStamp, float nextTimeStamp, float currentTime)
+
+	void CalculateBoneTransforms()
 	{
-		float totalTime = nextTimeStamp - previousTimeStamp;
-		float currentTimePoint = currentTime - previousTimeStamp;
-		return currentTimePoint / totalTime;
+		// the bones with animation are sampled in batches, the rest keep the bind pose
+		if (Compressed)
+			SampleCompressedClip(Bones, *Compressed, JointChannels, Cursors.data(), CurrentTime, CurrentPosTransform.data());
+		else
+			SampleClip(Bones, Animation, JointChannels, Cursors.data(), CurrentTime, CurrentPosTransform.data());
 	}
 
 
 
-	glm::quat InterpolateRotations(glm::quat& prev, glm::quat& next, float progression)
-	{
-		glm::quat rotation = glm::slerp(prev,next,progression);
-		rotation = glm::normalize(rotation);
-		return rotation;
-	}
+	const Skeleton& GetSkeleton() const { return Bones; }
 
-	glm::vec3 InterpolateTranslations(glm::vec3& prev, glm::vec3& next, float progression)
+	// local transforms in skeleton order, valid until the next Update.
+	// Skeleton::ComputeGlobalTransforms gives the pose in model space
+	const std::vector<glm::mat4>& GetBoneTransforms() const
 	{
-
-		return glm::mix(prev, next, progression);
+		return CurrentPosTransform;
 	}
 
-	glm::mat4 GetMatrixForm(glm::quat& rotation, glm::vec3& offset)
+	// the methods below write into memory of the caller (a reused vector, a mapped gpu buffer...)
+	// and never allocate. They return the number of matrices written
+
+	// local transforms, at most count
+	std::size_t GetBoneTransforms(glm::mat4* out, std::size_t count) const
 	{
-		glm::mat4 translationMatrix = glm::translate(glm::mat4(1.0f), offset);
-		glm::mat4 rotationMatrix = glm::toMat4(rotation);
-		return   translationMatrix * rotationMatrix;
+		count = std::min(count, CurrentPosTransform.size());
+		std::copy(CurrentPosTransform.begin(), CurrentPosTransform.begin() + count, out);
+		return count;
 	}
 
-
-
-	std::vector<glm::mat4> GetBoneTransforms()
+	// model space transforms, the root placed with rootTransform. out must fit the whole skeleton
+	std::size_t GetGlobalTransforms(glm::mat4* out, std::size_t count, const glm::mat4& rootTransform = glm::mat4(1.0f)) const
 	{
-		return CurrentPosTransform;
+		if (count < Bones.GetJointCount()) return 0;
+		Bones.ComputeGlobalTransforms(CurrentPosTransform.data(), out, rootTransform);
+		return Bones.GetJointCount();
 	}
 };
\ No newline at end of file
@@ -0,0 +1,261 @@
+#include "ClipCompression.h"
+#include <cmath>
+#include <algorithm>
+
+namespace
+{
+	// the three smallest components of a unit quaternion are inside +-1/sqrt(2)
+	const float SmallestThreeRange = 0.70710678f;
+	const float RotationSteps = 32767.0f;
+	const float RangeSteps = 65535.0f;
+
+	void EncodeRotation(const glm::quat& rotation, std::uint16_t* out)
+	{
+		const glm::quat q = glm::normalize(rotation);
+		const float c[4] = { q.x, q.y, q.z, q.w };
+		int largest = 0;
+		for (int i = 1; i < 4; ++i)
+		{
+			if (std::abs(c[i]) > std::abs(c[largest])) largest = i;
+		}
+
+		// q and -q are the same rotation, with the largest positive it doesn't need a sign
+		const float sign = c[largest] < 0.0f ? -1.0f : 1.0f;
+		int n = 0;
+		for (int i = 0; i < 4; ++i)
+		{
+			if (i == largest) continue;
+			const float v = glm::clamp(c[i] * sign / SmallestThreeRange, -1.0f, 1.0f);
+			out[n++] = (std::uint16_t)std::lround((v * 0.5f + 0.5f) * RotationSteps);
+		}
+		out[0] |= (std::uint16_t)((largest & 1) << 15);
+		out[1] |= (std::uint16_t)((largest >> 1) << 15);
+	}
+
+	glm::quat DecodeRotation(const std::uint16_t* in)
+	{
+		const int largest = (in[0] >> 15) | ((in[1] >> 15) << 1);
+		float c[4];
+		float sum = 0.0f;
+		int n = 0;
+		for (int i = 0; i < 4; ++i)
+		{
+			if (i == largest) continue;
+			c[i] = ((in[n++] & 0x7fff) / RotationSteps * 2.0f - 1.0f) * SmallestThreeRange;
+			sum += c[i] * c[i];
+		}
+		c[largest] = std::sqrt(std::max(0.0f, 1.0f - sum));
+		return glm::normalize(glm::quat(c[3], c[0], c[1], c[2]));
+	}
+
+	void EncodeRange(const glm::vec3& value, const glm::vec3& min, const glm::vec3& extent, std::uint16_t* out)
+	{
+		for (int i = 0; i < 3; ++i)
+		{
+			const float v = extent[i] > 0.0f ? glm::clamp((value[i] - min[i]) / extent[i], 0.0f, 1.0f) : 0.0f;
+			out[i] = (std::uint16_t)std::lround(v * RangeSteps);
+		}
+	}
+
+	glm::vec3 DecodeRange(const std::uint16_t* in, const glm::vec3& min, const glm::vec3& extent)
+	{
+		return min + glm::vec3(in[0], in[1], in[2]) / RangeSteps * extent;
+	}
+
+	// largest distance between the points at shell from the joint moved by a and by b
+	float KeyError(const KeyFrame& a, const KeyFrame& b, float shell)
+	{
+		float error = glm::length(a.Translation - b.Translation);
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			glm::vec3 point(0.0f);
+			point[axis] = shell;
+			const glm::vec3 pa = a.Translation + a.Rotation * (a.Scale * point);
+			const glm::vec3 pb = b.Translation + b.Rotation * (b.Scale * point);
+			error = std::max(error, glm::length(pa - pb));
+		}
+		return error;
+	}
+
+	KeyFrame Interpolate(const KeyFrame& previous, const KeyFrame& next, float time)
+	{
+		const float progression = GetProgression(previous.TimeStamp, next.TimeStamp, time);
+		KeyFrame k;
+		k.TimeStamp = time;
+		k.Rotation = InterpolateRotations(previous.Rotation, next.Rotation, progression);
+		k.Translation = InterpolateTranslations(previous.Translation, next.Translation, progression);
+		k.Scale = InterpolateTranslations(previous.Scale, next.Scale, progression);
+		return k;
+	}
+
+	// error of replacing the translation (or scale) of every key by value
+	template <typename Member>
+	float ConstantError(const std::vector<KeyFrame>& frames, Member member, const glm::vec3& value, float shell)
+	{
+		float error = 0.0f;
+		for (const KeyFrame& k : frames)
+		{
+			KeyFrame constant = k;
+			constant.*member = value;
+			error = std::max(error, KeyError(k, constant, shell));
+		}
+		return error;
+	}
+
+	CompressedTrack CompressTrack(const JointAnimation& channel, float tolerance, float shell)
+	{
+		const std::vector<KeyFrame>& frames = channel.Frames;
+		CompressedTrack track;
+		track.jointName = channel.jointName;
+		if (frames.empty()) return track;
+
+		glm::vec3 tMin(frames[0].Translation), tMax(frames[0].Translation);
+		glm::vec3 sMin(frames[0].Scale), sMax(frames[0].Scale);
+		for (const KeyFrame& k : frames)
+		{
+			tMin = glm::min(tMin, k.Translation); tMax = glm::max(tMax, k.Translation);
+			sMin = glm::min(sMin, k.Scale); sMax = glm::max(sMax, k.Scale);
+		}
+
+		// a translation or scale that barely moves (bone lengths, decomposition noise) is stored
+		// once if it costs at most half the tolerance, the rest is for the dropped keys
+		bool constantTranslation = ConstantError(frames, &KeyFrame::Translation, (tMin + tMax) * 0.5f, shell) <= tolerance * 0.5f;
+		bool constantScale = ConstantError(frames, &KeyFrame::Scale, (sMin + sMax) * 0.5f, shell) <= tolerance * 0.5f;
+		track.TranslationMin = constantTranslation ? (tMin + tMax) * 0.5f : tMin;
+		track.TranslationExtent = constantTranslation ? glm::vec3(0.0f) : tMax - tMin;
+		track.ScaleMin = constantScale ? (sMin + sMax) * 0.5f : sMin;
+		track.ScaleExtent = constantScale ? glm::vec3(0.0f) : sMax - sMin;
+
+		// every key quantized, the dropped keys are chosen comparing with the decoded ones
+		CompressedTrack all = track;
+		all.Times.resize(frames.size());
+		all.Rotations.resize(frames.size() * 3);
+		if (!constantTranslation) all.Translations.resize(frames.size() * 3);
+		if (!constantScale) all.Scales.resize(frames.size() * 3);
+		for (std::size_t k = 0; k < frames.size(); ++k)
+		{
+			all.Times[k] = frames[k].TimeStamp;
+			EncodeRotation(frames[k].Rotation, &all.Rotations[k * 3]);
+			if (!constantTranslation) EncodeRange(frames[k].Translation, track.TranslationMin, track.TranslationExtent, &all.Translations[k * 3]);
+			if (!constantScale) EncodeRange(frames[k].Scale, track.ScaleMin, track.ScaleExtent, &all.Scales[k * 3]);
+		}
+
+		std::vector<KeyFrame> decoded(frames.size());
+		for (std::size_t k = 0; k < frames.size(); ++k)
+			decoded[k] = all.DecodeKey(k);
+
+		// the keys between first and last are reproduced by interpolating them
+		auto fits = [&](std::size_t first, std::size_t last) {
+			for (std::size_t k = first + 1; k < last; ++k)
+			{
+				if (KeyError(frames[k], Interpolate(decoded[first], decoded[last], frames[k].TimeStamp), shell) > tolerance)
+					return false;
+			}
+			return true;
+		};
+
+		// greedy: from every kept key go as far as the interpolation holds
+		std::vector<std::size_t> kept{ 0 };
+		for (std::size_t first = 0; first + 1 < frames.size();)
+		{
+			std::size_t last = first + 1;
+			while (last + 1 < frames.size() && fits(first, last + 1))
+				++last;
+			kept.push_back(last);
+			first = last;
+		}
+
+		for (std::size_t k : kept)
+		{
+			track.Times.push_back(all.Times[k]);
+			track.Rotations.insert(track.Rotations.end(), &all.Rotations[k * 3], &all.Rotations[k * 3] + 3);
+			if (!constantTranslation) track.Translations.insert(track.Translations.end(), &all.Translations[k * 3], &all.Translations[k * 3] + 3);
+			if (!constantScale) track.Scales.insert(track.Scales.end(), &all.Scales[k * 3], &all.Scales[k * 3] + 3);
+		}
+		return track;
+	}
+
+	// error of the compressed track at the time of every original key
+	float MeasureTrackError(const JointAnimation& channel, const CompressedTrack& track, float shell)
+	{
+		float error = 0.0f;
+		std::size_t cursor = 0;
+		for (const KeyFrame& k : channel.Frames)
+		{
+			AdvanceCursor(track.Times, cursor, k.TimeStamp);
+			const KeyFrame previous = track.DecodeKey(cursor > 0 ? cursor - 1 : 0);
+			const KeyFrame next = track.DecodeKey(cursor < track.Times.size() ? cursor : track.Times.size() - 1);
+			error = std::max(error, KeyError(k, Interpolate(previous, next, k.TimeStamp), shell));
+		}
+		return error;
+	}
+}
+
+KeyFrame CompressedTrack::DecodeKey(std::size_t key) const
+{
+	KeyFrame k;
+	k.TimeStamp = Times[key];
+	k.Rotation = DecodeRotation(&Rotations[key * 3]);
+	k.Translation = Translations.empty() ? TranslationMin : DecodeRange(&Translations[key * 3], TranslationMin, TranslationExtent);
+	k.Scale = Scales.empty() ? ScaleMin : DecodeRange(&Scales[key * 3], ScaleMin, ScaleExtent);
+	return k;
+}
+
+std::size_t CompressedTrack::GetByteSize() const
+{
+	return Times.size() * sizeof(float)
+		+ (Rotations.size() + Translations.size() + Scales.size()) * sizeof(std::uint16_t)
+		+ 4 * sizeof(glm::vec3);
+}
+
+std::size_t CompressedClip::GetByteSize() const
+{
+	std::size_t size = 0;
+	for (const CompressedTrack& track : Tracks)
+		size += track.GetByteSize();
+	return size;
+}
+
+CompressedClip CompressClip(const std::vector<JointAnimation>& animation, const ClipCompressionSettings& settings, ClipCompressionStats* stats)
+{
+	float shell = settings.ShellDistance;
+	if (shell <= 0.0f)
+	{
+		for (const JointAnimation& channel : animation)
+		{
+			for (const KeyFrame& k : channel.Frames)
+				shell = std::max(shell, glm::length(k.Translation));
+		}
+		if (shell <= 0.0f) shell = 1.0f;
+	}
+	const float tolerance = settings.Tolerance > 0.0f ? settings.Tolerance : shell * 0.001f;
+
+	CompressedClip clip;
+	clip.Duration = ComputeAnimationDuration(animation);
+	clip.Tracks.reserve(animation.size());
+	for (const JointAnimation& channel : animation)
+		clip.Tracks.push_back(CompressTrack(channel, tolerance, shell));
+
+	if (stats)
+	{
+		*stats = ClipCompressionStats{};
+		stats->Tolerance = tolerance;
+		stats->ShellDistance = shell;
+		for (std::size_t c = 0; c < animation.size(); ++c)
+		{
+			stats->OriginalKeys += animation[c].Frames.size();
+			stats->CompressedKeys += clip.Tracks[c].Times.size();
+			stats->OriginalBytes += animation[c].Frames.size() * sizeof(KeyFrame);
+			if (animation[c].Frames.empty()) continue;
+
+			const float error = MeasureTrackError(animation[c], clip.Tracks[c], shell);
+			if (error >= stats->MaxError)
+			{
+				stats->MaxError = error;
+				stats->MaxErrorChannel = animation[c].jointName;
+			}
+		}
+		stats->CompressedBytes = clip.GetByteSize();
+	}
+	return clip;
+}
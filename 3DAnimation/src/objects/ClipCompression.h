@@ -0,0 +1,107 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include "../app/Skeleton.h"
+#include "../app/JointAnimation.h"
+#include "AnimationSampling.h"
+
+// Compressed clips: the key frames that the interpolation of their neighbours reproduces are
+// dropped, the rotations are stored as smallest three quaternions in 48 bits and translations
+// and scales as 16 bit values inside the range of their track.
+//
+// The error of a key is measured in joint space: the largest distance between a point placed
+// ShellDistance away from the joint along each axis transformed by the original key and by the
+// compressed one (the mesh around a joint moves that much at most).
+
+// one channel, every key is Times[k] and 3 values of each array at 3 * k
+struct CompressedTrack
+{
+	std::string jointName;
+	std::vector<float> Times;
+	// smallest three: the three smallest components in 15 bits, the index of the largest in
+	// the top bit of the first two values
+	std::vector<std::uint16_t> Rotations;
+	// empty if the track keeps TranslationMin (or ScaleMin) for all its keys
+	std::vector<std::uint16_t> Translations;
+	std::vector<std::uint16_t> Scales;
+	glm::vec3 TranslationMin{ 0.0f }, TranslationExtent{ 0.0f };
+	glm::vec3 ScaleMin{ 1.0f }, ScaleExtent{ 0.0f };
+
+	KeyFrame DecodeKey(std::size_t key) const;
+	std::size_t GetByteSize() const;
+};
+
+inline bool HasKeyFrames(const CompressedTrack& track) { return !track.Times.empty(); }
+
+struct CompressedClip
+{
+	std::vector<CompressedTrack> Tracks;
+	float Duration = 0.0f;
+
+	std::size_t GetByteSize() const;
+};
+
+struct ClipCompressionSettings
+{
+	// largest joint space error of a key. 0 is 1/1000 of ShellDistance
+	float Tolerance = 0.0f;
+	// distance of the points the error is measured on. 0 is the largest translation of the
+	// clip, about the size of the character in its own units
+	float ShellDistance = 0.0f;
+};
+
+struct ClipCompressionStats
+{
+	std::size_t OriginalKeys = 0;
+	std::size_t CompressedKeys = 0;
+	// the key frames as JointAnimation keeps them in memory, and compressed
+	std::size_t OriginalBytes = 0;
+	std::size_t CompressedBytes = 0;
+	// largest joint space error at the times of all the original keys, and its channel
+	float MaxError = 0.0f;
+	std::string MaxErrorChannel;
+	// the settings with the defaults resolved
+	float Tolerance = 0.0f;
+	float ShellDistance = 0.0f;
+
+	float GetRatio() const { return CompressedBytes > 0 ? (float)OriginalBytes / CompressedBytes : 0.0f; }
+};
+
+CompressedClip CompressClip(const std::vector<JointAnimation>& animation, const ClipCompressionSettings& settings = {}, ClipCompressionStats* stats = nullptr);
+
+// local transforms (skeleton order) of a compressed clip at time, same as SampleClip. Only the
+// two keys around time of every channel are decoded
+inline void SampleCompressedClip(const Skeleton& bones, const CompressedClip& clip, const std::vector<int>& jointChannels,
+	std::size_t* cursors, float time, glm::mat4* local)
+{
+	PoseBatch batch;
+	batch.Count = 0;
+
+	for (std::size_t i = 0; i < bones.GetJointCount(); ++i)
+	{
+		const int channel = jointChannels[i];
+		if (channel < 0 || clip.Tracks[channel].Times.empty())
+		{
+			local[i] = bones.LocalBindTransforms[i];
+			continue;
+		}
+
+		const CompressedTrack& track = clip.Tracks[channel];
+		AdvanceCursor(track.Times, cursors[i], time);
+		const KeyFrame previous = track.DecodeKey(cursors[i] > 0 ? cursors[i] - 1 : 0);
+		const KeyFrame next = track.DecodeKey(cursors[i] < track.Times.size() ? cursors[i] : track.Times.size() - 1);
+
+		batch.Add(previous, next, GetProgression(previous.TimeStamp, next.TimeStamp, time), (int)i);
+		if (batch.IsFull())
+		{
+			BlendPoseBatch(batch, local);
+			batch.Count = 0;
+		}
+	}
+
+	if (batch.Count > 0)
+		BlendPoseBatch(batch, local);
+}
@@ -0,0 +1,440 @@
+#include "PoseKernels.h"
+#include <cmath>
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define POSE_KERNELS_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+// msvc compiles avx intrinsics in any function
+#define POSE_KERNELS_AVX2_TARGET
+#else
+#include <cpuid.h>
+#define POSE_KERNELS_AVX2_TARGET __attribute__((target("avx2")))
+#endif
+#endif
+
+namespace
+{
+	// entry i of b interpolated
+	inline void InterpolateScalar(const PoseBatch& b, std::size_t i, glm::quat& q, glm::vec3& translation, glm::vec3& scale)
+	{
+		const float t = b.Progression[i];
+		q = ApproximateSlerp(glm::quat(b.Q0w[i], b.Q0x[i], b.Q0y[i], b.Q0z[i]), glm::quat(b.Q1w[i], b.Q1x[i], b.Q1y[i], b.Q1z[i]), t);
+		translation = glm::vec3(
+			b.T0x[i] + (b.T1x[i] - b.T0x[i]) * t,
+			b.T0y[i] + (b.T1y[i] - b.T0y[i]) * t,
+			b.T0z[i] + (b.T1z[i] - b.T0z[i]) * t);
+		scale = glm::vec3(
+			b.S0x[i] + (b.S1x[i] - b.S0x[i]) * t,
+			b.S0y[i] + (b.S1y[i] - b.S0y[i]) * t,
+			b.S0z[i] + (b.S1z[i] - b.S0z[i]) * t);
+	}
+
+	void BlendScalar(const PoseBatch& b, glm::mat4* out, std::size_t begin, std::size_t end)
+	{
+		for (std::size_t i = begin; i < end; ++i)
+		{
+			glm::quat q;
+			glm::vec3 translation, scale;
+			InterpolateScalar(b, i, q, translation, scale);
+			const float x = q.x, y = q.y, z = q.z, w = q.w;
+
+			// same as glm::toMat4, every column times its scale
+			const float xx = x * x, yy = y * y, zz = z * z;
+			const float xy = x * y, xz = x * z, yz = y * z;
+			const float wx = w * x, wy = w * y, wz = w * z;
+
+			glm::mat4& m = out[b.Targets[i]];
+			m[0] = glm::vec4((1.0f - 2.0f * (yy + zz)) * scale.x, 2.0f * (xy + wz) * scale.x, 2.0f * (xz - wy) * scale.x, 0.0f);
+			m[1] = glm::vec4(2.0f * (xy - wz) * scale.y, (1.0f - 2.0f * (xx + zz)) * scale.y, 2.0f * (yz + wx) * scale.y, 0.0f);
+			m[2] = glm::vec4(2.0f * (xz + wy) * scale.z, 2.0f * (yz - wx) * scale.z, (1.0f - 2.0f * (xx + yy)) * scale.z, 0.0f);
+			m[3] = glm::vec4(translation, 1.0f);
+		}
+	}
+
+	void AccumulateScalar(const PoseBatch& b, float weight, bool first, PoseBatch& sum, std::size_t begin, std::size_t end)
+	{
+		for (std::size_t i = begin; i < end; ++i)
+		{
+			glm::quat q;
+			glm::vec3 translation, scale;
+			InterpolateScalar(b, i, q, translation, scale);
+
+			if (first)
+			{
+				sum.Q0x[i] = q.x * weight; sum.Q0y[i] = q.y * weight; sum.Q0z[i] = q.z * weight; sum.Q0w[i] = q.w * weight;
+				sum.T0x[i] = translation.x * weight; sum.T0y[i] = translation.y * weight; sum.T0z[i] = translation.z * weight;
+				sum.S0x[i] = scale.x * weight; sum.S0y[i] = scale.y * weight; sum.S0z[i] = scale.z * weight;
+			}
+			else
+			{
+				const float dot = sum.Q0x[i] * q.x + sum.Q0y[i] * q.y + sum.Q0z[i] * q.z + sum.Q0w[i] * q.w;
+				if (std::signbit(dot))
+					q = -q;
+				sum.Q0x[i] = sum.Q0x[i] + q.x * weight; sum.Q0y[i] = sum.Q0y[i] + q.y * weight;
+				sum.Q0z[i] = sum.Q0z[i] + q.z * weight; sum.Q0w[i] = sum.Q0w[i] + q.w * weight;
+				sum.T0x[i] = sum.T0x[i] + translation.x * weight; sum.T0y[i] = sum.T0y[i] + translation.y * weight; sum.T0z[i] = sum.T0z[i] + translation.z * weight;
+				sum.S0x[i] = sum.S0x[i] + scale.x * weight; sum.S0y[i] = sum.S0y[i] + scale.y * weight; sum.S0z[i] = sum.S0z[i] + scale.z * weight;
+			}
+		}
+	}
+
+#ifdef POSE_KERNELS_X86
+	// 4 entries interpolated, one value per register
+	struct Lanes4
+	{
+		__m128 X, Y, Z, W;
+		__m128 Tx, Ty, Tz;
+		__m128 Sx, Sy, Sz;
+	};
+
+	inline __m128 Lerp4(const float* a, const float* b, __m128 t)
+	{
+		const __m128 va = _mm_loadu_ps(a);
+		return _mm_add_ps(va, _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(b), va), t));
+	}
+
+	inline Lanes4 Interpolate4(const PoseBatch& b, std::size_t i)
+	{
+		const __m128 sign = _mm_set1_ps(-0.0f);
+		const __m128 one = _mm_set1_ps(1.0f);
+
+		const __m128 t = _mm_loadu_ps(b.Progression + i);
+		const __m128 q0x = _mm_loadu_ps(b.Q0x + i), q0y = _mm_loadu_ps(b.Q0y + i), q0z = _mm_loadu_ps(b.Q0z + i), q0w = _mm_loadu_ps(b.Q0w + i);
+		__m128 q1x = _mm_loadu_ps(b.Q1x + i), q1y = _mm_loadu_ps(b.Q1y + i), q1z = _mm_loadu_ps(b.Q1z + i), q1w = _mm_loadu_ps(b.Q1w + i);
+
+		__m128 dot = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(q0x, q1x), _mm_mul_ps(q0y, q1y)), _mm_mul_ps(q0z, q1z)), _mm_mul_ps(q0w, q1w));
+		const __m128 flip = _mm_and_ps(dot, sign);
+		q1x = _mm_xor_ps(q1x, flip); q1y = _mm_xor_ps(q1y, flip); q1z = _mm_xor_ps(q1z, flip); q1w = _mm_xor_ps(q1w, flip);
+		dot = _mm_xor_ps(dot, flip);
+
+		const __m128 a = _mm_add_ps(_mm_set1_ps(OnlerpA0), _mm_mul_ps(dot, _mm_add_ps(_mm_set1_ps(OnlerpA1), _mm_mul_ps(dot, _mm_add_ps(_mm_set1_ps(OnlerpA2), _mm_mul_ps(dot, _mm_set1_ps(OnlerpA3)))))));
+		const __m128 c = _mm_add_ps(_mm_set1_ps(OnlerpB0), _mm_mul_ps(dot, _mm_add_ps(_mm_set1_ps(OnlerpB1), _mm_mul_ps(dot, _mm_set1_ps(OnlerpB2)))));
+		const __m128 h = _mm_sub_ps(t, _mm_set1_ps(0.5f));
+		const __m128 k = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(a, h), h), c);
+		const __m128 ot = _mm_add_ps(t, _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(t, h), _mm_sub_ps(t, one)), k));
+
+		Lanes4 p;
+		p.X = _mm_add_ps(q0x, _mm_mul_ps(_mm_sub_ps(q1x, q0x), ot));
+		p.Y = _mm_add_ps(q0y, _mm_mul_ps(_mm_sub_ps(q1y, q0y), ot));
+		p.Z = _mm_add_ps(q0z, _mm_mul_ps(_mm_sub_ps(q1z, q0z), ot));
+		p.W = _mm_add_ps(q0w, _mm_mul_ps(_mm_sub_ps(q1w, q0w), ot));
+		const __m128 len = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(p.X, p.X), _mm_mul_ps(p.Y, p.Y)), _mm_mul_ps(p.Z, p.Z)), _mm_mul_ps(p.W, p.W));
+		const __m128 inv = _mm_div_ps(one, _mm_sqrt_ps(len));
+		p.X = _mm_mul_ps(p.X, inv); p.Y = _mm_mul_ps(p.Y, inv); p.Z = _mm_mul_ps(p.Z, inv); p.W = _mm_mul_ps(p.W, inv);
+
+		p.Tx = Lerp4(b.T0x + i, b.T1x + i, t); p.Ty = Lerp4(b.T0y + i, b.T1y + i, t); p.Tz = Lerp4(b.T0z + i, b.T1z + i, t);
+		p.Sx = Lerp4(b.S0x + i, b.S1x + i, t); p.Sy = Lerp4(b.S0y + i, b.S1y + i, t); p.Sz = Lerp4(b.S0z + i, b.S1z + i, t);
+		return p;
+	}
+
+	// the twelve values of 4 joints, one register per value, transposed into their matrices
+	inline void Store4(const __m128* v, const int* targets, glm::mat4* out)
+	{
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 one = _mm_set1_ps(1.0f);
+		__m128 c[4][4];
+		for (int col = 0; col < 4; ++col)
+		{
+			c[col][0] = v[col * 3 + 0];
+			c[col][1] = v[col * 3 + 1];
+			c[col][2] = v[col * 3 + 2];
+			c[col][3] = col == 3 ? one : zero;
+			_MM_TRANSPOSE4_PS(c[col][0], c[col][1], c[col][2], c[col][3]);
+		}
+		for (int j = 0; j < 4; ++j)
+		{
+			float* m = &out[targets[j]][0][0];
+			for (int col = 0; col < 4; ++col)
+				_mm_storeu_ps(m + col * 4, c[col][j]);
+		}
+	}
+
+	inline void AccumulateValue4(float* sum, __m128 value, __m128 weight, bool first)
+	{
+		const __m128 weighted = _mm_mul_ps(value, weight);
+		_mm_storeu_ps(sum, first ? weighted : _mm_add_ps(_mm_loadu_ps(sum), weighted));
+	}
+
+	void BlendSSE2(const PoseBatch& b, glm::mat4* out, std::size_t count)
+	{
+		const __m128 one = _mm_set1_ps(1.0f);
+		const __m128 two = _mm_set1_ps(2.0f);
+
+		for (std::size_t i = 0; i + 4 <= count; i += 4)
+		{
+			const Lanes4 p = Interpolate4(b, i);
+			const __m128 xx = _mm_mul_ps(p.X, p.X), yy = _mm_mul_ps(p.Y, p.Y), zz = _mm_mul_ps(p.Z, p.Z);
+			const __m128 xy = _mm_mul_ps(p.X, p.Y), xz = _mm_mul_ps(p.X, p.Z), yz = _mm_mul_ps(p.Y, p.Z);
+			const __m128 wx = _mm_mul_ps(p.W, p.X), wy = _mm_mul_ps(p.W, p.Y), wz = _mm_mul_ps(p.W, p.Z);
+
+			__m128 v[12];
+			v[0] = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz))), p.Sx);
+			v[1] = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xy, wz)), p.Sx);
+			v[2] = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xz, wy)), p.Sx);
+			v[3] = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xy, wz)), p.Sy);
+			v[4] = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz))), p.Sy);
+			v[5] = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(yz, wx)), p.Sy);
+			v[6] = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xz, wy)), p.Sz);
+			v[7] = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(yz, wx)), p.Sz);
+			v[8] = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy))), p.Sz);
+			v[9] = p.Tx;
+			v[10] = p.Ty;
+			v[11] = p.Tz;
+			Store4(v, b.Targets + i, out);
+		}
+	}
+
+	void AccumulateSSE2(const PoseBatch& b, float weight, bool first, PoseBatch& sum, std::size_t count)
+	{
+		const __m128 w = _mm_set1_ps(weight);
+		for (std::size_t i = 0; i + 4 <= count; i += 4)
+		{
+			Lanes4 p = Interpolate4(b, i);
+			if (!first)
+			{
+				const __m128 dot = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(sum.Q0x + i), p.X), _mm_mul_ps(_mm_loadu_ps(sum.Q0y + i), p.Y)),
+					_mm_mul_ps(_mm_loadu_ps(sum.Q0z + i), p.Z)), _mm_mul_ps(_mm_loadu_ps(sum.Q0w + i), p.W));
+				const __m128 flip = _mm_and_ps(dot, _mm_set1_ps(-0.0f));
+				p.X = _mm_xor_ps(p.X, flip); p.Y = _mm_xor_ps(p.Y, flip); p.Z = _mm_xor_ps(p.Z, flip); p.W = _mm_xor_ps(p.W, flip);
+			}
+			AccumulateValue4(sum.Q0x + i, p.X, w, first); AccumulateValue4(sum.Q0y + i, p.Y, w, first);
+			AccumulateValue4(sum.Q0z + i, p.Z, w, first); AccumulateValue4(sum.Q0w + i, p.W, w, first);
+			AccumulateValue4(sum.T0x + i, p.Tx, w, first); AccumulateValue4(sum.T0y + i, p.Ty, w, first); AccumulateValue4(sum.T0z + i, p.Tz, w, first);
+			AccumulateValue4(sum.S0x + i, p.Sx, w, first); AccumulateValue4(sum.S0y + i, p.Sy, w, first); AccumulateValue4(sum.S0z + i, p.Sz, w, first);
+		}
+	}
+
+	// 8 entries interpolated, one value per register
+	struct Lanes8
+	{
+		__m256 X, Y, Z, W;
+		__m256 Tx, Ty, Tz;
+		__m256 Sx, Sy, Sz;
+	};
+
+	POSE_KERNELS_AVX2_TARGET inline __m256 Lerp8(const float* a, const float* b, __m256 t)
+	{
+		const __m256 va = _mm256_loadu_ps(a);
+		return _mm256_add_ps(va, _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(b), va), t));
+	}
+
+	POSE_KERNELS_AVX2_TARGET inline Lanes8 Interpolate8(const PoseBatch& b, std::size_t i)
+	{
+		const __m256 sign = _mm256_set1_ps(-0.0f);
+		const __m256 one = _mm256_set1_ps(1.0f);
+
+		const __m256 t = _mm256_loadu_ps(b.Progression + i);
+		const __m256 q0x = _mm256_loadu_ps(b.Q0x + i), q0y = _mm256_loadu_ps(b.Q0y + i), q0z = _mm256_loadu_ps(b.Q0z + i), q0w = _mm256_loadu_ps(b.Q0w + i);
+		__m256 q1x = _mm256_loadu_ps(b.Q1x + i), q1y = _mm256_loadu_ps(b.Q1y + i), q1z = _mm256_loadu_ps(b.Q1z + i), q1w = _mm256_loadu_ps(b.Q1w + i);
+
+		__m256 dot = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(q0x, q1x), _mm256_mul_ps(q0y, q1y)), _mm256_mul_ps(q0z, q1z)), _mm256_mul_ps(q0w, q1w));
+		const __m256 flip = _mm256_and_ps(dot, sign);
+		q1x = _mm256_xor_ps(q1x, flip); q1y = _mm256_xor_ps(q1y, flip); q1z = _mm256_xor_ps(q1z, flip); q1w = _mm256_xor_ps(q1w, flip);
+		dot = _mm256_xor_ps(dot, flip);
+
+		const __m256 a = _mm256_add_ps(_mm256_set1_ps(OnlerpA0), _mm256_mul_ps(dot, _mm256_add_ps(_mm256_set1_ps(OnlerpA1), _mm256_mul_ps(dot, _mm256_add_ps(_mm256_set1_ps(OnlerpA2), _mm256_mul_ps(dot, _mm256_set1_ps(OnlerpA3)))))));
+		const __m256 c = _mm256_add_ps(_mm256_set1_ps(OnlerpB0), _mm256_mul_ps(dot, _mm256_add_ps(_mm256_set1_ps(OnlerpB1), _mm256_mul_ps(dot, _mm256_set1_ps(OnlerpB2)))));
+		const __m256 h = _mm256_sub_ps(t, _mm256_set1_ps(0.5f));
+		const __m256 k = _mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(a, h), h), c);
+		const __m256 ot = _mm256_add_ps(t, _mm256_mul_ps(_mm256_mul_ps(_mm256_mul_ps(t, h), _mm256_sub_ps(t, one)), k));
+
+		Lanes8 p;
+		p.X = _mm256_add_ps(q0x, _mm256_mul_ps(_mm256_sub_ps(q1x, q0x), ot));
+		p.Y = _mm256_add_ps(q0y, _mm256_mul_ps(_mm256_sub_ps(q1y, q0y), ot));
+		p.Z = _mm256_add_ps(q0z, _mm256_mul_ps(_mm256_sub_ps(q1z, q0z), ot));
+		p.W = _mm256_add_ps(q0w, _mm256_mul_ps(_mm256_sub_ps(q1w, q0w), ot));
+		const __m256 len = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(p.X, p.X), _mm256_mul_ps(p.Y, p.Y)), _mm256_mul_ps(p.Z, p.Z)), _mm256_mul_ps(p.W, p.W));
+		const __m256 inv = _mm256_div_ps(one, _mm256_sqrt_ps(len));
+		p.X = _mm256_mul_ps(p.X, inv); p.Y = _mm256_mul_ps(p.Y, inv); p.Z = _mm256_mul_ps(p.Z, inv); p.W = _mm256_mul_ps(p.W, inv);
+
+		p.Tx = Lerp8(b.T0x + i, b.T1x + i, t); p.Ty = Lerp8(b.T0y + i, b.T1y + i, t); p.Tz = Lerp8(b.T0z + i, b.T1z + i, t);
+		p.Sx = Lerp8(b.S0x + i, b.S1x + i, t); p.Sy = Lerp8(b.S0y + i, b.S1y + i, t); p.Sz = Lerp8(b.S0z + i, b.S1z + i, t);
+		return p;
+	}
+
+	POSE_KERNELS_AVX2_TARGET inline void AccumulateValue8(float* sum, __m256 value, __m256 weight, bool first)
+	{
+		const __m256 weighted = _mm256_mul_ps(value, weight);
+		_mm256_storeu_ps(sum, first ? weighted : _mm256_add_ps(_mm256_loadu_ps(sum), weighted));
+	}
+
+	POSE_KERNELS_AVX2_TARGET void BlendAVX2(const PoseBatch& b, glm::mat4* out, std::size_t count)
+	{
+		const __m256 one = _mm256_set1_ps(1.0f);
+		const __m256 two = _mm256_set1_ps(2.0f);
+
+		for (std::size_t i = 0; i + 8 <= count; i += 8)
+		{
+			const Lanes8 p = Interpolate8(b, i);
+			const __m256 xx = _mm256_mul_ps(p.X, p.X), yy = _mm256_mul_ps(p.Y, p.Y), zz = _mm256_mul_ps(p.Z, p.Z);
+			const __m256 xy = _mm256_mul_ps(p.X, p.Y), xz = _mm256_mul_ps(p.X, p.Z), yz = _mm256_mul_ps(p.Y, p.Z);
+			const __m256 wx = _mm256_mul_ps(p.W, p.X), wy = _mm256_mul_ps(p.W, p.Y), wz = _mm256_mul_ps(p.W, p.Z);
+
+			__m256 v[12];
+			v[0] = _mm256_mul_ps(_mm256_sub_ps(one, _mm256_mul_ps(two, _mm256_add_ps(yy, zz))), p.Sx);
+			v[1] = _mm256_mul_ps(_mm256_mul_ps(two, _mm256_add_ps(xy, wz)), p.Sx);
+			v[2] = _mm256_mul_ps(_mm256_mul_ps(two, _mm256_sub_ps(xz, wy)), p.Sx);
+			v[3] = _mm256_mul_ps(_mm256_mul_ps(two, _mm256_sub_ps(xy, wz)), p.Sy);
+			v[4] = _mm256_mul_ps(_mm256_sub_ps(one, _mm256_mul_ps(two, _mm256_add_ps(xx, zz))), p.Sy);
+			v[5] = _mm256_mul_ps(_mm256_mul_ps(two, _mm256_add_ps(yz, wx)), p.Sy);
+			v[6] = _mm256_mul_ps(_mm256_mul_ps(two, _mm256_add_ps(xz, wy)), p.Sz);
+			v[7] = _mm256_mul_ps(_mm256_mul_ps(two, _mm256_sub_ps(yz, wx)), p.Sz);
+			v[8] = _mm256_mul_ps(_mm256_sub_ps(one, _mm256_mul_ps(two, _mm256_add_ps(xx, yy))), p.Sz);
+			v[9] = p.Tx;
+			v[10] = p.Ty;
+			v[11] = p.Tz;
+
+			// two groups of 4 joints
+			__m128 low[12], high[12];
+			for (int n = 0; n < 12; ++n)
+			{
+				low[n] = _mm256_castps256_ps128(v[n]);
+				high[n] = _mm256_extractf128_ps(v[n], 1);
+			}
+			Store4(low, b.Targets + i, out);
+			Store4(high, b.Targets + i + 4, out);
+		}
+	}
+
+	POSE_KERNELS_AVX2_TARGET void AccumulateAVX2(const PoseBatch& b, float weight, bool first, PoseBatch& sum, std::size_t count)
+	{
+		const __m256 w = _mm256_set1_ps(weight);
+		for (std::size_t i = 0; i + 8 <= count; i += 8)
+		{
+			Lanes8 p = Interpolate8(b, i);
+			if (!first)
+			{
+				const __m256 dot = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(sum.Q0x + i), p.X), _mm256_mul_ps(_mm256_loadu_ps(sum.Q0y + i), p.Y)),
+					_mm256_mul_ps(_mm256_loadu_ps(sum.Q0z + i), p.Z)), _mm256_mul_ps(_mm256_loadu_ps(sum.Q0w + i), p.W));
+				const __m256 flip = _mm256_and_ps(dot, _mm256_set1_ps(-0.0f));
+				p.X = _mm256_xor_ps(p.X, flip); p.Y = _mm256_xor_ps(p.Y, flip); p.Z = _mm256_xor_ps(p.Z, flip); p.W = _mm256_xor_ps(p.W, flip);
+			}
+			AccumulateValue8(sum.Q0x + i, p.X, w, first); AccumulateValue8(sum.Q0y + i, p.Y, w, first);
+			AccumulateValue8(sum.Q0z + i, p.Z, w, first); AccumulateValue8(sum.Q0w + i, p.W, w, first);
+			AccumulateValue8(sum.T0x + i, p.Tx, w, first); AccumulateValue8(sum.T0y + i, p.Ty, w, first); AccumulateValue8(sum.T0z + i, p.Tz, w, first);
+			AccumulateValue8(sum.S0x + i, p.Sx, w, first); AccumulateValue8(sum.S0y + i, p.Sy, w, first); AccumulateValue8(sum.S0z + i, p.Sz, w, first);
+		}
+	}
+
+	bool CpuHasAVX2()
+	{
+#if defined(_MSC_VER)
+		int info[4];
+		__cpuid(info, 0);
+		if (info[0] < 7) return false;
+		__cpuid(info, 1);
+		// the os saves the ymm registers
+		const bool osxsave = (info[2] & (1 << 27)) != 0 && (info[2] & (1 << 28)) != 0;
+		if (!osxsave || (_xgetbv(0) & 6) != 6) return false;
+		__cpuidex(info, 7, 0);
+		return (info[1] & (1 << 5)) != 0;
+#else
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("avx2") != 0;
+#endif
+	}
+
+	bool CpuHasSSE2()
+	{
+#if defined(_M_X64) || defined(__x86_64__)
+		return true;
+#elif defined(_MSC_VER)
+		int info[4];
+		__cpuid(info, 1);
+		return (info[3] & (1 << 26)) != 0;
+#else
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("sse2") != 0;
+#endif
+	}
+#endif
+}
+
+PoseKernelIsa GetPoseKernelIsa()
+{
+	static const PoseKernelIsa best = IsPoseKernelIsaSupported(PoseKernelIsa::AVX2) ? PoseKernelIsa::AVX2
+		: IsPoseKernelIsaSupported(PoseKernelIsa::SSE2) ? PoseKernelIsa::SSE2 : PoseKernelIsa::Scalar;
+	return best;
+}
+
+bool IsPoseKernelIsaSupported(PoseKernelIsa isa)
+{
+	switch (isa)
+	{
+#ifdef POSE_KERNELS_X86
+	case PoseKernelIsa::AVX2: return CpuHasAVX2();
+	case PoseKernelIsa::SSE2: return CpuHasSSE2();
+#endif
+	case PoseKernelIsa::Scalar: return true;
+	default: return false;
+	}
+}
+
+const char* GetPoseKernelIsaName(PoseKernelIsa isa)
+{
+	switch (isa)
+	{
+	case PoseKernelIsa::AVX2: return "AVX2";
+	case PoseKernelIsa::SSE2: return "SSE2";
+	default: return "Scalar";
+	}
+}
+
+void BlendPoseBatch(const PoseBatch& batch, glm::mat4* out)
+{
+	BlendPoseBatch(batch, out, GetPoseKernelIsa());
+}
+
+void BlendPoseBatch(const PoseBatch& batch, glm::mat4* out, PoseKernelIsa isa)
+{
+	// the entries that don't fill a whole register go through the scalar kernel
+	std::size_t done = 0;
+#ifdef POSE_KERNELS_X86
+	if (isa == PoseKernelIsa::AVX2)
+	{
+		BlendAVX2(batch, out, batch.Count);
+		done = batch.Count & ~std::size_t(7);
+	}
+	else if (isa == PoseKernelIsa::SSE2)
+	{
+		BlendSSE2(batch, out, batch.Count);
+		done = batch.Count & ~std::size_t(3);
+	}
+#endif
+	BlendScalar(batch, out, done, batch.Count);
+}
+
+void AccumulatePoseBatch(const PoseBatch& batch, float weight, bool first, PoseBatch& sum)
+{
+	AccumulatePoseBatch(batch, weight, first, sum, GetPoseKernelIsa());
+}
+
+void AccumulatePoseBatch(const PoseBatch& batch, float weight, bool first, PoseBatch& sum, PoseKernelIsa isa)
+{
+	std::size_t done = 0;
+#ifdef POSE_KERNELS_X86
+	if (isa == PoseKernelIsa::AVX2)
+	{
+		AccumulateAVX2(batch, weight, first, sum, batch.Count);
+		done = batch.Count & ~std::size_t(7);
+	}
+	else if (isa == PoseKernelIsa::SSE2)
+	{
+		AccumulateSSE2(batch, weight, first, sum, batch.Count);
+		done = batch.Count & ~std::size_t(3);
+	}
+#endif
+	AccumulateScalar(batch, weight, first, sum, done, batch.Count);
+
+	// pairs of the same key at progression 0, ready for BlendPoseBatch
+	const std::size_t bytes = batch.Count * sizeof(float);
+	std::memcpy(sum.Q1x, sum.Q0x, bytes); std::memcpy(sum.Q1y, sum.Q0y, bytes); std::memcpy(sum.Q1z, sum.Q0z, bytes); std::memcpy(sum.Q1w, sum.Q0w, bytes);
+	std::memcpy(sum.T1x, sum.T0x, bytes); std::memcpy(sum.T1y, sum.T0y, bytes); std::memcpy(sum.T1z, sum.T0z, bytes);
+	std::memcpy(sum.S1x, sum.S0x, bytes); std::memcpy(sum.S1y, sum.S0y, bytes); std::memcpy(sum.S1z, sum.S0z, bytes);
+	std::memset(sum.Progression, 0, bytes);
+	std::memcpy(sum.Targets, batch.Targets, batch.Count * sizeof(int));
+	sum.Count = batch.Count;
+}
@@ -0,0 +1,100 @@
+#pragma once
+#include <cmath>
+#include <cstddef>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include "../app/JointAnimation.h"
+
+// Blending of key frame pairs into local joint matrices, 4 (SSE2) or 8 (AVX2) joints at a time.
+// The pairs are gathered in a PoseBatch (structure of arrays) and BlendPoseBatch writes
+// translation * rotation * scale of every entry into out[Targets[i]].
+//
+// The rotation is an nlerp with a corrected factor (the "onlerp" approximation of slerp,
+// taking the shortest path like glm::slerp) followed by an exact normalize, so there is no
+// acos or sin. Against the glm path (SampleKeyFrames) every element of the rotation part
+// stays within 1e-4 times the scale of its column, whatever the angle between the keys; the
+// translation and scale are the same lerp up to rounding. The scalar, SSE2 and AVX2 kernels
+// do the same operations in the same order and give the same bits.
+
+enum class PoseKernelIsa { Scalar, SSE2, AVX2 };
+
+// onlerp coefficients, fitted for |cos| of the angle between the quaternions
+const float OnlerpA0 = 1.0904f, OnlerpA1 = -3.2452f, OnlerpA2 = 3.55645f, OnlerpA3 = -1.43519f;
+const float OnlerpB0 = 0.848013f, OnlerpB1 = -1.06021f, OnlerpB2 = 0.215638f;
+
+// the rotation of the kernels for one pair, unit length. Same bits as BlendPoseBatch
+inline glm::quat ApproximateSlerp(const glm::quat& q0, const glm::quat& q1, float t)
+{
+	// shortest path: flip the next rotation when the dot is negative
+	float q1x = q1.x, q1y = q1.y, q1z = q1.z, q1w = q1.w;
+	float dot = q0.x * q1x + q0.y * q1y + q0.z * q1z + q0.w * q1w;
+	if (std::signbit(dot))
+	{
+		q1x = -q1x; q1y = -q1y; q1z = -q1z; q1w = -q1w;
+		dot = -dot;
+	}
+
+	const float a = OnlerpA0 + dot * (OnlerpA1 + dot * (OnlerpA2 + dot * OnlerpA3));
+	const float c = OnlerpB0 + dot * (OnlerpB1 + dot * OnlerpB2);
+	const float h = t - 0.5f;
+	const float k = a * h * h + c;
+	const float ot = t + t * h * (t - 1.0f) * k;
+
+	float x = q0.x + (q1x - q0.x) * ot;
+	float y = q0.y + (q1y - q0.y) * ot;
+	float z = q0.z + (q1z - q0.z) * ot;
+	float w = q0.w + (q1w - q0.w) * ot;
+	const float inv = 1.0f / std::sqrt(x * x + y * y + z * z + w * w);
+	return glm::quat(w * inv, x * inv, y * inv, z * inv);
+}
+
+struct PoseBatch
+{
+	static constexpr std::size_t Capacity = 64;
+
+	// previous (0) and next (1) key frame of every entry
+	float Q0x[Capacity], Q0y[Capacity], Q0z[Capacity], Q0w[Capacity];
+	float Q1x[Capacity], Q1y[Capacity], Q1z[Capacity], Q1w[Capacity];
+	float T0x[Capacity], T0y[Capacity], T0z[Capacity];
+	float T1x[Capacity], T1y[Capacity], T1z[Capacity];
+	float S0x[Capacity], S0y[Capacity], S0z[Capacity];
+	float S1x[Capacity], S1y[Capacity], S1z[Capacity];
+	// interpolation factor between the two key frames
+	float Progression[Capacity];
+	// index of the output matrix of every entry
+	int Targets[Capacity];
+	// the arrays are not initialized, only the first Count entries are valid
+	std::size_t Count;
+
+	void Add(const KeyFrame& previous, const KeyFrame& next, float progression, int target)
+	{
+		const std::size_t i = Count++;
+		Q0x[i] = previous.Rotation.x; Q0y[i] = previous.Rotation.y; Q0z[i] = previous.Rotation.z; Q0w[i] = previous.Rotation.w;
+		Q1x[i] = next.Rotation.x; Q1y[i] = next.Rotation.y; Q1z[i] = next.Rotation.z; Q1w[i] = next.Rotation.w;
+		T0x[i] = previous.Translation.x; T0y[i] = previous.Translation.y; T0z[i] = previous.Translation.z;
+		T1x[i] = next.Translation.x; T1y[i] = next.Translation.y; T1z[i] = next.Translation.z;
+		S0x[i] = previous.Scale.x; S0y[i] = previous.Scale.y; S0z[i] = previous.Scale.z;
+		S1x[i] = next.Scale.x; S1y[i] = next.Scale.y; S1z[i] = next.Scale.z;
+		Progression[i] = progression;
+		Targets[i] = target;
+	}
+
+	bool IsFull() const { return Count == Capacity; }
+};
+
+// the best kernel this cpu runs, checked once
+PoseKernelIsa GetPoseKernelIsa();
+bool IsPoseKernelIsaSupported(PoseKernelIsa isa);
+const char* GetPoseKernelIsaName(PoseKernelIsa isa);
+
+// with the kernel of GetPoseKernelIsa()
+void BlendPoseBatch(const PoseBatch& batch, glm::mat4* out);
+// with a given kernel (benchmarks, tests), it must be supported
+void BlendPoseBatch(const PoseBatch& batch, glm::mat4* out, PoseKernelIsa isa);
+
+// weighted sum of poses for blending: entry i of sum += weight * entry i of batch interpolated
+// (first sets it instead). The rotations are added on the side of the sum, q and -q being the
+// same rotation, and left unnormalized. sum holds pairs of the same key with the Targets of
+// batch, BlendPoseBatch(sum, out) normalizes them and writes the matrices of the blend
+void AccumulatePoseBatch(const PoseBatch& batch, float weight, bool first, PoseBatch& sum);
+void AccumulatePoseBatch(const PoseBatch& batch, float weight, bool first, PoseBatch& sum, PoseKernelIsa isa);
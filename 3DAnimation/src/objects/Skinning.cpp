@@ -0,0 +1,575 @@
+#include "Skinning.h"
+#include <cmath>
+#include <iostream>
+#include <algorithm>
+#include <glm/gtc/quaternion.hpp>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define SKINNING_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#define SKINNING_AVX2_TARGET
+#else
+#define SKINNING_AVX2_TARGET __attribute__((target("avx2")))
+#endif
+#endif
+
+SkinningMesh SkinningMesh::FromMeshData(const SkinnedMeshData& data, const Skeleton& skeleton)
+{
+	SkinningMesh mesh;
+	mesh.BindShapeMatrix = data.Skin.BindShapeMatrix;
+	for (std::size_t k = 0; k < data.Skin.JointNames.size(); ++k)
+	{
+		const int joint = skeleton.FindJoint(data.Skin.JointNames[k]);
+		if (joint < 0)
+			std::cerr << "[Skinning]: joint " << data.Skin.JointNames[k] << " of " << data.Name << " is not in the skeleton, it keeps the bind pose" << std::endl;
+		mesh.JointMap.push_back(joint);
+		const glm::mat4 inverseBind = k < data.Skin.InverseBindMatrices.size() ? data.Skin.InverseBindMatrices[k] : glm::mat4(1.0f);
+		mesh.BindMatrices.push_back(inverseBind * data.Skin.BindShapeMatrix);
+	}
+	// a skin without joints still draws its mesh
+	if (mesh.JointMap.empty())
+	{
+		mesh.JointMap.push_back(-1);
+		mesh.BindMatrices.push_back(data.Skin.BindShapeMatrix);
+	}
+
+	const std::size_t count = data.Vertices.size();
+	mesh.PositionX.resize(count); mesh.PositionY.resize(count); mesh.PositionZ.resize(count);
+	mesh.NormalX.resize(count); mesh.NormalY.resize(count); mesh.NormalZ.resize(count);
+	for (int k = 0; k < 4; ++k)
+	{
+		mesh.Joints[k].assign(count, 0);
+		mesh.Weights[k].assign(count, 0.0f);
+	}
+
+	for (std::size_t i = 0; i < count; ++i)
+	{
+		const Vertex& v = data.Vertices[i];
+		mesh.PositionX[i] = v.position.x; mesh.PositionY[i] = v.position.y; mesh.PositionZ[i] = v.position.z;
+		mesh.NormalX[i] = v.normals.x; mesh.NormalY[i] = v.normals.y; mesh.NormalZ[i] = v.normals.z;
+
+		const glm::ivec4 joints = i < data.JointIndices.size() ? data.JointIndices[i] : glm::ivec4(0);
+		const glm::vec4 weights = i < data.JointWeights.size() ? data.JointWeights[i] : glm::vec4(1.0f, 0.0f, 0.0f, 0.0f);
+		for (int k = 0; k < 4; ++k)
+		{
+			// the kernels read every influence, the ones out of the skin weigh nothing
+			const bool valid = joints[k] >= 0 && (std::size_t)joints[k] < mesh.JointMap.size();
+			mesh.Joints[k][i] = valid ? joints[k] : 0;
+			mesh.Weights[k][i] = valid ? weights[k] : 0.0f;
+		}
+	}
+	return mesh;
+}
+
+void ComputeSkinningMatrices(const SkinningMesh& mesh, const glm::mat4* globalPose, glm::mat4* skinMatrices)
+{
+	for (std::size_t k = 0; k < mesh.JointMap.size(); ++k)
+	{
+		const int joint = mesh.JointMap[k];
+		skinMatrices[k] = joint >= 0 ? globalPose[joint] * mesh.BindMatrices[k] : mesh.BindShapeMatrix;
+	}
+}
+
+namespace
+{
+	// the reference, the SIMD kernels follow its order of operations
+	void SkinScalar(const SkinningMesh& mesh, const glm::mat4* skin, std::size_t begin, std::size_t end, glm::vec4* positions, glm::vec4* normals)
+	{
+		for (std::size_t i = begin; i < end; ++i)
+		{
+			const float w0 = mesh.Weights[0][i], w1 = mesh.Weights[1][i], w2 = mesh.Weights[2][i], w3 = mesh.Weights[3][i];
+			const glm::mat4& m0 = skin[mesh.Joints[0][i]];
+			const glm::mat4& m1 = skin[mesh.Joints[1][i]];
+			const glm::mat4& m2 = skin[mesh.Joints[2][i]];
+			const glm::mat4& m3 = skin[mesh.Joints[3][i]];
+
+			float m[4][3];
+			for (int c = 0; c < 4; ++c)
+			{
+				for (int r = 0; r < 3; ++r)
+					m[c][r] = ((w0 * m0[c][r] + w1 * m1[c][r]) + w2 * m2[c][r]) + w3 * m3[c][r];
+			}
+
+			const float x = mesh.PositionX[i], y = mesh.PositionY[i], z = mesh.PositionZ[i];
+			const float nx = mesh.NormalX[i], ny = mesh.NormalY[i], nz = mesh.NormalZ[i];
+			float p[3], n[3];
+			for (int r = 0; r < 3; ++r)
+			{
+				p[r] = ((m[0][r] * x + m[1][r] * y) + m[2][r] * z) + m[3][r];
+				n[r] = (m[0][r] * nx + m[1][r] * ny) + m[2][r] * nz;
+			}
+
+			// normals of zero length (a mesh without normals) stay zero
+			const float length = (n[0] * n[0] + n[1] * n[1]) + n[2] * n[2];
+			const float inv = length > 0.0f ? 1.0f / std::sqrt(length) : 0.0f;
+			positions[i] = glm::vec4(p[0], p[1], p[2], 1.0f);
+			normals[i] = glm::vec4(n[0] * inv, n[1] * inv, n[2] * inv, 0.0f);
+		}
+	}
+
+#ifdef SKINNING_X86
+	// one vertex at a time, the columns of the blended matrix in a register each
+	void SkinSSE2(const SkinningMesh& mesh, const glm::mat4* skin, std::size_t begin, std::size_t end, glm::vec4* positions, glm::vec4* normals)
+	{
+		const __m128 one = _mm_set_ps(1.0f, 0.0f, 0.0f, 0.0f);
+		const __m128 xyz = _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1));
+		const __m128 zero = _mm_setzero_ps();
+
+		for (std::size_t i = begin; i < end; ++i)
+		{
+			const __m128 w0 = _mm_set1_ps(mesh.Weights[0][i]), w1 = _mm_set1_ps(mesh.Weights[1][i]);
+			const __m128 w2 = _mm_set1_ps(mesh.Weights[2][i]), w3 = _mm_set1_ps(mesh.Weights[3][i]);
+			const float* m0 = &skin[mesh.Joints[0][i]][0][0];
+			const float* m1 = &skin[mesh.Joints[1][i]][0][0];
+			const float* m2 = &skin[mesh.Joints[2][i]][0][0];
+			const float* m3 = &skin[mesh.Joints[3][i]][0][0];
+
+			__m128 c[4];
+			for (int col = 0; col < 4; ++col)
+			{
+				c[col] = _mm_add_ps(_mm_add_ps(_mm_add_ps(
+					_mm_mul_ps(w0, _mm_loadu_ps(m0 + col * 4)), _mm_mul_ps(w1, _mm_loadu_ps(m1 + col * 4))),
+					_mm_mul_ps(w2, _mm_loadu_ps(m2 + col * 4))), _mm_mul_ps(w3, _mm_loadu_ps(m3 + col * 4)));
+			}
+
+			const __m128 x = _mm_set1_ps(mesh.PositionX[i]), y = _mm_set1_ps(mesh.PositionY[i]), z = _mm_set1_ps(mesh.PositionZ[i]);
+			const __m128 nx = _mm_set1_ps(mesh.NormalX[i]), ny = _mm_set1_ps(mesh.NormalY[i]), nz = _mm_set1_ps(mesh.NormalZ[i]);
+			const __m128 p = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(c[0], x), _mm_mul_ps(c[1], y)), _mm_mul_ps(c[2], z)), c[3]);
+			const __m128 n = _mm_and_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(c[0], nx), _mm_mul_ps(c[1], ny)), _mm_mul_ps(c[2], nz)), xyz);
+
+			// (x * x + y * y) + z * z in every lane
+			const __m128 squares = _mm_mul_ps(n, n);
+			const __m128 length = _mm_add_ps(_mm_add_ps(squares, _mm_shuffle_ps(squares, squares, _MM_SHUFFLE(3, 0, 0, 1))), _mm_shuffle_ps(squares, squares, _MM_SHUFFLE(3, 2, 2, 2)));
+			const __m128 lengthX = _mm_shuffle_ps(length, length, _MM_SHUFFLE(0, 0, 0, 0));
+			const __m128 inv = _mm_and_ps(_mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(lengthX)), _mm_cmpgt_ps(lengthX, zero));
+
+			_mm_storeu_ps(&positions[i][0], _mm_or_ps(_mm_and_ps(p, xyz), one));
+			_mm_storeu_ps(&normals[i][0], _mm_mul_ps(n, inv));
+		}
+	}
+
+	// 8 vertices at a time, element (c, r) of the four skinning matrices gathered per register
+	SKINNING_AVX2_TARGET void SkinAVX2(const SkinningMesh& mesh, const glm::mat4* skin, std::size_t begin, std::size_t end, glm::vec4* positions, glm::vec4* normals)
+	{
+		const float* base = &skin[0][0][0];
+		const __m256 zero = _mm256_setzero_ps();
+		const __m256 one = _mm256_set1_ps(1.0f);
+
+		std::size_t i = begin;
+		for (; i + 8 <= end; i += 8)
+		{
+			__m256i joints[4];
+			__m256 weights[4];
+			for (int k = 0; k < 4; ++k)
+			{
+				// a matrix is 16 floats
+				joints[k] = _mm256_slli_epi32(_mm256_loadu_si256((const __m256i*)(mesh.Joints[k].data() + i)), 4);
+				weights[k] = _mm256_loadu_ps(mesh.Weights[k].data() + i);
+			}
+
+			__m256 m[4][3];
+			for (int c = 0; c < 4; ++c)
+			{
+				for (int r = 0; r < 3; ++r)
+				{
+					const float* element = base + c * 4 + r;
+					m[c][r] = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(
+						_mm256_mul_ps(weights[0], _mm256_i32gather_ps(element, joints[0], 4)),
+						_mm256_mul_ps(weights[1], _mm256_i32gather_ps(element, joints[1], 4))),
+						_mm256_mul_ps(weights[2], _mm256_i32gather_ps(element, joints[2], 4))),
+						_mm256_mul_ps(weights[3], _mm256_i32gather_ps(element, joints[3], 4)));
+				}
+			}
+
+			const __m256 x = _mm256_loadu_ps(mesh.PositionX.data() + i), y = _mm256_loadu_ps(mesh.PositionY.data() + i), z = _mm256_loadu_ps(mesh.PositionZ.data() + i);
+			const __m256 nx = _mm256_loadu_ps(mesh.NormalX.data() + i), ny = _mm256_loadu_ps(mesh.NormalY.data() + i), nz = _mm256_loadu_ps(mesh.NormalZ.data() + i);
+			__m256 p[3], n[3];
+			for (int r = 0; r < 3; ++r)
+			{
+				p[r] = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m[0][r], x), _mm256_mul_ps(m[1][r], y)), _mm256_mul_ps(m[2][r], z)), m[3][r]);
+				n[r] = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m[0][r], nx), _mm256_mul_ps(m[1][r], ny)), _mm256_mul_ps(m[2][r], nz));
+			}
+			const __m256 length = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(n[0], n[0]), _mm256_mul_ps(n[1], n[1])), _mm256_mul_ps(n[2], n[2]));
+			const __m256 inv = _mm256_and_ps(_mm256_div_ps(one, _mm256_sqrt_ps(length)), _mm256_cmp_ps(length, zero, _CMP_GT_OQ));
+			for (int r = 0; r < 3; ++r)
+				n[r] = _mm256_mul_ps(n[r], inv);
+
+			// back to one vec4 per vertex, 4 vertices per transpose
+			for (int half = 0; half < 2; ++half)
+			{
+				__m128 px = half ? _mm256_extractf128_ps(p[0], 1) : _mm256_castps256_ps128(p[0]);
+				__m128 py = half ? _mm256_extractf128_ps(p[1], 1) : _mm256_castps256_ps128(p[1]);
+				__m128 pz = half ? _mm256_extractf128_ps(p[2], 1) : _mm256_castps256_ps128(p[2]);
+				__m128 pw = _mm_set1_ps(1.0f);
+				__m128 qx = half ? _mm256_extractf128_ps(n[0], 1) : _mm256_castps256_ps128(n[0]);
+				__m128 qy = half ? _mm256_extractf128_ps(n[1], 1) : _mm256_castps256_ps128(n[1]);
+				__m128 qz = half ? _mm256_extractf128_ps(n[2], 1) : _mm256_castps256_ps128(n[2]);
+				__m128 qw = _mm_setzero_ps();
+				_MM_TRANSPOSE4_PS(px, py, pz, pw);
+				_MM_TRANSPOSE4_PS(qx, qy, qz, qw);
+
+				glm::vec4* pos = positions + i + half * 4;
+				glm::vec4* nrm = normals + i + half * 4;
+				_mm_storeu_ps(&pos[0][0], px); _mm_storeu_ps(&pos[1][0], py); _mm_storeu_ps(&pos[2][0], pz); _mm_storeu_ps(&pos[3][0], pw);
+				_mm_storeu_ps(&nrm[0][0], qx); _mm_storeu_ps(&nrm[1][0], qy); _mm_storeu_ps(&nrm[2][0], qz); _mm_storeu_ps(&nrm[3][0], qw);
+			}
+		}
+		SkinSSE2(mesh, skin, i, end, positions, normals);
+	}
+#endif
+}
+
+void SkinVertices(const SkinningMesh& mesh, const glm::mat4* skinMatrices, std::size_t begin, std::size_t end,
+	glm::vec4* positions, glm::vec4* normals)
+{
+	SkinVertices(mesh, skinMatrices, begin, end, positions, normals, GetPoseKernelIsa());
+}
+
+void SkinVertices(const SkinningMesh& mesh, const glm::mat4* skinMatrices, std::size_t begin, std::size_t end,
+	glm::vec4* positions, glm::vec4* normals, PoseKernelIsa isa)
+{
+	end = std::min(end, mesh.GetVertexCount());
+	if (begin >= end) return;
+#ifdef SKINNING_X86
+	if (isa == PoseKernelIsa::AVX2)
+	{
+		SkinAVX2(mesh, skinMatrices, begin, end, positions, normals);
+		return;
+	}
+	if (isa == PoseKernelIsa::SSE2)
+	{
+		SkinSSE2(mesh, skinMatrices, begin, end, positions, normals);
+		return;
+	}
+#endif
+	SkinScalar(mesh, skinMatrices, begin, end, positions, normals);
+}
+
+void SkinVertices(const SkinningMesh& mesh, const glm::mat4* skinMatrices, glm::vec4* positions, glm::vec4* normals,
+	JobSystem& jobs, std::size_t chunkSize)
+{
+	// whole registers of vertices per chunk
+	chunkSize = (chunkSize + 7) & ~std::size_t(7);
+	jobs.ParallelFor(mesh.GetVertexCount(), chunkSize, [&](std::size_t begin, std::size_t end) {
+		SkinVertices(mesh, skinMatrices, begin, end, positions, normals);
+	});
+}
+
+SkinningDualQuaternion ToSkinningDualQuaternion(const glm::mat4& matrix)
+{
+	const glm::mat3 linear(matrix);
+	// a uniform scale, negative for a mirror, so what is left is a rotation
+	const float scale = std::cbrt(glm::determinant(linear));
+	const glm::quat rotation = scale != 0.0f ? glm::normalize(glm::quat_cast(linear / scale)) : glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+	const glm::vec3 translation(matrix[3]);
+	// dual part 1/2 t r, t the pure quaternion of the translation
+	const glm::quat dual = glm::quat(0.0f, translation.x, translation.y, translation.z) * rotation * 0.5f;
+
+	SkinningDualQuaternion result{};
+	result.Real = glm::vec4(rotation.x, rotation.y, rotation.z, rotation.w);
+	result.Dual = glm::vec4(dual.x, dual.y, dual.z, dual.w);
+	result.Scale = scale;
+	return result;
+}
+
+void ComputeSkinningDualQuaternions(const SkinningMesh& mesh, const glm::mat4* globalPose, SkinningDualQuaternion* skinDualQuaternions)
+{
+	for (std::size_t k = 0; k < mesh.JointMap.size(); ++k)
+	{
+		const int joint = mesh.JointMap[k];
+		skinDualQuaternions[k] = ToSkinningDualQuaternion(joint >= 0 ? globalPose[joint] * mesh.BindMatrices[k] : mesh.BindShapeMatrix);
+	}
+}
+
+namespace
+{
+	// the reference of the dual quaternion kernels
+	void SkinDualQuaternionScalar(const SkinningMesh& mesh, const SkinningDualQuaternion* skin, std::size_t begin, std::size_t end, glm::vec4* positions, glm::vec4* normals)
+	{
+		for (std::size_t i = begin; i < end; ++i)
+		{
+			const SkinningDualQuaternion* q[4];
+			float w[4];
+			for (int k = 0; k < 4; ++k)
+			{
+				q[k] = &skin[mesh.Joints[k][i]];
+				w[k] = mesh.Weights[k][i];
+			}
+
+			// q and -q are the same transform: the influences on the other side of the first one
+			// are flipped, or the blend would take the long way round
+			for (int k = 1; k < 4; ++k)
+			{
+				const glm::vec4& a = q[0]->Real;
+				const glm::vec4& b = q[k]->Real;
+				const float dot = ((a.x * b.x + a.y * b.y) + a.z * b.z) + a.w * b.w;
+				w[k] = dot < 0.0f ? -w[k] : w[k];
+			}
+
+			float r[4], d[4];
+			for (int c = 0; c < 4; ++c)
+			{
+				r[c] = ((w[0] * q[0]->Real[c] + w[1] * q[1]->Real[c]) + w[2] * q[2]->Real[c]) + w[3] * q[3]->Real[c];
+				d[c] = ((w[0] * q[0]->Dual[c] + w[1] * q[1]->Dual[c]) + w[2] * q[2]->Dual[c]) + w[3] * q[3]->Dual[c];
+			}
+			const float scale = ((mesh.Weights[0][i] * q[0]->Scale + mesh.Weights[1][i] * q[1]->Scale) + mesh.Weights[2][i] * q[2]->Scale) + mesh.Weights[3][i] * q[3]->Scale;
+
+			const float length = ((r[0] * r[0] + r[1] * r[1]) + r[2] * r[2]) + r[3] * r[3];
+			const float inv = length > 0.0f ? 1.0f / std::sqrt(length) : 0.0f;
+			for (int c = 0; c < 4; ++c)
+			{
+				r[c] = r[c] * inv;
+				d[c] = d[c] * inv;
+			}
+
+			// translation 2 (rw d - dw r + r x d), vectors the x y z parts
+			const float t0 = 2.0f * ((r[3] * d[0] - d[3] * r[0]) + (r[1] * d[2] - r[2] * d[1]));
+			const float t1 = 2.0f * ((r[3] * d[1] - d[3] * r[1]) + (r[2] * d[0] - r[0] * d[2]));
+			const float t2 = 2.0f * ((r[3] * d[2] - d[3] * r[2]) + (r[0] * d[1] - r[1] * d[0]));
+
+			// rotation v + 2 r x (r x v + rw v)
+			const float x = scale * mesh.PositionX[i], y = scale * mesh.PositionY[i], z = scale * mesh.PositionZ[i];
+			const float c0 = (r[1] * z - r[2] * y) + r[3] * x;
+			const float c1 = (r[2] * x - r[0] * z) + r[3] * y;
+			const float c2 = (r[0] * y - r[1] * x) + r[3] * z;
+			const float p0 = (x + 2.0f * (r[1] * c2 - r[2] * c1)) + t0;
+			const float p1 = (y + 2.0f * (r[2] * c0 - r[0] * c2)) + t1;
+			const float p2 = (z + 2.0f * (r[0] * c1 - r[1] * c0)) + t2;
+
+			const float nx = mesh.NormalX[i], ny = mesh.NormalY[i], nz = mesh.NormalZ[i];
+			const float e0 = (r[1] * nz - r[2] * ny) + r[3] * nx;
+			const float e1 = (r[2] * nx - r[0] * nz) + r[3] * ny;
+			const float e2 = (r[0] * ny - r[1] * nx) + r[3] * nz;
+			const float n0 = nx + 2.0f * (r[1] * e2 - r[2] * e1);
+			const float n1 = ny + 2.0f * (r[2] * e0 - r[0] * e2);
+			const float n2 = nz + 2.0f * (r[0] * e1 - r[1] * e0);
+
+			const float normalLength = (n0 * n0 + n1 * n1) + n2 * n2;
+			const float normalInv = normalLength > 0.0f ? 1.0f / std::sqrt(normalLength) : 0.0f;
+			positions[i] = glm::vec4(p0, p1, p2, 1.0f);
+			normals[i] = glm::vec4(n0 * normalInv, n1 * normalInv, n2 * normalInv, 0.0f);
+		}
+	}
+
+#ifdef SKINNING_X86
+	// the vector part of the math of the kernels, x y z registers of 4 or 8 vertices. Macros so
+	// the SSE2 and AVX2 kernels share them
+#define SKINNING_DUAL_QUATERNION_BODY(ADD, SUB, MUL, SET1, r, d, x, y, z, nx, ny, nz, p, n) \
+	{ \
+		const auto two = SET1(2.0f); \
+		const auto t0 = MUL(two, ADD(SUB(MUL(r[3], d[0]), MUL(d[3], r[0])), SUB(MUL(r[1], d[2]), MUL(r[2], d[1])))); \
+		const auto t1 = MUL(two, ADD(SUB(MUL(r[3], d[1]), MUL(d[3], r[1])), SUB(MUL(r[2], d[0]), MUL(r[0], d[2])))); \
+		const auto t2 = MUL(two, ADD(SUB(MUL(r[3], d[2]), MUL(d[3], r[2])), SUB(MUL(r[0], d[1]), MUL(r[1], d[0])))); \
+		const auto c0 = ADD(SUB(MUL(r[1], z), MUL(r[2], y)), MUL(r[3], x)); \
+		const auto c1 = ADD(SUB(MUL(r[2], x), MUL(r[0], z)), MUL(r[3], y)); \
+		const auto c2 = ADD(SUB(MUL(r[0], y), MUL(r[1], x)), MUL(r[3], z)); \
+		p[0] = ADD(ADD(x, MUL(two, SUB(MUL(r[1], c2), MUL(r[2], c1)))), t0); \
+		p[1] = ADD(ADD(y, MUL(two, SUB(MUL(r[2], c0), MUL(r[0], c2)))), t1); \
+		p[2] = ADD(ADD(z, MUL(two, SUB(MUL(r[0], c1), MUL(r[1], c0)))), t2); \
+		const auto e0 = ADD(SUB(MUL(r[1], nz), MUL(r[2], ny)), MUL(r[3], nx)); \
+		const auto e1 = ADD(SUB(MUL(r[2], nx), MUL(r[0], nz)), MUL(r[3], ny)); \
+		const auto e2 = ADD(SUB(MUL(r[0], ny), MUL(r[1], nx)), MUL(r[3], nz)); \
+		n[0] = ADD(nx, MUL(two, SUB(MUL(r[1], e2), MUL(r[2], e1)))); \
+		n[1] = ADD(ny, MUL(two, SUB(MUL(r[2], e0), MUL(r[0], e2)))); \
+		n[2] = ADD(nz, MUL(two, SUB(MUL(r[0], e1), MUL(r[1], e0)))); \
+	}
+
+	// 4 vertices at a time, the dual quaternions of every influence transposed into registers
+	void SkinDualQuaternionSSE2(const SkinningMesh& mesh, const SkinningDualQuaternion* skin, std::size_t begin, std::size_t end, glm::vec4* positions, glm::vec4* normals)
+	{
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 one = _mm_set1_ps(1.0f);
+		const __m128 sign = _mm_set1_ps(-0.0f);
+
+		std::size_t i = begin;
+		for (; i + 4 <= end; i += 4)
+		{
+			__m128 real[4][4], dual[4][4], scales[4], weights[4];
+			for (int k = 0; k < 4; ++k)
+			{
+				const SkinningDualQuaternion* q0 = &skin[mesh.Joints[k][i]];
+				const SkinningDualQuaternion* q1 = &skin[mesh.Joints[k][i + 1]];
+				const SkinningDualQuaternion* q2 = &skin[mesh.Joints[k][i + 2]];
+				const SkinningDualQuaternion* q3 = &skin[mesh.Joints[k][i + 3]];
+				real[k][0] = _mm_loadu_ps(&q0->Real[0]); real[k][1] = _mm_loadu_ps(&q1->Real[0]);
+				real[k][2] = _mm_loadu_ps(&q2->Real[0]); real[k][3] = _mm_loadu_ps(&q3->Real[0]);
+				dual[k][0] = _mm_loadu_ps(&q0->Dual[0]); dual[k][1] = _mm_loadu_ps(&q1->Dual[0]);
+				dual[k][2] = _mm_loadu_ps(&q2->Dual[0]); dual[k][3] = _mm_loadu_ps(&q3->Dual[0]);
+				_MM_TRANSPOSE4_PS(real[k][0], real[k][1], real[k][2], real[k][3]);
+				_MM_TRANSPOSE4_PS(dual[k][0], dual[k][1], dual[k][2], dual[k][3]);
+				scales[k] = _mm_setr_ps(q0->Scale, q1->Scale, q2->Scale, q3->Scale);
+				weights[k] = _mm_loadu_ps(mesh.Weights[k].data() + i);
+			}
+
+			__m128 signedWeights[4] = { weights[0], weights[1], weights[2], weights[3] };
+			for (int k = 1; k < 4; ++k)
+			{
+				const __m128 dot = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(real[0][0], real[k][0]), _mm_mul_ps(real[0][1], real[k][1])),
+					_mm_mul_ps(real[0][2], real[k][2])), _mm_mul_ps(real[0][3], real[k][3]));
+				signedWeights[k] = _mm_xor_ps(weights[k], _mm_and_ps(_mm_cmplt_ps(dot, zero), sign));
+			}
+
+			__m128 r[4], d[4];
+			for (int c = 0; c < 4; ++c)
+			{
+				r[c] = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(signedWeights[0], real[0][c]), _mm_mul_ps(signedWeights[1], real[1][c])),
+					_mm_mul_ps(signedWeights[2], real[2][c])), _mm_mul_ps(signedWeights[3], real[3][c]));
+				d[c] = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(signedWeights[0], dual[0][c]), _mm_mul_ps(signedWeights[1], dual[1][c])),
+					_mm_mul_ps(signedWeights[2], dual[2][c])), _mm_mul_ps(signedWeights[3], dual[3][c]));
+			}
+			const __m128 scale = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(weights[0], scales[0]), _mm_mul_ps(weights[1], scales[1])),
+				_mm_mul_ps(weights[2], scales[2])), _mm_mul_ps(weights[3], scales[3]));
+
+			const __m128 length = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(r[0], r[0]), _mm_mul_ps(r[1], r[1])), _mm_mul_ps(r[2], r[2])), _mm_mul_ps(r[3], r[3]));
+			const __m128 inv = _mm_and_ps(_mm_div_ps(one, _mm_sqrt_ps(length)), _mm_cmpgt_ps(length, zero));
+			for (int c = 0; c < 4; ++c)
+			{
+				r[c] = _mm_mul_ps(r[c], inv);
+				d[c] = _mm_mul_ps(d[c], inv);
+			}
+
+			const __m128 x = _mm_mul_ps(scale, _mm_loadu_ps(mesh.PositionX.data() + i));
+			const __m128 y = _mm_mul_ps(scale, _mm_loadu_ps(mesh.PositionY.data() + i));
+			const __m128 z = _mm_mul_ps(scale, _mm_loadu_ps(mesh.PositionZ.data() + i));
+			const __m128 nx = _mm_loadu_ps(mesh.NormalX.data() + i), ny = _mm_loadu_ps(mesh.NormalY.data() + i), nz = _mm_loadu_ps(mesh.NormalZ.data() + i);
+			__m128 p[3], n[3];
+			SKINNING_DUAL_QUATERNION_BODY(_mm_add_ps, _mm_sub_ps, _mm_mul_ps, _mm_set1_ps, r, d, x, y, z, nx, ny, nz, p, n)
+
+			const __m128 normalLength = _mm_add_ps(_mm_add_ps(_mm_mul_ps(n[0], n[0]), _mm_mul_ps(n[1], n[1])), _mm_mul_ps(n[2], n[2]));
+			const __m128 normalInv = _mm_and_ps(_mm_div_ps(one, _mm_sqrt_ps(normalLength)), _mm_cmpgt_ps(normalLength, zero));
+			__m128 px = p[0], py = p[1], pz = p[2], pw = one;
+			__m128 qx = _mm_mul_ps(n[0], normalInv), qy = _mm_mul_ps(n[1], normalInv), qz = _mm_mul_ps(n[2], normalInv), qw = zero;
+			_MM_TRANSPOSE4_PS(px, py, pz, pw);
+			_MM_TRANSPOSE4_PS(qx, qy, qz, qw);
+			_mm_storeu_ps(&positions[i][0], px); _mm_storeu_ps(&positions[i + 1][0], py); _mm_storeu_ps(&positions[i + 2][0], pz); _mm_storeu_ps(&positions[i + 3][0], pw);
+			_mm_storeu_ps(&normals[i][0], qx); _mm_storeu_ps(&normals[i + 1][0], qy); _mm_storeu_ps(&normals[i + 2][0], qz); _mm_storeu_ps(&normals[i + 3][0], qw);
+		}
+		SkinDualQuaternionScalar(mesh, skin, i, end, positions, normals);
+	}
+
+	// 8 vertices at a time, the elements of the dual quaternions gathered per register
+	SKINNING_AVX2_TARGET void SkinDualQuaternionAVX2(const SkinningMesh& mesh, const SkinningDualQuaternion* skin, std::size_t begin, std::size_t end, glm::vec4* positions, glm::vec4* normals)
+	{
+		const float* base = &skin[0].Real[0];
+		const __m256 zero = _mm256_setzero_ps();
+		const __m256 one = _mm256_set1_ps(1.0f);
+		const __m256 sign = _mm256_set1_ps(-0.0f);
+		// a dual quaternion is 12 floats
+		const __m256i stride = _mm256_set1_epi32((int)(sizeof(SkinningDualQuaternion) / sizeof(float)));
+
+		std::size_t i = begin;
+		for (; i + 8 <= end; i += 8)
+		{
+			__m256 real[4][4], dual[4][4], scales[4], weights[4];
+			for (int k = 0; k < 4; ++k)
+			{
+				const __m256i joints = _mm256_mullo_epi32(_mm256_loadu_si256((const __m256i*)(mesh.Joints[k].data() + i)), stride);
+				for (int c = 0; c < 4; ++c)
+				{
+					real[k][c] = _mm256_i32gather_ps(base + c, joints, 4);
+					dual[k][c] = _mm256_i32gather_ps(base + 4 + c, joints, 4);
+				}
+				scales[k] = _mm256_i32gather_ps(base + 8, joints, 4);
+				weights[k] = _mm256_loadu_ps(mesh.Weights[k].data() + i);
+			}
+
+			__m256 signedWeights[4] = { weights[0], weights[1], weights[2], weights[3] };
+			for (int k = 1; k < 4; ++k)
+			{
+				const __m256 dot = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(real[0][0], real[k][0]), _mm256_mul_ps(real[0][1], real[k][1])),
+					_mm256_mul_ps(real[0][2], real[k][2])), _mm256_mul_ps(real[0][3], real[k][3]));
+				signedWeights[k] = _mm256_xor_ps(weights[k], _mm256_and_ps(_mm256_cmp_ps(dot, zero, _CMP_LT_OQ), sign));
+			}
+
+			__m256 r[4], d[4];
+			for (int c = 0; c < 4; ++c)
+			{
+				r[c] = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(signedWeights[0], real[0][c]), _mm256_mul_ps(signedWeights[1], real[1][c])),
+					_mm256_mul_ps(signedWeights[2], real[2][c])), _mm256_mul_ps(signedWeights[3], real[3][c]));
+				d[c] = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(signedWeights[0], dual[0][c]), _mm256_mul_ps(signedWeights[1], dual[1][c])),
+					_mm256_mul_ps(signedWeights[2], dual[2][c])), _mm256_mul_ps(signedWeights[3], dual[3][c]));
+			}
+			const __m256 scale = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(weights[0], scales[0]), _mm256_mul_ps(weights[1], scales[1])),
+				_mm256_mul_ps(weights[2], scales[2])), _mm256_mul_ps(weights[3], scales[3]));
+
+			const __m256 length = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(r[0], r[0]), _mm256_mul_ps(r[1], r[1])), _mm256_mul_ps(r[2], r[2])), _mm256_mul_ps(r[3], r[3]));
+			const __m256 inv = _mm256_and_ps(_mm256_div_ps(one, _mm256_sqrt_ps(length)), _mm256_cmp_ps(length, zero, _CMP_GT_OQ));
+			for (int c = 0; c < 4; ++c)
+			{
+				r[c] = _mm256_mul_ps(r[c], inv);
+				d[c] = _mm256_mul_ps(d[c], inv);
+			}
+
+			const __m256 x = _mm256_mul_ps(scale, _mm256_loadu_ps(mesh.PositionX.data() + i));
+			const __m256 y = _mm256_mul_ps(scale, _mm256_loadu_ps(mesh.PositionY.data() + i));
+			const __m256 z = _mm256_mul_ps(scale, _mm256_loadu_ps(mesh.PositionZ.data() + i));
+			const __m256 nx = _mm256_loadu_ps(mesh.NormalX.data() + i), ny = _mm256_loadu_ps(mesh.NormalY.data() + i), nz = _mm256_loadu_ps(mesh.NormalZ.data() + i);
+			__m256 p[3], n[3];
+			SKINNING_DUAL_QUATERNION_BODY(_mm256_add_ps, _mm256_sub_ps, _mm256_mul_ps, _mm256_set1_ps, r, d, x, y, z, nx, ny, nz, p, n)
+
+			const __m256 normalLength = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(n[0], n[0]), _mm256_mul_ps(n[1], n[1])), _mm256_mul_ps(n[2], n[2]));
+			const __m256 normalInv = _mm256_and_ps(_mm256_div_ps(one, _mm256_sqrt_ps(normalLength)), _mm256_cmp_ps(normalLength, zero, _CMP_GT_OQ));
+			for (int c = 0; c < 3; ++c)
+				n[c] = _mm256_mul_ps(n[c], normalInv);
+
+			// back to one vec4 per vertex, 4 vertices per transpose
+			for (int half = 0; half < 2; ++half)
+			{
+				__m128 px = half ? _mm256_extractf128_ps(p[0], 1) : _mm256_castps256_ps128(p[0]);
+				__m128 py = half ? _mm256_extractf128_ps(p[1], 1) : _mm256_castps256_ps128(p[1]);
+				__m128 pz = half ? _mm256_extractf128_ps(p[2], 1) : _mm256_castps256_ps128(p[2]);
+				__m128 pw = _mm_set1_ps(1.0f);
+				__m128 qx = half ? _mm256_extractf128_ps(n[0], 1) : _mm256_castps256_ps128(n[0]);
+				__m128 qy = half ? _mm256_extractf128_ps(n[1], 1) : _mm256_castps256_ps128(n[1]);
+				__m128 qz = half ? _mm256_extractf128_ps(n[2], 1) : _mm256_castps256_ps128(n[2]);
+				__m128 qw = _mm_setzero_ps();
+				_MM_TRANSPOSE4_PS(px, py, pz, pw);
+				_MM_TRANSPOSE4_PS(qx, qy, qz, qw);
+
+				glm::vec4* pos = positions + i + half * 4;
+				glm::vec4* nrm = normals + i + half * 4;
+				_mm_storeu_ps(&pos[0][0], px); _mm_storeu_ps(&pos[1][0], py); _mm_storeu_ps(&pos[2][0], pz); _mm_storeu_ps(&pos[3][0], pw);
+				_mm_storeu_ps(&nrm[0][0], qx); _mm_storeu_ps(&nrm[1][0], qy); _mm_storeu_ps(&nrm[2][0], qz); _mm_storeu_ps(&nrm[3][0], qw);
+			}
+		}
+		SkinDualQuaternionSSE2(mesh, skin, i, end, positions, normals);
+	}
+#undef SKINNING_DUAL_QUATERNION_BODY
+#endif
+}
+
+void SkinVertices(const SkinningMesh& mesh, const SkinningDualQuaternion* skinDualQuaternions, std::size_t begin, std::size_t end,
+	glm::vec4* positions, glm::vec4* normals)
+{
+	SkinVertices(mesh, skinDualQuaternions, begin, end, positions, normals, GetPoseKernelIsa());
+}
+
+void SkinVertices(const SkinningMesh& mesh, const SkinningDualQuaternion* skinDualQuaternions, std::size_t begin, std::size_t end,
+	glm::vec4* positions, glm::vec4* normals, PoseKernelIsa isa)
+{
+	end = std::min(end, mesh.GetVertexCount());
+	if (begin >= end) return;
+#ifdef SKINNING_X86
+	if (isa == PoseKernelIsa::AVX2)
+	{
+		SkinDualQuaternionAVX2(mesh, skinDualQuaternions, begin, end, positions, normals);
+		return;
+	}
+	if (isa == PoseKernelIsa::SSE2)
+	{
+		SkinDualQuaternionSSE2(mesh, skinDualQuaternions, begin, end, positions, normals);
+		return;
+	}
+#endif
+	SkinDualQuaternionScalar(mesh, skinDualQuaternions, begin, end, positions, normals);
+}
+
+void SkinVertices(const SkinningMesh& mesh, const SkinningDualQuaternion* skinDualQuaternions, glm::vec4* positions, glm::vec4* normals,
+	JobSystem& jobs, std::size_t chunkSize)
+{
+	chunkSize = (chunkSize + 7) & ~std::size_t(7);
+	jobs.ParallelFor(mesh.GetVertexCount(), chunkSize, [&](std::size_t begin, std::size_t end) {
+		SkinVertices(mesh, skinDualQuaternions, begin, end, positions, normals);
+	});
+}
@@ -0,0 +1,93 @@
+#pragma once
+#include <vector>
+#include <cstddef>
+#include <glm/glm.hpp>
+#include "../app/Skeleton.h"
+#include "../app/ColladaAsset.h"
+#include "../core/utils/JobSystem.h"
+#include "PoseKernels.h"
+
+// Skinning on the cpu: every vertex is moved by the weighted sum of the skinning transforms of
+// its four joints. The headless reference of the gpu skinning, and what the tests and tools
+// without a window deform meshes with.
+//
+// Linear blend skinning sums matrices, which collapses the mesh around joints that twist (the
+// forearms); dual quaternion skinning sums rigid transforms and keeps the volume, at some more
+// arithmetic per vertex.
+//
+// The kernels work on vertices: the scalar one and SSE2 (one vertex, a matrix column per
+// register, or 4 dual quaternion vertices) and AVX2 (8 vertices per register, the transforms
+// gathered). All of them do the same operations in the same order, so they give the same bits.
+
+enum class SkinningMode
+{
+	LinearBlend,
+	DualQuaternion
+};
+
+// a SkinnedMeshData bound to a skeleton, the vertex data split in arrays for the kernels
+struct SkinningMesh
+{
+	// skeleton joint of every joint of the skin, -1 if the skeleton doesn't have it
+	std::vector<int> JointMap;
+	// inverse bind matrix times bind shape matrix of every joint of the skin
+	std::vector<glm::mat4> BindMatrices;
+	// what the joints the skeleton doesn't have apply
+	glm::mat4 BindShapeMatrix{ 1.0f };
+
+	std::vector<float> PositionX, PositionY, PositionZ;
+	std::vector<float> NormalX, NormalY, NormalZ;
+	// influence k of every vertex, indices of JointMap
+	std::vector<int> Joints[4];
+	std::vector<float> Weights[4];
+
+	std::size_t GetVertexCount() const { return PositionX.size(); }
+	std::size_t GetJointCount() const { return JointMap.size(); }
+
+	// joints are matched by name, the ones of the skin missing in skeleton are reported once
+	static SkinningMesh FromMeshData(const SkinnedMeshData& mesh, const Skeleton& skeleton);
+};
+
+// skinning matrix of every joint of the skin: its model space transform (globalPose, skeleton
+// order like Animator::GetGlobalTransforms) times its bind matrices. skinMatrices holds
+// mesh.GetJointCount() matrices. The skinned mesh is in the space of the skeleton, where the
+// joints are drawn: the inverse bind matrices of the file include the transform of the
+// armature node, which the skeleton doesn't
+void ComputeSkinningMatrices(const SkinningMesh& mesh, const glm::mat4* globalPose, glm::mat4* skinMatrices);
+
+// rigid part of a skinning matrix as a unit dual quaternion, x y z w like the shader, and its
+// uniform scale, applied before. Laid out like the DualQuaternion struct of Shaders/skin_vert.sh
+// (std430: 48 bytes)
+struct SkinningDualQuaternion
+{
+	glm::vec4 Real;
+	glm::vec4 Dual;
+	float Scale;
+	float Padding[3];
+};
+static_assert(sizeof(SkinningDualQuaternion) == 48, "SkinningDualQuaternion must match the std430 layout of the DualQuaternion struct");
+
+// ComputeSkinningMatrices as dual quaternions, skinDualQuaternions holds mesh.GetJointCount().
+// Shear and non uniform scale of the matrices are lost
+void ComputeSkinningDualQuaternions(const SkinningMesh& mesh, const glm::mat4* globalPose, SkinningDualQuaternion* skinDualQuaternions);
+// the dual quaternion of a matrix without shear
+SkinningDualQuaternion ToSkinningDualQuaternion(const glm::mat4& matrix);
+
+// deforms the vertices [begin, end) of mesh into positions (w = 1) and normals (unit length,
+// w = 0), indexed by vertex like the mesh
+void SkinVertices(const SkinningMesh& mesh, const glm::mat4* skinMatrices, std::size_t begin, std::size_t end,
+	glm::vec4* positions, glm::vec4* normals);
+// with a given kernel (benchmarks, tests), it must be supported
+void SkinVertices(const SkinningMesh& mesh, const glm::mat4* skinMatrices, std::size_t begin, std::size_t end,
+	glm::vec4* positions, glm::vec4* normals, PoseKernelIsa isa);
+// every vertex, split over the threads of jobs in chunks of chunkSize vertices
+void SkinVertices(const SkinningMesh& mesh, const glm::mat4* skinMatrices, glm::vec4* positions, glm::vec4* normals,
+	JobSystem& jobs, std::size_t chunkSize = 1024);
+
+// dual quaternion skinning, same arguments as the linear blend ones
+void SkinVertices(const SkinningMesh& mesh, const SkinningDualQuaternion* skinDualQuaternions, std::size_t begin, std::size_t end,
+	glm::vec4* positions, glm::vec4* normals);
+void SkinVertices(const SkinningMesh& mesh, const SkinningDualQuaternion* skinDualQuaternions, std::size_t begin, std::size_t end,
+	glm::vec4* positions, glm::vec4* normals, PoseKernelIsa isa);
+void SkinVertices(const SkinningMesh& mesh, const SkinningDualQuaternion* skinDualQuaternions, glm::vec4* positions, glm::vec4* normals,
+	JobSystem& jobs, std::size_t chunkSize = 1024);